@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <nos/AsyncNuggetClient.h>
+
+#include <utility>
+
+#include <nos/ThreadScheduling.h>
+
+namespace nos {
+
+namespace {
+
+/* Index of the queue for calls of the priority */
+size_t QueueIndex(CallPriority priority) {
+  switch (priority) {
+    case CallPriority::INTERACTIVE:
+      return 0;
+    case CallPriority::BACKGROUND:
+      return 2;
+    default:
+      return 1;
+  }
+}
+
+}  // namespace
+
+AsyncNuggetClient::AsyncNuggetClient(NuggetClientInterface& client)
+    : client_(client), stopping_(false), io_scheduling_changed_(false),
+      io_cpu_(-1), io_nice_(0), worker_(&AsyncNuggetClient::Work, this) {
+}
+
+AsyncNuggetClient::~AsyncNuggetClient() {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stopping_ = true;
+  }
+  queue_cv_.notify_one();
+  worker_.join();
+}
+
+void AsyncNuggetClient::Open() {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  client_.Open();
+}
+
+void AsyncNuggetClient::Close() {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  client_.Close();
+}
+
+bool AsyncNuggetClient::IsOpen() const {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  return client_.IsOpen();
+}
+
+uint32_t AsyncNuggetClient::CallApp(uint32_t appId, uint16_t arg,
+                                    const std::vector<uint8_t>& request,
+                                    std::vector<uint8_t>* response) {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  return client_.CallApp(appId, arg, request, response);
+}
+
+uint32_t AsyncNuggetClient::CallAppCancellable(
+    uint32_t appId, uint16_t arg, const std::vector<uint8_t>& request,
+    std::vector<uint8_t>* response, const CancellationToken& cancel) {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  return client_.CallAppCancellable(appId, arg, request, response, cancel);
+}
+
+uint32_t AsyncNuggetClient::CallAppRaw(uint32_t appId, uint16_t arg,
+                                       const uint8_t* request,
+                                       uint32_t requestSize, uint8_t* response,
+                                       uint32_t* responseSize) {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  return client_.CallAppRaw(appId, arg, request, requestSize, response,
+                            responseSize);
+}
+
+uint32_t AsyncNuggetClient::CallAppChunked(uint32_t appId, uint16_t arg,
+                                           const std::vector<uint8_t>& request,
+                                           ReplyChunks* response,
+                                           const CancellationToken* cancel) {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  return client_.CallAppChunked(appId, arg, request, response, cancel);
+}
+
+uint32_t AsyncNuggetClient::CallAppStreamed(uint32_t appId, uint16_t arg,
+                                            const StreamedRequest& request,
+                                            ReplyChunks* response,
+                                            const CancellationToken* cancel) {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  return client_.CallAppStreamed(appId, arg, request, response, cancel);
+}
+
+uint32_t AsyncNuggetClient::CallAppStreamed(uint32_t appId, uint16_t arg,
+                                            const StreamedRequest& request,
+                                            ReplyChunks* response,
+                                            const CancellationToken* cancel,
+                                            const MethodInfo& method) {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  return client_.CallAppStreamed(appId, arg, request, response, cancel,
+                                 method);
+}
+
+uint32_t AsyncNuggetClient::CallAppBatch(
+    uint32_t appId, uint16_t arg,
+    const std::vector<const StreamedRequest*>& requests, ReplyChunks* response,
+    const CancellationToken* cancel, const MethodInfo& method,
+    const BatchReply& reply) {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  return client_.CallAppBatch(appId, arg, requests, response, cancel, method,
+                              reply);
+}
+
+void AsyncNuggetClient::CallAppAsync(
+    uint32_t appId, uint16_t arg,
+    std::unique_ptr<const StreamedRequest> request, ReplyChunks* response,
+    const CancellationToken* cancel, const MethodInfo& method,
+    AsyncDone done) {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    queues_[QueueIndex(method.priority)].push_back(
+        {appId, arg, std::move(request), response, cancel, method,
+         std::move(done)});
+  }
+  queue_cv_.notify_one();
+}
+
+uint32_t AsyncNuggetClient::Reset() const {
+  std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+  return client_.Reset();
+}
+
+bool AsyncNuggetClient::EventsPending() const {
+  return client_.EventsPending();
+}
+
+size_t AsyncNuggetClient::Pending() const {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  size_t pending = 0;
+  for (const std::deque<Call>& queue : queues_) {
+    pending += queue.size();
+  }
+  return pending;
+}
+
+void AsyncNuggetClient::SetIoThreadScheduling(int cpu, int nice) {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    io_scheduling_changed_ = true;
+    io_cpu_ = cpu;
+    io_nice_ = nice;
+  }
+  queue_cv_.notify_one();
+}
+
+void AsyncNuggetClient::Work() {
+  for (;;) {
+    Call call;
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      std::deque<Call>* next = nullptr;
+      queue_cv_.wait(lock, [&] {
+        for (std::deque<Call>& queue : queues_) {
+          if (!queue.empty()) {
+            next = &queue;
+            return true;
+          }
+        }
+        return stopping_ || io_scheduling_changed_;
+      });
+      if (io_scheduling_changed_) {
+        io_scheduling_changed_ = false;
+        ::nos::SetIoThreadScheduling(io_cpu_, io_nice_);
+      }
+      if (next == nullptr) {
+        if (stopping_) {
+          return;
+        }
+        continue;
+      }
+      call = std::move(next->front());
+      next->pop_front();
+    }
+
+    uint32_t status;
+    {
+      std::lock_guard<std::recursive_mutex> lock(call_mutex_);
+      status = client_.CallAppStreamed(call.appId, call.arg, *call.request,
+                                       call.response, call.cancel,
+                                       call.method);
+    }
+    call.done(status);
+  }
+}
+
+}  // namespace nos
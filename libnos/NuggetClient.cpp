@@ -15,18 +15,73 @@
  */
 
 #include <nos/NuggetClient.h>
+#include <algorithm>
 #include <limits>
+#include <utility>
 #include <nos/transport.h>
 #include <application.h>
 
 namespace nos {
 
+namespace {
+
+int IsCancelled(const void* token) {
+  return static_cast<const CancellationToken*>(token)->IsCancelled();
+}
+
+uint8_t* NextReplyChunk(void* chunks, uint32_t len) {
+  return static_cast<ReplyChunks*>(chunks)->Append(len);
+}
+
+void RestartReply(void* chunks) {
+  static_cast<ReplyChunks*>(chunks)->Clear();
+}
+
+int ProduceRequest(void* request,
+                   int (*emit)(void* emit_arg, const uint8_t* data, uint32_t len),
+                   void* emit_arg) {
+  struct EmitSink : public StreamedRequest::Sink {
+    int (*emit)(void*, const uint8_t*, uint32_t);
+    void* emit_arg;
+    bool Write(const uint8_t* data, size_t len) override {
+      return emit(emit_arg, data, len) == 0;
+    }
+  } sink;
+  sink.emit = emit;
+  sink.emit_arg = emit_arg;
+  return static_cast<const StreamedRequest*>(request)->WriteTo(sink) ? 0 : -1;
+}
+
+/* State of a batch between its calls */
+struct Batch {
+  const std::vector<nos_batch_call>* calls;
+  const NuggetClientInterface::BatchReply* reply;
+  ReplyChunks* response;
+  uint32_t status;
+};
+
+int BatchCallDone(void* arg, uint32_t index) {
+  Batch* batch = static_cast<Batch*>(arg);
+  batch->status = (*batch->reply)(index, (*batch->calls)[index].result);
+  /* The next call reuses the chunks */
+  if (batch->response != nullptr) {
+    batch->response->Clear();
+  }
+  return batch->status != APP_SUCCESS;
+}
+
+}  // namespace
+
 NuggetClient::NuggetClient(const std::string& name)
-    : device_name_(name), open_(false) {
+    : device_name_(name), open_(false), completion_(NOS_COMPLETION_POLL),
+      spin_us_(0), recorder_(), events_pending_(0), calls_(0),
+      resetting_(false) {
 }
 
 NuggetClient::NuggetClient(const char* name, uint32_t config)
-    : device_name_(name ? name : ""), open_(false) {
+    : device_name_(name ? name : ""), open_(false),
+      completion_(NOS_COMPLETION_POLL), spin_us_(0), recorder_(),
+      events_pending_(0), calls_(0), resetting_(false) {
   device_ = { .config = config };
 }
 
@@ -55,6 +110,206 @@ bool NuggetClient::IsOpen() const {
 uint32_t NuggetClient::CallApp(uint32_t appId, uint16_t arg,
                                const std::vector<uint8_t>& request,
                                std::vector<uint8_t>* response) {
+  CallEventsPending eventsPending(events_pending_);
+  const nos_call_options options = {
+    .completion = completion_,
+    .spin_us = spin_us_,
+    .recorder = &recorder_,
+    .events_pending = eventsPending.get(),
+  };
+  return CallAppWithOptions(appId, arg, request, response, &options);
+}
+
+uint32_t NuggetClient::CallAppCancellable(uint32_t appId, uint16_t arg,
+                                          const std::vector<uint8_t>& request,
+                                          std::vector<uint8_t>* response,
+                                          const CancellationToken& cancel) {
+  if (cancel.IsCancelled()) {
+    return NOS_ERROR_CANCELLED;
+  }
+
+  CallEventsPending eventsPending(events_pending_);
+  const nos_call_options options = {
+    .is_cancelled = IsCancelled,
+    .cancel_arg = &cancel,
+    .completion = completion_,
+    .spin_us = spin_us_,
+    .recorder = &recorder_,
+    .events_pending = eventsPending.get(),
+  };
+  return CallAppWithOptions(appId, arg, request, response, &options);
+}
+
+uint32_t NuggetClient::CallAppRaw(uint32_t appId, uint16_t arg,
+                                  const uint8_t* request, uint32_t requestSize,
+                                  uint8_t* response, uint32_t* responseSize) {
+  if (!open_) {
+    return APP_ERROR_IO;
+  }
+
+  CallScope call(*this);
+  CallEventsPending eventsPending(events_pending_);
+  const nos_call_options options = {
+    .completion = completion_,
+    .spin_us = spin_us_,
+    .recorder = &recorder_,
+    .events_pending = eventsPending.get(),
+  };
+  uint32_t noReply = 0;
+  return nos_call_application_opts(
+      &device_, appId, arg, request, requestSize, response,
+      (response != nullptr) ? responseSize : &noReply, &options);
+}
+
+uint32_t NuggetClient::CallAppChunked(uint32_t appId, uint16_t arg,
+                                      const std::vector<uint8_t>& request,
+                                      ReplyChunks* response,
+                                      const CancellationToken* cancel) {
+  return CallAppChunkedWithSource(appId, arg, request.data(), request.size(),
+                                  nullptr, response, cancel, 0);
+}
+
+uint32_t NuggetClient::CallAppStreamed(uint32_t appId, uint16_t arg,
+                                       const StreamedRequest& request,
+                                       ReplyChunks* response,
+                                       const CancellationToken* cancel) {
+  const nos_request_source source = {
+    .produce = ProduceRequest,
+    .arg = const_cast<StreamedRequest*>(&request),
+  };
+  return CallAppChunkedWithSource(appId, arg, nullptr, request.Size(), &source,
+                                  response, cancel, 0);
+}
+
+uint32_t NuggetClient::CallAppStreamed(uint32_t appId, uint16_t arg,
+                                       const StreamedRequest& request,
+                                       ReplyChunks* response,
+                                       const CancellationToken* cancel,
+                                       const MethodInfo& method) {
+  const nos_request_source source = {
+    .produce = ProduceRequest,
+    .arg = const_cast<StreamedRequest*>(&request),
+  };
+  return CallAppChunkedWithSource(appId, arg, nullptr, request.Size(), &source,
+                                  response, cancel, method.timeout_ms);
+}
+
+uint32_t NuggetClient::CallAppBatch(
+    uint32_t appId, uint16_t arg,
+    const std::vector<const StreamedRequest*>& requests, ReplyChunks* response,
+    const CancellationToken* cancel, const MethodInfo& method,
+    const BatchReply& reply) {
+  if (!open_) {
+    return APP_ERROR_IO;
+  }
+
+  if (cancel != nullptr && cancel->IsCancelled()) {
+    return NOS_ERROR_CANCELLED;
+  }
+
+  uint32_t replySize = 0;
+  if (response != nullptr) {
+    response->Clear();
+    replySize = std::min<size_t>(response->Capacity(),
+                                 std::numeric_limits<uint32_t>::max());
+  }
+
+  std::vector<nos_request_source> sources(requests.size());
+  std::vector<nos_batch_call> calls(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    if (requests[i]->Size() > std::numeric_limits<uint32_t>::max()) {
+      return APP_ERROR_TOO_MUCH;
+    }
+    sources[i].produce = ProduceRequest;
+    sources[i].arg = const_cast<StreamedRequest*>(requests[i]);
+    calls[i].app_id = appId;
+    calls[i].params = arg;
+    calls[i].arg_len = requests[i]->Size();
+    calls[i].reply_len = replySize;
+    calls[i].request_source = &sources[i];
+  }
+
+  const nos_reply_chunks chunks = {
+    .next = NextReplyChunk,
+    .restart = RestartReply,
+    .arg = response,
+  };
+  CallScope call(*this);
+  CallEventsPending eventsPending(events_pending_);
+  const nos_call_options options = {
+    .is_cancelled = (cancel != nullptr) ? IsCancelled : nullptr,
+    .cancel_arg = cancel,
+    .completion = completion_,
+    .spin_us = spin_us_,
+    .reply_chunks = (response != nullptr) ? &chunks : nullptr,
+    .recorder = &recorder_,
+    .timeout_ms = method.timeout_ms,
+    .events_pending = eventsPending.get(),
+  };
+
+  Batch batch = {&calls, &reply, response, APP_SUCCESS};
+  const uint32_t made = nos_call_application_pipelined(
+      &device_, calls.data(), calls.size(), &options, BatchCallDone, &batch);
+  if (batch.status == APP_SUCCESS && made != calls.size()) {
+    /* Only cancellation stops the batch between calls */
+    return NOS_ERROR_CANCELLED;
+  }
+  return batch.status;
+}
+
+uint32_t NuggetClient::CallAppChunkedWithSource(uint32_t appId, uint16_t arg,
+                                                const uint8_t* request,
+                                                size_t requestSize,
+                                                const nos_request_source* source,
+                                                ReplyChunks* response,
+                                                const CancellationToken* cancel,
+                                                uint32_t timeoutMs) {
+  if (!open_) {
+    return APP_ERROR_IO;
+  }
+
+  if (requestSize > std::numeric_limits<uint32_t>::max()) {
+    return APP_ERROR_TOO_MUCH;
+  }
+
+  if (cancel != nullptr && cancel->IsCancelled()) {
+    return NOS_ERROR_CANCELLED;
+  }
+
+  const nos_reply_chunks chunks = {
+    .next = NextReplyChunk,
+    .restart = RestartReply,
+    .arg = response,
+  };
+  CallScope call(*this);
+  CallEventsPending eventsPending(events_pending_);
+  const nos_call_options options = {
+    .is_cancelled = (cancel != nullptr) ? IsCancelled : nullptr,
+    .cancel_arg = cancel,
+    .completion = completion_,
+    .spin_us = spin_us_,
+    .reply_chunks = (response != nullptr) ? &chunks : nullptr,
+    .request_source = source,
+    .recorder = &recorder_,
+    .timeout_ms = timeoutMs,
+    .events_pending = eventsPending.get(),
+  };
+
+  uint32_t replySize = 0;
+  if (response != nullptr) {
+    response->Clear();
+    replySize = std::min<size_t>(response->Capacity(),
+                                 std::numeric_limits<uint32_t>::max());
+  }
+
+  return nos_call_application_opts(&device_, appId, arg, request, requestSize,
+                                   nullptr, &replySize, &options);
+}
+
+uint32_t NuggetClient::CallAppWithOptions(uint32_t appId, uint16_t arg,
+                                          const std::vector<uint8_t>& request,
+                                          std::vector<uint8_t>* response,
+                                          const nos_call_options* options) {
   if (!open_) {
     return APP_ERROR_IO;
   }
@@ -73,9 +328,11 @@ uint32_t NuggetClient::CallApp(uint32_t appId, uint16_t arg,
     replyData = response->data();
   }
 
-  uint32_t status_code = nos_call_application(&device_, appId, arg,
-                                              request.data(), requestSize,
-                                              replyData, &replySize);
+  CallScope call(*this);
+  uint32_t status_code = nos_call_application_opts(&device_, appId, arg,
+                                                   request.data(), requestSize,
+                                                   replyData, &replySize,
+                                                   options);
 
   if (response != nullptr) {
     response->resize(replySize);
@@ -89,7 +346,56 @@ uint32_t NuggetClient::Reset() const {
   if (!open_)
     return APP_ERROR_NOT_READY;
 
-  return device_.ops.reset(device_.ctx);
+  {
+    std::unique_lock<std::mutex> lock(reset_mutex_);
+    if (resetting_ && reset_thread_ == std::this_thread::get_id()) {
+      /* A warm-up can't wait for the reset it is part of */
+      return APP_ERROR_BUSY;
+    }
+    reset_cv_.wait(lock, [this] { return !resetting_; });
+    resetting_ = true;
+    reset_thread_ = std::this_thread::get_id();
+    reset_cv_.wait(lock, [this] { return calls_ == 0; });
+  }
+
+  int err = device_.ops.reset(device_.ctx);
+  if (err == 0) {
+    err = nos_wait_until_ready(&device_, 0);
+  }
+  if (err == 0) {
+    for (const WarmUp& warmUp : warm_ups_) {
+      warmUp();
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(reset_mutex_);
+    resetting_ = false;
+  }
+  reset_cv_.notify_all();
+  return err;
+}
+
+void NuggetClient::AddWarmUp(WarmUp warmUp) {
+  warm_ups_.push_back(std::move(warmUp));
+}
+
+void NuggetClient::SetCompletionPolicy(nos_completion_policy policy,
+                                       uint32_t spinUs) {
+  completion_ = policy;
+  spin_us_ = spinUs;
+}
+
+nos_flight_recorder* NuggetClient::FlightRecorder() {
+  return &recorder_;
+}
+
+const nos_flight_recorder* NuggetClient::FlightRecorder() const {
+  return &recorder_;
+}
+
+bool NuggetClient::EventsPending() const {
+  return events_pending_.load(std::memory_order_relaxed) != 0;
 }
 
 nos_device* NuggetClient::Device() {
@@ -100,6 +406,22 @@ const nos_device* NuggetClient::Device() const {
   return open_ ? &device_ : nullptr;
 }
 
+void NuggetClient::EnterCall() {
+  std::unique_lock<std::mutex> lock(reset_mutex_);
+  /* The warm-ups call on the thread that is resetting */
+  reset_cv_.wait(lock, [this] {
+    return !resetting_ || reset_thread_ == std::this_thread::get_id();
+  });
+  ++calls_;
+}
+
+void NuggetClient::LeaveCall() {
+  std::lock_guard<std::mutex> lock(reset_mutex_);
+  if (--calls_ == 0) {
+    reset_cv_.notify_all();
+  }
+}
+
 const std::string& NuggetClient::DeviceName() const {
   return device_name_;
 }
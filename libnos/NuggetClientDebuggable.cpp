@@ -52,9 +52,16 @@ uint32_t NuggetClientDebuggable::CallApp(uint32_t appId, uint16_t arg,
     (request_cb_)(request);
   }
 
-  uint32_t status_code = nos_call_application(&device_, appId, arg,
-                                              request.data(), requestSize,
-                                              replyData, &replySize);
+  CallScope call(*this);
+  CallEventsPending eventsPending(events_pending_);
+  const nos_call_options options = {
+    .recorder = &recorder_,
+    .events_pending = eventsPending.get(),
+  };
+  uint32_t status_code = nos_call_application_opts(&device_, appId, arg,
+                                                   request.data(), requestSize,
+                                                   replyData, &replySize,
+                                                   &options);
 
   if (response != nullptr) {
     response->resize(replySize);
@@ -66,4 +73,56 @@ uint32_t NuggetClientDebuggable::CallApp(uint32_t appId, uint16_t arg,
   return status_code;
 }
 
+uint32_t NuggetClientDebuggable::CallAppCancellable(
+    uint32_t appId, uint16_t arg, const std::vector<uint8_t>& request,
+    std::vector<uint8_t>* response, const CancellationToken& cancel) {
+  if (!open_) {
+    return APP_ERROR_IO;
+  }
+
+  if (request_cb_) {
+    (request_cb_)(request);
+  }
+
+  uint32_t status_code = NuggetClient::CallAppCancellable(appId, arg, request,
+                                                          response, cancel);
+
+  if (response != nullptr && response_cb_) {
+    (response_cb_)(status_code, *response);
+  }
+
+  return status_code;
+}
+
+uint32_t NuggetClientDebuggable::CallAppRaw(uint32_t appId, uint16_t arg,
+                                            const uint8_t* request,
+                                            uint32_t requestSize,
+                                            uint8_t* response,
+                                            uint32_t* responseSize) {
+  return NuggetClientInterface::CallAppRaw(appId, arg, request, requestSize,
+                                           response, responseSize);
+}
+
+uint32_t NuggetClientDebuggable::CallAppChunked(
+    uint32_t appId, uint16_t arg, const std::vector<uint8_t>& request,
+    ReplyChunks* response, const CancellationToken* cancel) {
+  return NuggetClientInterface::CallAppChunked(appId, arg, request, response,
+                                               cancel);
+}
+
+uint32_t NuggetClientDebuggable::CallAppStreamed(
+    uint32_t appId, uint16_t arg, const StreamedRequest& request,
+    ReplyChunks* response, const CancellationToken* cancel) {
+  return NuggetClientInterface::CallAppStreamed(appId, arg, request, response,
+                                                cancel);
+}
+
+uint32_t NuggetClientDebuggable::CallAppStreamed(
+    uint32_t appId, uint16_t arg, const StreamedRequest& request,
+    ReplyChunks* response, const CancellationToken* cancel,
+    const MethodInfo&) {
+  return NuggetClientInterface::CallAppStreamed(appId, arg, request, response,
+                                                cancel);
+}
+
 }  // namespace nos
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <nos/NuggetClientPool.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace nos {
+
+namespace {
+
+void AddDevice(void* names, const char* name) {
+  static_cast<std::vector<std::string>*>(names)->emplace_back(name);
+}
+
+}  // namespace
+
+NuggetClientPool::Lease::Lease(Lease&& other)
+    : pool_(other.pool_), index_(other.index_) {
+  other.pool_ = nullptr;
+}
+
+NuggetClientPool::Lease& NuggetClientPool::Lease::operator=(Lease&& other) {
+  if (this != &other) {
+    Release();
+    pool_ = other.pool_;
+    index_ = other.index_;
+    other.pool_ = nullptr;
+  }
+  return *this;
+}
+
+NuggetClientPool::Lease::~Lease() {
+  Release();
+}
+
+NuggetClient& NuggetClientPool::Lease::Client() const {
+  return *pool_->devices_[index_].client;
+}
+
+void NuggetClientPool::Lease::Release() {
+  if (pool_ != nullptr) {
+    pool_->Release(index_);
+    pool_ = nullptr;
+  }
+}
+
+std::vector<std::string> NuggetClientPool::FindDevices(Enumerator enumerate) {
+  std::vector<std::string> names;
+  if (enumerate(AddDevice, &names) < 0) {
+    return {};
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+NuggetClientPool::NuggetClientPool(Enumerator enumerate)
+    : NuggetClientPool(FindDevices(enumerate)) {
+}
+
+NuggetClientPool::NuggetClientPool(const std::vector<std::string>& names)
+    : devices_(names.size()), next_(0), stats_start_(Clock::now()) {
+  for (size_t i = 0; i < names.size(); ++i) {
+    devices_[i].client.reset(new NuggetClient(names[i]));
+  }
+}
+
+NuggetClientPool::~NuggetClientPool() {
+  Close();
+}
+
+size_t NuggetClientPool::Open() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t open = 0;
+  for (Device& device : devices_) {
+    device.client->Open();
+    if (device.client->IsOpen()) {
+      ++open;
+    }
+  }
+  /* Waiters may have given up on there being no open device */
+  idle_cv_.notify_all();
+  return open;
+}
+
+void NuggetClientPool::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Device& device : devices_) {
+    device.client->Close();
+  }
+}
+
+size_t NuggetClientPool::Size() const {
+  return devices_.size();
+}
+
+NuggetClientPool::Lease NuggetClientPool::Acquire(size_t index) {
+  if (index >= devices_.size()) {
+    return Lease();
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [&] { return !devices_[index].leased; });
+  LeaseLocked(index);
+  return Lease(this, index);
+}
+
+NuggetClientPool::Lease NuggetClientPool::Acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    const size_t index = TakeIdleLocked();
+    if (index != devices_.size()) {
+      return Lease(this, index);
+    }
+    const bool anyOpen = std::any_of(
+        devices_.begin(), devices_.end(),
+        [](const Device& device) { return device.client->IsOpen(); });
+    if (!anyOpen) {
+      return Lease();
+    }
+    idle_cv_.wait(lock);
+  }
+}
+
+NuggetClientPool::Lease NuggetClientPool::TryAcquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t index = TakeIdleLocked();
+  if (index == devices_.size()) {
+    return Lease();
+  }
+  return Lease(this, index);
+}
+
+size_t NuggetClientPool::TakeIdleLocked() {
+  for (size_t n = 0; n < devices_.size(); ++n) {
+    const size_t index = (next_ + n) % devices_.size();
+    const Device& device = devices_[index];
+    if (!device.leased && device.client->IsOpen()) {
+      next_ = index + 1;
+      LeaseLocked(index);
+      return index;
+    }
+  }
+  return devices_.size();
+}
+
+void NuggetClientPool::LeaseLocked(size_t index) {
+  Device& device = devices_[index];
+  device.leased = true;
+  device.leased_at = Clock::now();
+  ++device.leases;
+}
+
+void NuggetClientPool::Release(size_t index) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Device& device = devices_[index];
+    device.busy += Clock::now() - std::max(device.leased_at, stats_start_);
+    device.leased = false;
+  }
+  idle_cv_.notify_all();
+}
+
+std::vector<NuggetClientPool::DeviceStats> NuggetClientPool::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Clock::time_point now = Clock::now();
+  const Clock::duration elapsed = now - stats_start_;
+  std::vector<DeviceStats> stats;
+  stats.reserve(devices_.size());
+  for (const Device& device : devices_) {
+    Clock::duration busy = device.busy;
+    if (device.leased) {
+      busy += now - std::max(device.leased_at, stats_start_);
+    }
+    stats.push_back({
+      device.client->DeviceName(),
+      device.client->IsOpen(),
+      device.leases,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(busy),
+      elapsed.count() > 0
+          ? static_cast<double>(busy.count()) / elapsed.count() : 0.0,
+    });
+  }
+  return stats;
+}
+
+void NuggetClientPool::ResetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_start_ = Clock::now();
+  for (Device& device : devices_) {
+    device.leases = 0;
+    device.busy = Clock::duration();
+  }
+}
+
+}  // namespace nos
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <nos/SecureSession.h>
+
+#include <app_nugget.h>
+
+namespace nos {
+
+SecureSession::SecureSession(NuggetClientInterface& client,
+                             Handshaker& handshaker)
+    : client_(client), handshaker_(handshaker), established_(false),
+      state_(0), handshakes_(0) {
+}
+
+uint32_t SecureSession::Establish() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (established_) {
+    return APP_SUCCESS;
+  }
+  return HandshakeLocked();
+}
+
+bool SecureSession::Established() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return established_;
+}
+
+void SecureSession::Invalidate() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  established_ = false;
+}
+
+void SecureSession::OnEvent(const event_report& event) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  switch (event.id) {
+    case EVENT_REBOOTED:
+      /* Citadel forgets the session when it reboots */
+      established_ = false;
+      break;
+    case EVENT_SEC_CH_STATE:
+      if (event.event.sec_ch_state.state != state_) {
+        established_ = false;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+uint64_t SecureSession::Handshakes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return handshakes_;
+}
+
+uint32_t SecureSession::HandshakeLocked() {
+  ++handshakes_;
+  std::vector<uint8_t> request;
+  request.reserve(kHandshakeMessageSize);
+  if (!handshaker_.Start(&request)) {
+    return APP_ERROR_INTERNAL;
+  }
+
+  std::vector<uint8_t> reply;
+  reply.reserve(kHandshakeMessageSize);
+  uint32_t status = client_.CallApp(
+      APP_ID_NUGGET, NUGGET_PARAM_SECURE_TRANSPORT_HANDSHAKE, request, &reply);
+  if (status != APP_SUCCESS) {
+    return status;
+  }
+  /* Citadel replies with just its error state if it refused */
+  if (reply.size() != kHandshakeMessageSize) {
+    return APP_ERROR_RPC;
+  }
+  uint8_t state = 0;
+  const bool established = handshaker_.Finish(reply, &state);
+
+  /* Citadel is told how it went either way */
+  status = client_.CallApp(APP_ID_NUGGET,
+                           NUGGET_PARAM_SECURE_TRANSPORT_REPORT_STATE,
+                           {state}, nullptr);
+  if (status != APP_SUCCESS) {
+    return status;
+  }
+  if (!established) {
+    return APP_ERROR_RPC;
+  }
+  established_ = true;
+  state_ = state;
+  return APP_SUCCESS;
+}
+
+}  // namespace nos
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <nos/ThreadScheduling.h>
+
+#include <cerrno>
+
+#include <sched.h>
+#include <sys/resource.h>
+
+namespace nos {
+
+int SetIoThreadScheduling(int cpu, int nice) {
+  int result = 0;
+  if (cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    /* On Linux, 0 refers to the calling thread rather than the process */
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+      result = -errno;
+    }
+  }
+
+  if (setpriority(PRIO_PROCESS, 0, nice) != 0) {
+    result = -errno;
+  }
+  return result;
+}
+
+}  // namespace nos
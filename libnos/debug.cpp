@@ -17,6 +17,7 @@
 #include <nos/debug.h>
 
 #include <application.h>
+#include <nos/status.h>
 
 namespace nos {
 
@@ -35,6 +36,8 @@ std::string StatusCodeString(uint32_t code) {
     ErrorString_helper(APP_ERROR_CHECKSUM)
     ErrorString_helper(APP_ERROR_BUSY)
     ErrorString_helper(APP_ERROR_TIMEOUT)
+    case NOS_ERROR_CANCELLED:
+      return "NOS_ERROR_CANCELLED";
     default:
       if (code >= APP_LINE_NUMBER_BASE && code < MAX_APP_STATUS) {
         return "APP_LINE_NUMBER " + std::to_string(code - APP_LINE_NUMBER_BASE);
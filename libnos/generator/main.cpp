@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <functional>
 #include <map>
 #include <string>
@@ -28,6 +29,8 @@
 
 #include "nugget/protobuf/options.pb.h"
 
+using ::google::protobuf::Descriptor;
+using ::google::protobuf::FieldDescriptor;
 using ::google::protobuf::FileDescriptor;
 using ::google::protobuf::JoinStrings;
 using ::google::protobuf::MethodDescriptor;
@@ -41,8 +44,12 @@ using ::google::protobuf::io::Printer;
 using ::google::protobuf::io::ZeroCopyOutputStream;
 
 using ::nugget::protobuf::app_id;
+using ::nugget::protobuf::batchable;
+using ::nugget::protobuf::expected_latency_ms;
+using ::nugget::protobuf::priority;
 using ::nugget::protobuf::request_buffer_size;
 using ::nugget::protobuf::response_buffer_size;
+using ::nugget::protobuf::timeout_ms;
 
 namespace {
 
@@ -115,6 +122,17 @@ void CloseNamespaces(Printer& printer, const Descriptor& descriptor) {
     }
 }
 
+std::string MethodPriority(const MethodDescriptor& method) {
+    switch (method.options().GetExtension(priority)) {
+    case ::nugget::protobuf::PRIORITY_INTERACTIVE:
+        return "::nos::CallPriority::INTERACTIVE";
+    case ::nugget::protobuf::PRIORITY_BACKGROUND:
+        return "::nos::CallPriority::BACKGROUND";
+    default:
+        return "::nos::CallPriority::NORMAL";
+    }
+}
+
 void ForEachMethod(const ServiceDescriptor& service,
                    std::function<void(std::map<std::string, std::string>)> handler) {
     for (int i = 0; i < service.method_count(); ++i) {
@@ -124,11 +142,126 @@ void ForEachMethod(const ServiceDescriptor& service,
         vars["method_name"] = method.name();
         vars["method_input_type"] = FullyQualifiedIdentifier(*method.input_type());
         vars["method_output_type"] = FullyQualifiedIdentifier(*method.output_type());
+        vars["method_expected_latency_ms"] = std::to_string(
+                method.options().GetExtension(expected_latency_ms));
+        vars["method_timeout_ms"] = std::to_string(method.options().GetExtension(timeout_ms));
+        vars["method_priority"] = MethodPriority(method);
         handler(vars);
     }
 }
 
-void GenerateMockClient(Printer& printer, const ServiceDescriptor& service) {
+// Calls the handler for each method marked as batchable
+void ForEachBatchMethod(const ServiceDescriptor& service,
+                        std::function<void(std::map<std::string, std::string>)> handler) {
+    ForEachMethod(service, [&](std::map<std::string, std::string> vars) {
+        const MethodDescriptor& method = *service.FindMethodByName(vars["method_name"]);
+        if (method.options().GetExtension(batchable)) {
+            handler(vars);
+        }
+    });
+}
+
+// Generation options following the kind of output in the parameter
+struct Options {
+    // Expose the bytes fields of responses as views in a response handle
+    bool views = false;
+    // Time each call and pass it to the nos::MetricsSink
+    bool metrics = false;
+};
+
+// Matches kMaxViewDepth in nos/ResponseHandle.h
+constexpr size_t kMaxViewDepth = 4;
+
+struct ViewField {
+    std::vector<int> numbers;
+    std::vector<std::string> names;
+};
+
+// Find the singular bytes fields of a message, including those in singular
+// message fields, that can be viewed rather than copied.
+void FindViewFields(const Descriptor& message, ViewField& prefix,
+                    std::vector<const Descriptor*>& visiting,
+                    std::vector<ViewField>& fields) {
+    visiting.push_back(&message);
+    for (int i = 0; i < message.field_count(); ++i) {
+        const FieldDescriptor& field = *message.field(i);
+        if (field.is_repeated()) {
+            continue;
+        }
+        prefix.numbers.push_back(field.number());
+        prefix.names.push_back(field.name());
+        if (field.type() == FieldDescriptor::TYPE_BYTES) {
+            fields.push_back(prefix);
+        } else if (field.type() == FieldDescriptor::TYPE_MESSAGE
+                   && prefix.numbers.size() < kMaxViewDepth
+                   && std::find(visiting.begin(), visiting.end(),
+                                field.message_type()) == visiting.end()) {
+            FindViewFields(*field.message_type(), prefix, visiting, fields);
+        }
+        prefix.numbers.pop_back();
+        prefix.names.pop_back();
+    }
+    visiting.pop_back();
+}
+
+std::vector<ViewField> ViewFields(const MethodDescriptor& method) {
+    ViewField prefix;
+    std::vector<const Descriptor*> visiting;
+    std::vector<ViewField> fields;
+    FindViewFields(*method.output_type(), prefix, visiting, fields);
+    return fields;
+}
+
+// Calls the handler for each method with a response handle
+void ForEachViewMethod(const ServiceDescriptor& service, const Options& options,
+                       std::function<void(std::map<std::string, std::string>,
+                                          const std::vector<ViewField>&)> handler) {
+    if (!options.views) {
+        return;
+    }
+    for (int i = 0; i < service.method_count(); ++i) {
+        const MethodDescriptor& method = *service.method(i);
+        const auto fields = ViewFields(method);
+        if (fields.empty()) {
+            continue;
+        }
+        std::map<std::string, std::string> vars;
+        vars["method_id"] = std::to_string(i);
+        vars["method_name"] = method.name();
+        vars["method_input_type"] = FullyQualifiedIdentifier(*method.input_type());
+        vars["method_output_type"] = FullyQualifiedIdentifier(*method.output_type());
+        vars["handle_class"] = method.name() + "Handle";
+        handler(vars, fields);
+    }
+}
+
+// Sets the variables splicing nos::CallRecorder calls into a method body, which
+// are empty unless the calls are timed
+void SetRecorderVars(const Options& options, const std::string& replySize,
+                     std::map<std::string, std::string>& vars) {
+    if (!options.metrics) {
+        vars["record_start"] = "";
+        vars["record_request"] = "";
+        vars["record_call"] = "";
+        vars["record_reply"] = "";
+        vars["finish_open"] = "";
+        vars["finish_close"] = "";
+        vars["streamed_request"] = "messageRequest";
+        return;
+    }
+    vars["record_start"] = "    ::nos::CallRecorder recorder(\"" + vars["service"] + "\", "
+                           + vars["method_name"] + "Info());\n";
+    vars["record_request"] =
+            "    const ::nos::CallRecorder::Request streamedRequest(messageRequest, recorder);\n";
+    vars["record_call"] = "    recorder.StartCall(request_size);\n";
+    vars["record_reply"] = "    recorder.EndCall(" + replySize + ");\n";
+    vars["finish_open"] = "recorder.Finish(";
+    vars["finish_close"] = ")";
+    vars["streamed_request"] = "streamedRequest";
+}
+
+void GenerateMockClient(Printer& printer, const ServiceDescriptor& service,
+                        const Options& options) {
     std::map<std::string, std::string> vars;
     vars["include_guard"] = "PROTOC_GENERATED_MOCK_" + service.name() + "_CLIENT_H";
     vars["service_header"] = service.name() + ".client.h";
@@ -148,9 +281,35 @@ void GenerateMockClient(Printer& printer, const ServiceDescriptor& service) {
     printer.Print(vars, R"(
 struct $mock_class$ : public I$class$ {)");
 
+    // Keep the response handle overloads, which call the mocked methods
+    ForEachViewMethod(service, options, [&](std::map<std::string, std::string> methodVars,
+                                            const std::vector<ViewField>&) {
+        methodVars.insert(vars.begin(), vars.end());
+        printer.Print(methodVars, R"(
+    using I$class$::$method_name$;)");
+    });
+
     ForEachMethod(service, [&](std::map<std::string, std::string> methodVars) {
         printer.Print(methodVars, R"(
-    MOCK_METHOD2($method_name$, uint32_t(const $method_input_type$&, $method_output_type$*));)");
+    MOCK_METHOD2($method_name$, uint32_t(const $method_input_type$&, $method_output_type$*));
+    MOCK_METHOD3($method_name$, uint32_t(const $method_input_type$&, $method_output_type$*,
+                                         const ::nos::CancellationToken&));)");
+    });
+
+    printer.Print(vars, R"(
+};)");
+
+    // The callback variant of the asynchronous methods, keeping the helpers
+    printer.Print(vars, R"(
+
+struct $mock_class$Async : public I$class$Async {)");
+
+    ForEachMethod(service, [&](std::map<std::string, std::string> methodVars) {
+        methodVars.insert(vars.begin(), vars.end());
+        printer.Print(methodVars, R"(
+    using I$class$Async::$method_name$;
+    MOCK_METHOD4($method_name$, void(const $method_input_type$&, $method_output_type$*,
+                                     const ::nos::CancellationToken*, Done));)");
     });
 
     printer.Print(vars, R"(
@@ -162,21 +321,38 @@ struct $mock_class$ : public I$class$ {)");
 #endif)");
 }
 
-void GenerateClientHeader(Printer& printer, const ServiceDescriptor& service) {
+void GenerateClientHeader(Printer& printer, const ServiceDescriptor& service,
+                          const Options& options) {
     std::map<std::string, std::string> vars;
     vars["include_guard"] = "PROTOC_GENERATED_" + service.name() + "_CLIENT_H";
     vars["protobuf_header"] = FullyQualifiedHeader(service);
     vars["class"] = service.name();
     vars["iface_class"] = "I" + service.name();
     vars["app_id"] = "APP_ID_" + service.options().GetExtension(app_id);
+    vars["max_response_size"] = std::to_string(
+            service.options().GetExtension(response_buffer_size));
 
     printer.Print(vars, R"(
 #ifndef $include_guard$
 #define $include_guard$
 
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
 #include <application.h>
 #include <nos/AppClient.h>
-#include <nos/NuggetClientInterface.h>
+#include <nos/CancellationToken.h>
+#include <nos/MethodInfo.h>
+#include <nos/NuggetClientInterface.h>)");
+
+    if (options.views) {
+        printer.Print(vars, R"(
+#include <nos/ResponseHandle.h>)");
+    }
+
+    printer.Print(vars, R"(
 
 #include "$protobuf_header$")");
 
@@ -188,9 +364,100 @@ class $iface_class$ {
 public:
     virtual ~$iface_class$() = default;)");
 
+    // What the protos say about each method
     ForEachMethod(service, [&](std::map<std::string, std::string> methodVars) {
         printer.Print(methodVars, R"(
-    virtual uint32_t $method_name$(const $method_input_type$&, $method_output_type$*) = 0;)");
+    static constexpr ::nos::MethodInfo $method_name$Info() {
+        return {"$method_name$", $method_id$, $method_expected_latency_ms$, $method_timeout_ms$,
+                $method_priority$};
+    })");
+    });
+
+    ForEachMethod(service, [&](std::map<std::string, std::string> methodVars) {
+        printer.Print(methodVars, R"(
+    virtual uint32_t $method_name$(const $method_input_type$&, $method_output_type$*) = 0;
+    virtual uint32_t $method_name$(const $method_input_type$& request, $method_output_type$* response,
+                                   const ::nos::CancellationToken& cancel) {
+        if (cancel.IsCancelled()) {
+            return NOS_ERROR_CANCELLED;
+        }
+        return $method_name$(request, response);
+    })");
+    });
+
+    // Batches of calls, made one at a time by default
+    ForEachBatchMethod(service, [&](std::map<std::string, std::string> methodVars) {
+        printer.Print(methodVars, R"(
+    virtual uint32_t $method_name$Batch(const std::vector<$method_input_type$>& requests,
+                                        std::vector<$method_output_type$>* responses) {
+        if (responses != nullptr) {
+            responses->resize(requests.size());
+        }
+        for (size_t i = 0; i < requests.size(); ++i) {
+            const uint32_t appStatus = $method_name$(requests[i],
+                                                     (responses != nullptr) ? &(*responses)[i] : nullptr);
+            if (appStatus != APP_SUCCESS) {
+                return appStatus;
+            }
+        }
+        return APP_SUCCESS;
+    })");
+    });
+
+    // Response handles with views of the bytes fields, filled in from the
+    // message by default so other implementations need not know about them
+    ForEachViewMethod(service, options, [&](std::map<std::string, std::string> methodVars,
+                                            const std::vector<ViewField>& fields) {
+        methodVars.insert(vars.begin(), vars.end());
+        methodVars["view_count"] = std::to_string(fields.size());
+        printer.Print(methodVars, R"(
+
+    class $handle_class$ : public ::nos::ResponseHandle<$method_output_type$> {
+    public:
+        $handle_class$() : ResponseHandle($max_response_size$, Paths(), $view_count$) {})");
+        for (size_t i = 0; i < fields.size(); ++i) {
+            std::map<std::string, std::string> fieldVars;
+            JoinStrings(fields[i].names, "_", &fieldVars["accessor"]);
+            fieldVars["index"] = std::to_string(i);
+            printer.Print(fieldVars, R"(
+        ::nos::ByteView $accessor$() const { return View($index$); })");
+        }
+        printer.Print(methodVars, R"(
+    private:
+        static const ::nos::ViewPath* Paths() {
+            static constexpr ::nos::ViewPath paths[] = {)");
+        for (const auto& field : fields) {
+            std::vector<std::string> numbers;
+            for (const int number : field.numbers) {
+                numbers.push_back(std::to_string(number));
+            }
+            std::map<std::string, std::string> fieldVars;
+            fieldVars["depth"] = std::to_string(field.numbers.size());
+            JoinStrings(numbers, ", ", &fieldVars["numbers"]);
+            printer.Print(fieldVars, R"(
+                {$depth$, {$numbers$}},)");
+        }
+        printer.Print(methodVars, R"(
+            };
+            return paths;
+        }
+    };
+
+    virtual uint32_t $method_name$(const $method_input_type$& request, $handle_class$* response) {
+        $method_output_type$ message;
+        const uint32_t appStatus = $method_name$(request, (response != nullptr) ? &message : nullptr);
+        if (appStatus == APP_SUCCESS && response != nullptr && !response->Assign(message)) {
+            return APP_ERROR_RPC;
+        }
+        return appStatus;
+    }
+    virtual uint32_t $method_name$(const $method_input_type$& request, $handle_class$* response,
+                                   const ::nos::CancellationToken& cancel) {
+        if (cancel.IsCancelled()) {
+            return NOS_ERROR_CANCELLED;
+        }
+        return $method_name$(request, response);
+    })");
     });
 
     printer.Print(vars, R"(
@@ -206,7 +473,75 @@ public:
 
     ForEachMethod(service, [&](std::map<std::string, std::string> methodVars) {
         printer.Print(methodVars, R"(
-    uint32_t $method_name$(const $method_input_type$&, $method_output_type$*) override;)");
+    uint32_t $method_name$(const $method_input_type$&, $method_output_type$*) override;
+    uint32_t $method_name$(const $method_input_type$&, $method_output_type$*,
+                           const ::nos::CancellationToken&) override;)");
+    });
+
+    ForEachBatchMethod(service, [&](std::map<std::string, std::string> methodVars) {
+        printer.Print(methodVars, R"(
+    uint32_t $method_name$Batch(const std::vector<$method_input_type$>&,
+                                std::vector<$method_output_type$>*) override;)");
+    });
+
+    ForEachViewMethod(service, options, [&](std::map<std::string, std::string> methodVars,
+                                            const std::vector<ViewField>&) {
+        printer.Print(methodVars, R"(
+    uint32_t $method_name$(const $method_input_type$&, $handle_class$*) override;
+    uint32_t $method_name$(const $method_input_type$&, $handle_class$*,
+                           const ::nos::CancellationToken&) override;)");
+    });
+
+    printer.Print(vars, R"(
+};)");
+
+    // Asynchronous interface, with the callback variant to implement and
+    // helpers for the common ways of calling it
+    printer.Print(vars, R"(
+
+class $iface_class$Async {
+public:
+    using Done = ::nos::NuggetClientInterface::AsyncDone;
+
+    virtual ~$iface_class$Async() = default;)");
+
+    ForEachMethod(service, [&](std::map<std::string, std::string> methodVars) {
+        printer.Print(methodVars, R"(
+    virtual void $method_name$(const $method_input_type$& request, $method_output_type$* response,
+                               const ::nos::CancellationToken* cancel, Done done) = 0;
+    void $method_name$(const $method_input_type$& request, $method_output_type$* response, Done done) {
+        $method_name$(request, response, nullptr, std::move(done));
+    }
+    std::future<uint32_t> $method_name$(const $method_input_type$& request,
+                                        $method_output_type$* response,
+                                        const ::nos::CancellationToken* cancel = nullptr) {
+        auto promise = std::make_shared<std::promise<uint32_t>>();
+        std::future<uint32_t> future = promise->get_future();
+        $method_name$(request, response, cancel, [promise](uint32_t appStatus) {
+            promise->set_value(appStatus);
+        });
+        return future;
+    })");
+    });
+
+    printer.Print(vars, R"(
+};)");
+
+    // Asynchronous implementation for Nugget
+    printer.Print(vars, R"(
+
+class $class$Async : public $iface_class$Async {
+    ::nos::AppClient _app;
+public:
+    $class$Async(::nos::NuggetClientInterface& client) : _app{client, $app_id$} {}
+    ~$class$Async() override = default;)");
+
+    ForEachMethod(service, [&](std::map<std::string, std::string> methodVars) {
+        methodVars.insert(vars.begin(), vars.end());
+        printer.Print(methodVars, R"(
+    using $iface_class$Async::$method_name$;
+    void $method_name$(const $method_input_type$&, $method_output_type$*,
+                       const ::nos::CancellationToken*, Done) override;)");
     });
 
     printer.Print(vars, R"(
@@ -218,10 +553,12 @@ public:
 #endif)");
 }
 
-void GenerateClientSource(Printer& printer, const ServiceDescriptor& service) {
+void GenerateClientSource(Printer& printer, const ServiceDescriptor& service,
+                          const Options& options) {
     std::map<std::string, std::string> vars;
     vars["generated_header"] = service.name() + ".client.h";
     vars["class"] = service.name();
+    vars["service"] = service.full_name();
 
     const uint32_t max_request_size = service.options().GetExtension(request_buffer_size);
     const uint32_t max_response_size = service.options().GetExtension(response_buffer_size);
@@ -231,36 +568,187 @@ void GenerateClientSource(Printer& printer, const ServiceDescriptor& service) {
     printer.Print(vars, R"(
 #include <$generated_header$>
 
-#include <application.h>)");
+#include <application.h>
+#include <nos/MessageRequest.h>
+#include <nos/ReplyChunksInputStream.h>)");
+
+    if (options.metrics) {
+        printer.Print(vars, R"(
+#include <nos/MethodMetrics.h>)");
+    }
 
     OpenNamespaces(printer, service);
 
-    // Methods
+    // Methods, each with a cancellable variant
     ForEachMethod(service, [&](std::map<std::string, std::string>  methodVars) {
         methodVars.insert(vars.begin(), vars.end());
-        printer.Print(methodVars, R"(
-uint32_t $class$::$method_name$(const $method_input_type$& request, $method_output_type$* response) {
-    const size_t request_size = request.ByteSizeLong();
+        for (const bool cancellable : {false, true}) {
+            methodVars["cancel_param"] = cancellable ? ",\n        const ::nos::CancellationToken& cancel" : "";
+            methodVars["cancel_arg"] = cancellable ? "&cancel" : "nullptr";
+            SetRecorderVars(options, "responseChunks.Size()", methodVars);
+            printer.Print(methodVars, R"(
+uint32_t $class$::$method_name$(const $method_input_type$& request, $method_output_type$* response$cancel_param$) {
+$record_start$    const size_t request_size = request.ByteSizeLong();
     if (request_size > $max_request_size$) {
-        return APP_ERROR_TOO_MUCH;
+        return $finish_open$APP_ERROR_TOO_MUCH$finish_close$;
+    }
+    const ::nos::MessageRequest messageRequest(request, request_size);
+$record_request$    ::nos::ReplyChunks responseChunks($max_response_size$);
+$record_call$    uint32_t appStatus = _app.CallStreamed($method_id$, $streamed_request$,
+                                           (response != nullptr) ? &responseChunks : nullptr,
+                                           $cancel_arg$, $method_name$Info());
+$record_reply$    if (appStatus == APP_SUCCESS && response != nullptr) {
+        ::nos::ReplyChunksInputStream responseStream(responseChunks);
+        if (!response->ParseFromZeroCopyStream(&responseStream)) {
+            appStatus = APP_ERROR_RPC;
+        }
+    }
+    return $finish_open$appStatus$finish_close$;
+})");
+        }
+    });
+
+    // Batches, serialized together up front and received into one buffer
+    ForEachBatchMethod(service, [&](std::map<std::string, std::string> methodVars) {
+        methodVars.insert(vars.begin(), vars.end());
+        SetRecorderVars(options, "responseChunks.Size()", methodVars);
+        if (options.metrics) {
+            // Each call is recorded from its reply, the first including the
+            // time spent serializing the whole batch
+            methodVars["record_call"] =
+                    "    if (!requests.empty()) {\n"
+                    "        recorder.StartCall(sizes[0]);\n"
+                    "    }\n";
+            methodVars["record_reply"] = "        recorder.EndCall(responseChunks.Size());\n";
+            methodVars["record_next"] =
+                    "        recorder.Finish(appStatus);\n"
+                    "        if (index + 1 < requests.size()) {\n"
+                    "            recorder.Restart();\n"
+                    "            recorder.StartCall(sizes[index + 1]);\n"
+                    "        }\n";
+        } else {
+            methodVars["record_next"] = "";
+        }
+        printer.Print(methodVars, R"(
+uint32_t $class$::$method_name$Batch(const std::vector<$method_input_type$>& requests,
+                                     std::vector<$method_output_type$>* responses) {
+$record_start$    std::vector<size_t> sizes(requests.size());
+    size_t total_size = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        sizes[i] = requests[i].ByteSizeLong();
+        if (sizes[i] > $max_request_size$) {
+            return $finish_open$APP_ERROR_TOO_MUCH$finish_close$;
+        }
+        total_size += sizes[i];
+    }
+    std::vector<uint8_t> arena(total_size);
+    std::vector<::nos::BufferRequest> streamedRequests;
+    std::vector<const ::nos::StreamedRequest*> batch;
+    streamedRequests.reserve(requests.size());
+    batch.reserve(requests.size());
+    uint8_t* next = arena.data();
+    for (size_t i = 0; i < requests.size(); ++i) {
+        requests[i].SerializeWithCachedSizesToArray(next);
+        streamedRequests.emplace_back(next, sizes[i]);
+        batch.push_back(&streamedRequests.back());
+        next += sizes[i];
     }
-    std::vector<uint8_t> buffer(request_size);
-    if (!request.SerializeToArray(buffer.data(), buffer.size())) {
-        return APP_ERROR_RPC;
+    if (responses != nullptr) {
+        // Parsing replaces the messages so their storage can be reused
+        responses->resize(requests.size());
     }
-    std::vector<uint8_t> responseBuffer;
+    ::nos::ReplyChunks responseChunks($max_response_size$);
+$record_call$    return _app.CallBatch($method_id$, batch, (responses != nullptr) ? &responseChunks : nullptr,
+                          nullptr, $method_name$Info(),
+                          [&](size_t index, uint32_t appStatus) {
+$record_reply$        if (appStatus == APP_SUCCESS && responses != nullptr) {
+            ::nos::ReplyChunksInputStream responseStream(responseChunks);
+            if (!(*responses)[index].ParseFromZeroCopyStream(&responseStream)) {
+                appStatus = APP_ERROR_RPC;
+            }
+        }
+$record_next$        return appStatus;
+    });
+})");
+    });
+
+    // Asynchronous methods, which own the request and the reply until done
+    ForEachMethod(service, [&](std::map<std::string, std::string> methodVars) {
+        methodVars.insert(vars.begin(), vars.end());
+        if (options.metrics) {
+            // Recorded from the completion, so the transport includes the time
+            // spent queued and producing the request
+            methodVars["record_start"] =
+                    "    const auto recorder = std::make_shared<::nos::CallRecorder>(\""
+                    + vars["service"] + "\", I" + vars["class"] + "::"
+                    + methodVars["method_name"] + "Info());\n";
+            methodVars["record_call"] = "    recorder->StartCall(streamedRequest->Size());\n";
+            methodVars["record_reply"] =
+                    "        recorder->EndCall(responseChunks ? responseChunks->Size() : 0);\n";
+            methodVars["finish_open"] = "recorder->Finish(";
+            methodVars["finish_close"] = ")";
+            methodVars["recorder_capture"] = ", recorder";
+        } else {
+            methodVars["record_start"] = "";
+            methodVars["record_call"] = "";
+            methodVars["record_reply"] = "";
+            methodVars["finish_open"] = "";
+            methodVars["finish_close"] = "";
+            methodVars["recorder_capture"] = "";
+        }
+        printer.Print(methodVars, R"(
+void $class$Async::$method_name$(const $method_input_type$& request, $method_output_type$* response,
+        const ::nos::CancellationToken* cancel, Done done) {
+$record_start$    std::unique_ptr<const ::nos::StreamedRequest> streamedRequest(
+            new ::nos::OwnedMessageRequest<$method_input_type$>(request));
+    if (streamedRequest->Size() > $max_request_size$) {
+        done($finish_open$APP_ERROR_TOO_MUCH$finish_close$);
+        return;
+    }
+    std::shared_ptr<::nos::ReplyChunks> responseChunks;
     if (response != nullptr) {
-      responseBuffer.resize($max_response_size$);
+        responseChunks = std::make_shared<::nos::ReplyChunks>($max_response_size$);
     }
-    const uint32_t appStatus = _app.Call($method_id$, buffer,
-                                         (response != nullptr) ? &responseBuffer : nullptr);
-    if (appStatus == APP_SUCCESS && response != nullptr) {
-        if (!response->ParseFromArray(responseBuffer.data(), responseBuffer.size())) {
-            return APP_ERROR_RPC;
+    ::nos::ReplyChunks* chunks = responseChunks.get();
+$record_call$    _app.CallAsync($method_id$, std::move(streamedRequest), chunks, cancel,
+                   I$class$::$method_name$Info(),
+                   [response, responseChunks, done$recorder_capture$](uint32_t appStatus) {
+$record_reply$        if (appStatus == APP_SUCCESS && response != nullptr) {
+            ::nos::ReplyChunksInputStream responseStream(*responseChunks);
+            if (!response->ParseFromZeroCopyStream(&responseStream)) {
+                appStatus = APP_ERROR_RPC;
+            }
         }
+        done($finish_open$appStatus$finish_close$);
+    });
+})");
+    });
+
+    // Methods receiving into a response handle
+    ForEachViewMethod(service, options, [&](std::map<std::string, std::string> methodVars,
+                                            const std::vector<ViewField>&) {
+        methodVars.insert(vars.begin(), vars.end());
+        for (const bool cancellable : {false, true}) {
+            methodVars["cancel_param"] = cancellable ? ",\n        const ::nos::CancellationToken& cancel" : "";
+            methodVars["cancel_arg"] = cancellable ? "&cancel" : "nullptr";
+            SetRecorderVars(options, "(responseChunks != nullptr) ? responseChunks->Size() : 0",
+                            methodVars);
+            printer.Print(methodVars, R"(
+uint32_t $class$::$method_name$(const $method_input_type$& request, $handle_class$* response$cancel_param$) {
+$record_start$    const size_t request_size = request.ByteSizeLong();
+    if (request_size > $max_request_size$) {
+        return $finish_open$APP_ERROR_TOO_MUCH$finish_close$;
+    }
+    const ::nos::MessageRequest messageRequest(request, request_size);
+$record_request$    ::nos::ReplyChunks* responseChunks = (response != nullptr) ? response->Receive() : nullptr;
+$record_call$    uint32_t appStatus = _app.CallStreamed($method_id$, $streamed_request$, responseChunks,
+                                           $cancel_arg$, $method_name$Info());
+$record_reply$    if (appStatus == APP_SUCCESS && response != nullptr && !response->Parse()) {
+        appStatus = APP_ERROR_RPC;
     }
-    return appStatus;
+    return $finish_open$appStatus$finish_close$;
 })");
+        }
     });
 
     CloseNamespaces(printer, service);
@@ -276,6 +764,21 @@ public:
                   const std::string& parameter,
                   OutputDirectory* output_directory,
                   std::string* error) const override {
+        std::vector<std::string> params;
+        SplitStringUsing(parameter, ",", &params);
+        const std::string kind = params.empty() ? "" : params[0];
+        Options options;
+        for (size_t i = 1; i < params.size(); ++i) {
+            if (params[i] == "views") {
+                options.views = true;
+            } else if (params[i] == "metrics") {
+                options.metrics = true;
+            } else {
+                *error = "Illegal option: " + params[i];
+                return false;
+            }
+        }
+
         for (int i = 0; i < file->service_count(); ++i) {
             const auto& service = *file->service(i);
 
@@ -284,23 +787,23 @@ public:
                 return false;
             }
 
-            if (parameter == "mock") {
+            if (kind == "mock") {
                 std::unique_ptr<ZeroCopyOutputStream> output{
                         output_directory->Open("Mock" + service.name() + ".client.h")};
                 Printer printer(output.get(), '$');
-                GenerateMockClient(printer, service);
-            } else if (parameter == "header") {
+                GenerateMockClient(printer, service, options);
+            } else if (kind == "header") {
                 std::unique_ptr<ZeroCopyOutputStream> output{
                         output_directory->Open(service.name() + ".client.h")};
                 Printer printer(output.get(), '$');
-                GenerateClientHeader(printer, service);
-            } else if (parameter == "source") {
+                GenerateClientHeader(printer, service, options);
+            } else if (kind == "source") {
                 std::unique_ptr<ZeroCopyOutputStream> output{
                         output_directory->Open(service.name() + ".client.cpp")};
                 Printer printer(output.get(), '$');
-                GenerateClientSource(printer, service);
+                GenerateClientSource(printer, service, options);
             } else {
-                *error = "Illegal parameter: must be mock|header|source";
+                *error = "Illegal parameter: must be mock|header|source[,views][,metrics]";
                 return false;
             }
         }
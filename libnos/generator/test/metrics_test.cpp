@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Built with the client generated with the metrics option.
+
+#include <Hello.client.h>
+
+#include <nos/MethodMetrics.h>
+#include <nos/MockNuggetClient.h>
+
+#include <gtest/gtest.h>
+
+using ::nos::MockNuggetClient;
+using ::nos::generator::test::EmptyRequest;
+using ::nos::generator::test::GreetRequest;
+using ::nos::generator::test::GreetResponse;
+using ::nos::generator::test::Hello;
+using ::nos::generator::test::HelloAsync;
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Eq;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+
+namespace {
+
+struct RecordingSink : public ::nos::MetricsSink {
+    std::vector<::nos::CallMetrics> calls;
+    void Record(const ::nos::CallMetrics& metrics) override {
+        calls.push_back(metrics);
+    }
+};
+
+std::vector<uint8_t> Greeting(const std::string& greeting) {
+    GreetResponse response;
+    response.set_greeting(greeting);
+    std::vector<uint8_t> bytes(response.ByteSize());
+    response.SerializeToArray(bytes.data(), bytes.size());
+    return bytes;
+}
+
+}  // namespace
+
+// With the metrics option, each call is timed and passed to the sink.
+TEST(GeneratedServiceClientTest, CallsRecordedToMetricsSink) {
+    RecordingSink sink;
+    ::nos::SetMetricsSink(&sink);
+
+    MockNuggetClient client;
+    Hello service{client};
+
+    GreetRequest request;
+    request.set_who("Tester");
+    GreetResponse response;
+    response.set_greeting("Hello, Tester");
+    std::vector<uint8_t> responseBytes(response.ByteSize());
+    ASSERT_TRUE(response.SerializeToArray(responseBytes.data(), responseBytes.size()));
+
+    EXPECT_CALL(client, CallApp(APP_ID_TEST, 3, _, _))
+            .WillOnce(DoAll(SetArgPointee<3>(responseBytes), Return(APP_SUCCESS)));
+    EXPECT_CALL(client, CallApp(APP_ID_TEST, 0, _, _)).WillOnce(Return(APP_ERROR_BOGUS_ARGS));
+
+    GreetResponse real_response;
+    EXPECT_THAT(service.Greet(request, &real_response), Eq(APP_SUCCESS));
+    EmptyRequest empty;
+    EXPECT_THAT(service.First(empty, nullptr), Eq(APP_ERROR_BOGUS_ARGS));
+    GreetRequest tooLong;
+    tooLong.set_who("This is far too long for the buffer so should fail");
+    EXPECT_THAT(service.Greet(tooLong, &real_response), Eq(APP_ERROR_TOO_MUCH));
+
+    ::nos::SetMetricsSink(nullptr);
+    EXPECT_THAT(service.Greet(tooLong, &real_response), Eq(APP_ERROR_TOO_MUCH));
+
+    ASSERT_THAT(sink.calls.size(), Eq(3u));
+    const ::nos::CallMetrics& greet = sink.calls[0];
+    EXPECT_THAT(std::string(greet.service), Eq("nos.generator.test.Hello"));
+    EXPECT_THAT(std::string(greet.method.name), Eq("Greet"));
+    EXPECT_THAT(greet.method.id, Eq(3u));
+    EXPECT_THAT(greet.request_bytes, Eq(request.ByteSizeLong()));
+    EXPECT_THAT(greet.response_bytes, Eq(responseBytes.size()));
+    EXPECT_THAT(greet.status, Eq(APP_SUCCESS));
+    EXPECT_GE(greet.serialize.count(), 0);
+    EXPECT_GE(greet.transport.count(), 0);
+    EXPECT_GE(greet.parse.count(), 0);
+
+    EXPECT_THAT(std::string(sink.calls[1].method.name), Eq("First"));
+    EXPECT_THAT(sink.calls[1].status, Eq(APP_ERROR_BOGUS_ARGS));
+    EXPECT_THAT(sink.calls[1].response_bytes, Eq(0u));
+    EXPECT_THAT(sink.calls[2].status, Eq(APP_ERROR_TOO_MUCH));
+    EXPECT_THAT(sink.calls[2].transport.count(), Eq(0));
+}
+
+// Each call of a batch is recorded on its own.
+TEST(GeneratedServiceClientTest, BatchCallsRecordedToMetricsSink) {
+    RecordingSink sink;
+    ::nos::SetMetricsSink(&sink);
+
+    MockNuggetClient client;
+    Hello service{client};
+
+    const std::vector<uint8_t> first = Greeting("Hello, A");
+    const std::vector<uint8_t> second = Greeting("Hello, Bee");
+    EXPECT_CALL(client, CallApp(APP_ID_TEST, 3, _, _))
+            .WillOnce(DoAll(SetArgPointee<3>(first), Return(APP_SUCCESS)))
+            .WillOnce(DoAll(SetArgPointee<3>(second), Return(APP_SUCCESS)))
+            .WillOnce(Return(APP_ERROR_BOGUS_ARGS));
+
+    std::vector<GreetRequest> requests(3);
+    requests[0].set_who("A");
+    requests[1].set_who("Bee");
+    requests[2].set_who("C");
+    std::vector<GreetResponse> responses;
+    EXPECT_THAT(service.GreetBatch(requests, &responses), Eq(APP_ERROR_BOGUS_ARGS));
+    ::nos::SetMetricsSink(nullptr);
+
+    ASSERT_THAT(sink.calls.size(), Eq(3u));
+    for (size_t i = 0; i < sink.calls.size(); ++i) {
+        EXPECT_THAT(std::string(sink.calls[i].method.name), Eq("Greet"));
+        EXPECT_THAT(sink.calls[i].request_bytes, Eq(requests[i].ByteSizeLong()));
+        EXPECT_GE(sink.calls[i].transport.count(), 0);
+    }
+    EXPECT_THAT(sink.calls[0].response_bytes, Eq(first.size()));
+    EXPECT_THAT(sink.calls[1].response_bytes, Eq(second.size()));
+    EXPECT_THAT(sink.calls[0].status, Eq(APP_SUCCESS));
+    EXPECT_THAT(sink.calls[1].status, Eq(APP_SUCCESS));
+    EXPECT_THAT(sink.calls[2].status, Eq(APP_ERROR_BOGUS_ARGS));
+}
+
+// Asynchronous calls are recorded once they complete.
+TEST(GeneratedServiceClientTest, AsyncCallsRecordedToMetricsSink) {
+    RecordingSink sink;
+    ::nos::SetMetricsSink(&sink);
+
+    MockNuggetClient client;
+    HelloAsync service{client};
+
+    const std::vector<uint8_t> greeting = Greeting("Hello, Tester");
+    EXPECT_CALL(client, CallApp(APP_ID_TEST, 3, _, _))
+            .WillOnce(DoAll(SetArgPointee<3>(greeting), Return(APP_SUCCESS)));
+
+    GreetRequest request;
+    request.set_who("Tester");
+    GreetResponse response;
+    EXPECT_THAT(service.Greet(request, &response).get(), Eq(APP_SUCCESS));
+    GreetRequest tooLong;
+    tooLong.set_who("This is far too long for the buffer so should fail");
+    EXPECT_THAT(service.Greet(tooLong, &response).get(), Eq(APP_ERROR_TOO_MUCH));
+    ::nos::SetMetricsSink(nullptr);
+
+    ASSERT_THAT(sink.calls.size(), Eq(2u));
+    EXPECT_THAT(std::string(sink.calls[0].service), Eq("nos.generator.test.Hello"));
+    EXPECT_THAT(std::string(sink.calls[0].method.name), Eq("Greet"));
+    EXPECT_THAT(sink.calls[0].request_bytes, Eq(request.ByteSizeLong()));
+    EXPECT_THAT(sink.calls[0].response_bytes, Eq(greeting.size()));
+    EXPECT_THAT(sink.calls[0].status, Eq(APP_SUCCESS));
+    EXPECT_THAT(sink.calls[1].status, Eq(APP_ERROR_TOO_MUCH));
+    EXPECT_THAT(sink.calls[1].transport.count(), Eq(0));
+}
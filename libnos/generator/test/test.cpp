@@ -19,6 +19,8 @@
 
 #include <google/protobuf/util/message_differencer.h>
 
+#include <nos/MessageRequest.h>
+#include <nos/MethodMetrics.h>
 #include <nos/MockNuggetClient.h>
 
 #include <gtest/gtest.h>
@@ -28,15 +30,20 @@ using ::google::protobuf::util::MessageDifferencer;
 using ::nos::MockNuggetClient;
 using ::nos::generator::test::EmptyRequest;
 using ::nos::generator::test::EmptyResponse;
+using ::nos::generator::test::FetchResponse;
 using ::nos::generator::test::GreetRequest;
 using ::nos::generator::test::GreetResponse;
 using ::nos::generator::test::Hello;
+using ::nos::generator::test::HelloAsync;
 using ::nos::generator::test::IHello;
+using ::nos::generator::test::IHelloAsync;
 using ::nos::generator::test::MockHello;
+using ::nos::generator::test::MockHelloAsync;
 
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::Eq;
+using ::testing::Invoke;
 using ::testing::Return;
 using ::testing::SetArgPointee;
 
@@ -140,6 +147,150 @@ TEST(GeneratedServiceClientTest, GarbledResponseIsRpcFailure) {
     EXPECT_THAT(service.Greet(request, &response), Eq(APP_ERROR_RPC));
 }
 
+// A client that delivers the reply in many small chunks, as it would arrive
+// from the device in datagrams.
+struct ChunkingNuggetClient : public MockNuggetClient {
+    uint32_t CallAppChunked(uint32_t appId, uint16_t arg,
+                            const std::vector<uint8_t>& request,
+                            ::nos::ReplyChunks* response,
+                            const ::nos::CancellationToken*) override {
+        std::vector<uint8_t> reply;
+        const uint32_t status = CallApp(appId, arg, request, &reply);
+        response->Clear();
+        for (size_t i = 0; i < reply.size(); i += 3) {
+            const size_t len = std::min<size_t>(3, reply.size() - i);
+            std::copy_n(reply.begin() + i, len, response->Append(len));
+        }
+        return status;
+    }
+};
+
+// The response is parsed from the chunks without being reassembled.
+TEST(GeneratedServiceClientTest, ResponseParsedFromChunks) {
+    ChunkingNuggetClient client;
+    Hello service{client};
+
+    GreetResponse response;
+    response.set_greeting("Hello in pieces");
+
+    std::vector<uint8_t> responseBytes(response.ByteSizeLong());
+    ASSERT_TRUE(response.SerializeToArray(responseBytes.data(), responseBytes.size()));
+
+    EXPECT_CALL(client, CallApp(_, _, _, _))
+            .WillOnce(DoAll(SetArgPointee<3>(responseBytes), Return(APP_SUCCESS)));
+
+    GreetRequest request;
+    GreetResponse real_response;
+    EXPECT_THAT(service.Greet(request, &real_response), Eq(APP_SUCCESS));
+    EXPECT_THAT(real_response, ProtoMessageEq(response));
+}
+
+std::string ViewString(::nos::ByteView view) {
+    return std::string(view.begin(), view.end());
+}
+
+FetchResponse MakeFetchResponse() {
+    FetchResponse response;
+    response.set_id(42);
+    response.set_blob("a blob spanning chunks");
+    response.mutable_envelope()->set_payload("payload");
+    response.mutable_envelope()->set_label("label");
+    response.add_extras("copied");
+    response.set_stamp(0x0123456789abcdefull);
+    response.set_offset(-7);
+    return response;
+}
+
+// Bytes fields are viewed in the retained reply and the rest is parsed.
+TEST(GeneratedServiceClientTest, ResponseHandleViewsBytesFields) {
+    MockNuggetClient client;
+    Hello service{client};
+
+    const FetchResponse response = MakeFetchResponse();
+    std::vector<uint8_t> responseBytes(response.ByteSizeLong());
+    ASSERT_TRUE(response.SerializeToArray(responseBytes.data(), responseBytes.size()));
+
+    EXPECT_CALL(client, CallApp(_, _, _, _))
+            .WillOnce(DoAll(SetArgPointee<3>(responseBytes), Return(APP_SUCCESS)));
+
+    EmptyRequest request;
+    IHello::FetchHandle handle;
+    EXPECT_THAT(service.Fetch(request, &handle), Eq(APP_SUCCESS));
+    EXPECT_THAT(ViewString(handle.blob()), Eq(response.blob()));
+    EXPECT_THAT(ViewString(handle.envelope_payload()), Eq(response.envelope().payload()));
+    EXPECT_THAT(handle->id(), Eq(42u));
+    EXPECT_THAT(handle->envelope().label(), Eq("label"));
+    EXPECT_THAT(handle->extras_size(), Eq(1));
+    EXPECT_THAT(handle->stamp(), Eq(0x0123456789abcdefull));
+    EXPECT_THAT(handle->offset(), Eq(-7));
+    EXPECT_TRUE(handle->blob().empty());
+    EXPECT_TRUE(handle->envelope().payload().empty());
+}
+
+// Fields split across chunks are joined.
+TEST(GeneratedServiceClientTest, ResponseHandleJoinsFieldsAcrossChunks) {
+    ChunkingNuggetClient client;
+    Hello service{client};
+
+    const FetchResponse response = MakeFetchResponse();
+    std::vector<uint8_t> responseBytes(response.ByteSizeLong());
+    ASSERT_TRUE(response.SerializeToArray(responseBytes.data(), responseBytes.size()));
+
+    EXPECT_CALL(client, CallApp(_, _, _, _))
+            .WillOnce(DoAll(SetArgPointee<3>(responseBytes), Return(APP_SUCCESS)));
+
+    EmptyRequest request;
+    IHello::FetchHandle handle;
+    EXPECT_THAT(service.Fetch(request, &handle), Eq(APP_SUCCESS));
+    EXPECT_THAT(ViewString(handle.blob()), Eq(response.blob()));
+    EXPECT_THAT(ViewString(handle.envelope_payload()), Eq(response.envelope().payload()));
+    EXPECT_THAT(handle->envelope().label(), Eq("label"));
+    EXPECT_THAT(handle->extras(0), Eq("copied"));
+    EXPECT_THAT(handle->stamp(), Eq(0x0123456789abcdefull));
+}
+
+// A truncated response is an RPC error rather than a short view.
+TEST(GeneratedServiceClientTest, ResponseHandleRejectsTruncatedField) {
+    MockNuggetClient client;
+    Hello service{client};
+
+    const FetchResponse response = MakeFetchResponse();
+    std::vector<uint8_t> responseBytes(response.ByteSizeLong());
+    ASSERT_TRUE(response.SerializeToArray(responseBytes.data(), responseBytes.size()));
+    responseBytes.resize(5);
+
+    EXPECT_CALL(client, CallApp(_, _, _, _))
+            .WillOnce(DoAll(SetArgPointee<3>(responseBytes), Return(APP_SUCCESS)));
+
+    EmptyRequest request;
+    IHello::FetchHandle handle;
+    EXPECT_THAT(service.Fetch(request, &handle), Eq(APP_ERROR_RPC));
+}
+
+// Large requests are produced a datagram at a time.
+TEST(GeneratedServiceClientTest, RequestStreamedInDatagrams) {
+    GreetRequest request;
+    request.set_who(std::string(2 * MAX_DEVICE_TRANSFER + 100, 'x'));
+    request.set_age(3);
+    const ::nos::MessageRequest streamed(request, request.ByteSizeLong());
+
+    struct RecordingSink : public ::nos::StreamedRequest::Sink {
+        std::vector<uint8_t> data;
+        std::vector<size_t> sizes;
+        bool Write(const uint8_t* bytes, size_t len) override {
+            data.insert(data.end(), bytes, bytes + len);
+            sizes.push_back(len);
+            return true;
+        }
+    } sink;
+
+    ASSERT_TRUE(streamed.WriteTo(sink));
+    ASSERT_THAT(sink.sizes.size(), Eq(3u));
+    EXPECT_THAT(sink.sizes[0], Eq(size_t{MAX_DEVICE_TRANSFER}));
+    EXPECT_THAT(sink.sizes[1], Eq(size_t{MAX_DEVICE_TRANSFER}));
+    EXPECT_THAT(sink.data, DecodesToProtoMessage(request));
+}
+
 // Sending too much data will fail before beginning a transaction with the chip.
 TEST(GeneratedServiceClientTest, RequestLargerThanBuffer) {
     MockNuggetClient client;
@@ -154,6 +305,254 @@ TEST(GeneratedServiceClientTest, RequestLargerThanBuffer) {
     EXPECT_THAT(service.Greet(request, &response), Eq(APP_ERROR_TOO_MUCH));
 }
 
+// A cancelled call fails before beginning a transaction with the chip.
+TEST(GeneratedServiceClientTest, CancelledCallIsNotSent) {
+    MockNuggetClient client;
+    Hello service{client};
+
+    EXPECT_CALL(client, CallApp(_, _, _, _)).Times(0);
+
+    ::nos::CancellationToken cancel;
+    cancel.Cancel();
+
+    GreetRequest request;
+    GreetResponse response;
+    EXPECT_THAT(service.Greet(request, &response, cancel), Eq(NOS_ERROR_CANCELLED));
+}
+
+// The options of each method are available as constants.
+TEST(GeneratedServiceClientTest, MethodInfoFromOptions) {
+    static_assert(IHello::GreetInfo().id == 3, "Greet is the fourth method");
+    static_assert(IHello::GreetInfo().expected_latency_ms == 5, "Greet latency");
+    static_assert(IHello::GreetInfo().timeout_ms == 100, "Greet timeout");
+    static_assert(IHello::GreetInfo().priority == ::nos::CallPriority::INTERACTIVE,
+                  "Greet priority");
+    static_assert(IHello::FetchInfo().priority == ::nos::CallPriority::BACKGROUND,
+                  "Fetch priority");
+
+    constexpr ::nos::MethodInfo first = IHello::FirstInfo();
+    EXPECT_THAT(std::string(first.name), Eq("First"));
+    EXPECT_THAT(first.expected_latency_ms, Eq(0u));
+    EXPECT_THAT(first.timeout_ms, Eq(0u));
+    EXPECT_THAT(first.priority, Eq(::nos::CallPriority::NORMAL));
+}
+
+// Each call says which method it is for.
+TEST(GeneratedServiceClientTest, MethodInfoPassedWithCall) {
+    struct MethodRecordingClient : public MockNuggetClient {
+        std::vector<std::string> methods;
+        uint32_t CallAppStreamed(uint32_t appId, uint16_t arg,
+                                 const ::nos::StreamedRequest& request,
+                                 ::nos::ReplyChunks* response,
+                                 const ::nos::CancellationToken* cancel,
+                                 const ::nos::MethodInfo& method) override {
+            methods.push_back(std::string(method.name) + " "
+                              + std::to_string(method.timeout_ms));
+            return NuggetClientInterface::CallAppStreamed(appId, arg, request, response,
+                                                          cancel, method);
+        }
+    } client;
+    Hello service{client};
+
+    EXPECT_CALL(client, CallApp(APP_ID_TEST, _, _, _)).WillRepeatedly(Return(APP_SUCCESS));
+
+    EmptyRequest empty;
+    EmptyResponse emptyResponse;
+    EXPECT_THAT(service.Second(empty, &emptyResponse), Eq(APP_SUCCESS));
+    GreetRequest request;
+    GreetResponse response;
+    EXPECT_THAT(service.Greet(request, &response), Eq(APP_SUCCESS));
+    IHello::FetchHandle handle;
+    EXPECT_THAT(service.Fetch(empty, &handle), Eq(APP_SUCCESS));
+
+    EXPECT_THAT(client.methods,
+                Eq(std::vector<std::string>{"Second 0", "Greet 100", "Fetch 0"}));
+}
+
+// Each request of a batch is sent in turn and its reply parsed.
+TEST(GeneratedServiceClientTest, BatchCallsEachRequestInOrder) {
+    MockNuggetClient client;
+    Hello service{client};
+
+    std::vector<GreetRequest> requests(3);
+    std::vector<GreetResponse> responses(3);
+    ::testing::InSequence sequence;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        requests[i].set_who("Tester " + std::to_string(i));
+        responses[i].set_greeting("Hello, Tester " + std::to_string(i));
+        std::vector<uint8_t> responseBytes(responses[i].ByteSize());
+        ASSERT_TRUE(responses[i].SerializeToArray(responseBytes.data(), responseBytes.size()));
+        EXPECT_CALL(client, CallApp(APP_ID_TEST, 3, DecodesToProtoMessage(requests[i]), _))
+                .WillOnce(DoAll(SetArgPointee<3>(responseBytes), Return(APP_SUCCESS)));
+    }
+
+    std::vector<GreetResponse> real_responses;
+    EXPECT_THAT(service.GreetBatch(requests, &real_responses), Eq(APP_SUCCESS));
+    ASSERT_THAT(real_responses.size(), Eq(responses.size()));
+    for (size_t i = 0; i < responses.size(); ++i) {
+        EXPECT_THAT(real_responses[i], ProtoMessageEq(responses[i]));
+    }
+}
+
+// A batch stops at the first call to fail.
+TEST(GeneratedServiceClientTest, BatchStopsAtFirstError) {
+    MockNuggetClient client;
+    Hello service{client};
+
+    EXPECT_CALL(client, CallApp(APP_ID_TEST, 3, _, _))
+            .WillOnce(Return(APP_SUCCESS))
+            .WillOnce(Return(APP_ERROR_BOGUS_ARGS));
+
+    const std::vector<GreetRequest> requests(4);
+    std::vector<GreetResponse> responses;
+    EXPECT_THAT(service.GreetBatch(requests, &responses), Eq(APP_ERROR_BOGUS_ARGS));
+
+    GreetRequest tooLong;
+    tooLong.set_who("This is far too long for the buffer so should fail");
+    EXPECT_THAT(service.GreetBatch({GreetRequest(), tooLong}, &responses),
+                Eq(APP_ERROR_TOO_MUCH));
+}
+
+// Clients that can send a batch together get all of the requests at once.
+TEST(GeneratedServiceClientTest, BatchHandedToClientTogether) {
+    struct BatchingClient : public MockNuggetClient {
+        std::vector<std::vector<uint8_t>> requests;
+        uint32_t CallAppBatch(uint32_t, uint16_t arg,
+                              const std::vector<const ::nos::StreamedRequest*>& batch,
+                              ::nos::ReplyChunks* response, const ::nos::CancellationToken*,
+                              const ::nos::MethodInfo& method,
+                              const BatchReply& reply) override {
+            EXPECT_THAT(arg, Eq(method.id));
+            for (const ::nos::StreamedRequest* request : batch) {
+                requests.emplace_back();
+                EXPECT_TRUE(request->Flatten(&requests.back()));
+            }
+            for (size_t i = 0; i < batch.size(); ++i) {
+                GreetResponse greeting;
+                greeting.set_greeting(std::to_string(i));
+                std::vector<uint8_t> bytes(greeting.ByteSize());
+                greeting.SerializeToArray(bytes.data(), bytes.size());
+                EXPECT_TRUE(response->Assign(bytes));
+                const uint32_t status = reply(i, APP_SUCCESS);
+                if (status != APP_SUCCESS) {
+                    return status;
+                }
+            }
+            return APP_SUCCESS;
+        }
+    } client;
+    Hello service{client};
+
+    EXPECT_CALL(client, CallApp(_, _, _, _)).Times(0);
+
+    std::vector<GreetRequest> requests(2);
+    requests[0].set_who("A");
+    requests[1].set_who("B");
+    std::vector<GreetResponse> responses;
+    EXPECT_THAT(service.GreetBatch(requests, &responses), Eq(APP_SUCCESS));
+    ASSERT_THAT(client.requests.size(), Eq(2u));
+    EXPECT_THAT(client.requests[0], DecodesToProtoMessage(requests[0]));
+    EXPECT_THAT(client.requests[1], DecodesToProtoMessage(requests[1]));
+    ASSERT_THAT(responses.size(), Eq(2u));
+    EXPECT_THAT(responses[1].greeting(), Eq("1"));
+}
+
+// Without the metrics option, calls aren't passed to the sink.
+TEST(GeneratedServiceClientTest, CallsNotRecordedWithoutMetrics) {
+    struct CountingSink : public ::nos::MetricsSink {
+        int calls = 0;
+        void Record(const ::nos::CallMetrics&) override {
+            ++calls;
+        }
+    } sink;
+    ::nos::SetMetricsSink(&sink);
+
+    MockNuggetClient client;
+    Hello service{client};
+
+    EXPECT_CALL(client, CallApp(APP_ID_TEST, 0, _, _)).WillOnce(Return(APP_SUCCESS));
+    EmptyRequest empty;
+    EXPECT_THAT(service.First(empty, nullptr), Eq(APP_SUCCESS));
+
+    ::nos::SetMetricsSink(nullptr);
+    EXPECT_THAT(sink.calls, Eq(0));
+}
+
+// Clients that can't call asynchronously finish the call straight away.
+TEST(GeneratedServiceClientTest, AsyncCallThroughSynchronousClient) {
+    MockNuggetClient client;
+    HelloAsync service{client};
+
+    GreetRequest request;
+    request.set_who("Tester");
+    GreetResponse response;
+    response.set_greeting("Hello, Tester");
+    std::vector<uint8_t> responseBytes(response.ByteSize());
+    ASSERT_TRUE(response.SerializeToArray(responseBytes.data(), responseBytes.size()));
+
+    EXPECT_CALL(client, CallApp(APP_ID_TEST, 3, DecodesToProtoMessage(request), _))
+            .WillOnce(DoAll(SetArgPointee<3>(responseBytes), Return(APP_SUCCESS)));
+
+    GreetResponse real_response;
+    std::future<uint32_t> status = service.Greet(request, &real_response);
+    ASSERT_THAT(status.wait_for(std::chrono::seconds(0)), Eq(std::future_status::ready));
+    EXPECT_THAT(status.get(), Eq(APP_SUCCESS));
+    EXPECT_THAT(real_response, ProtoMessageEq(response));
+}
+
+// The request is kept until it is sent and the reply until it is parsed.
+TEST(GeneratedServiceClientTest, AsyncCallOutlivesCaller) {
+    struct DeferringClient : public MockNuggetClient {
+        std::unique_ptr<const ::nos::StreamedRequest> request;
+        ::nos::ReplyChunks* response = nullptr;
+        AsyncDone done;
+        void CallAppAsync(uint32_t, uint16_t, std::unique_ptr<const ::nos::StreamedRequest> r,
+                          ::nos::ReplyChunks* chunks, const ::nos::CancellationToken*,
+                          const ::nos::MethodInfo&, AsyncDone d) override {
+            request = std::move(r);
+            response = chunks;
+            done = std::move(d);
+        }
+    } client;
+    HelloAsync service{client};
+
+    GreetRequest sent;
+    sent.set_who("Tester");
+    GreetResponse real_response;
+    uint32_t status = APP_ERROR_INTERNAL;
+    {
+        const GreetRequest request = sent;
+        service.Greet(request, &real_response, [&](uint32_t appStatus) { status = appStatus; });
+    }
+    ASSERT_TRUE(client.done);
+
+    std::vector<uint8_t> requestBytes;
+    ASSERT_TRUE(client.request->Flatten(&requestBytes));
+    EXPECT_THAT(requestBytes, DecodesToProtoMessage(sent));
+
+    GreetResponse response;
+    response.set_greeting("Hello, Tester");
+    std::vector<uint8_t> responseBytes(response.ByteSize());
+    ASSERT_TRUE(response.SerializeToArray(responseBytes.data(), responseBytes.size()));
+    ASSERT_TRUE(client.response->Assign(responseBytes));
+    client.done(APP_SUCCESS);
+    EXPECT_THAT(status, Eq(APP_SUCCESS));
+    EXPECT_THAT(real_response, ProtoMessageEq(response));
+}
+
+// Asynchronous requests that are too large fail without a call.
+TEST(GeneratedServiceClientTest, AsyncRequestLargerThanBuffer) {
+    MockNuggetClient client;
+    HelloAsync service{client};
+
+    EXPECT_CALL(client, CallApp(_, _, _, _)).Times(0);
+
+    GreetRequest request;
+    request.set_who("This is far too long for the buffer so should fail");
+    GreetResponse response;
+    EXPECT_THAT(service.Greet(request, &response).get(), Eq(APP_ERROR_TOO_MUCH));
+}
+
 // Example using generate service mocks.
 TEST(GeneratedServiceClientTest, CanUseGeneratedMocks) {
     MockHello mockService;
@@ -172,3 +571,36 @@ TEST(GeneratedServiceClientTest, CanUseGeneratedMocks) {
     EXPECT_THAT(service.Greet(request, &real_response), Eq(APP_SUCCESS));
     EXPECT_THAT(real_response, ProtoMessageEq(response));
 }
+
+// Mocks fill in the response handle from the message they return.
+TEST(GeneratedServiceClientTest, GeneratedMocksFillResponseHandles) {
+    MockHello mockService;
+
+    const FetchResponse response = MakeFetchResponse();
+    EXPECT_CALL(mockService, Fetch(_, _))
+            .WillOnce(DoAll(SetArgPointee<1>(response), Return(APP_SUCCESS)));
+
+    EmptyRequest request;
+    MockHello::FetchHandle handle;
+    EXPECT_THAT(mockService.Fetch(request, &handle), Eq(APP_SUCCESS));
+    EXPECT_THAT(ViewString(handle.blob()), Eq(response.blob()));
+    EXPECT_THAT(handle->id(), Eq(42u));
+}
+
+// The asynchronous mocks only need the callback variant set up.
+TEST(GeneratedServiceClientTest, CanUseGeneratedAsyncMocks) {
+    MockHelloAsync mockService;
+
+    EXPECT_CALL(mockService, Greet(_, _, _, _))
+            .WillOnce(Invoke([](const GreetRequest&, GreetResponse* response,
+                                const ::nos::CancellationToken*, IHelloAsync::Done done) {
+                response->set_greeting("I made this up");
+                done(APP_SUCCESS);
+            }));
+
+    IHelloAsync& service = mockService;
+    GreetRequest request;
+    GreetResponse response;
+    EXPECT_THAT(service.Greet(request, &response).get(), Eq(APP_SUCCESS));
+    EXPECT_THAT(response.greeting(), Eq("I made this up"));
+}
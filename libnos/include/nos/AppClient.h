@@ -18,9 +18,15 @@
 #define NOS_APP_CLIENT_H
 
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <nos/CancellationToken.h>
 #include <nos/NuggetClientInterface.h>
+#include <nos/NuggetParams.h>
 
 namespace nos {
 
@@ -51,8 +57,202 @@ public:
         return _client.CallApp(_appId, arg, request, response);
     }
 
+    /**
+     * Call a command of the app with the structs NuggetParam gives for it.
+     *
+     * The types are checked when compiling and the structs are passed to the
+     * transport where they are, so these calls need no vectors or copies.
+     *
+     * @param request Request for the command.
+     * @param reply   Receives the reply, zeroed past the end of what was sent.
+     * @return        Status code from the app, APP_ERROR_RPC if the reply was
+     *                too short or APP_ERROR_BOGUS_ARGS if this client isn't
+     *                for the command's app.
+     */
+    template <uint16_t Param, typename Request, typename Reply>
+    uint32_t Call(const Request& request, Reply* reply) {
+        static_assert(std::is_same<Request,
+                                   typename NuggetParam<Param>::Request>::value,
+                      "Wrong request type for the command");
+        static_assert(std::is_same<Reply,
+                                   typename NuggetParam<Param>::Reply>::value,
+                      "Wrong reply type for the command");
+        return CallStructs<Param>(&request, reply);
+    }
+
+    /**
+     * Call a command that takes no request, or only optionally.
+     */
+    template <uint16_t Param, typename Reply>
+    uint32_t Call(Reply* reply) {
+        static_assert(std::is_same<typename NuggetParam<Param>::Request,
+                                   NoData>::value ||
+                          NuggetParam<Param>::kRequestOptional,
+                      "The command needs a request");
+        static_assert(std::is_same<Reply,
+                                   typename NuggetParam<Param>::Reply>::value,
+                      "Wrong reply type for the command");
+        return CallStructs<Param>(static_cast<const NoData*>(nullptr), reply);
+    }
+
+    /**
+     * Call a command that has no reply.
+     */
+    template <uint16_t Param, typename Request>
+    uint32_t Call(const Request& request) {
+        static_assert(std::is_same<Request,
+                                   typename NuggetParam<Param>::Request>::value,
+                      "Wrong request type for the command");
+        static_assert(std::is_same<typename NuggetParam<Param>::Reply,
+                                   NoData>::value,
+                      "The command has a reply");
+        return CallStructs<Param>(&request, static_cast<NoData*>(nullptr));
+    }
+
+    /**
+     * Call a command that has neither a request nor a reply.
+     */
+    template <uint16_t Param>
+    uint32_t Call() {
+        static_assert(std::is_same<typename NuggetParam<Param>::Request,
+                                   NoData>::value,
+                      "The command needs a request");
+        static_assert(std::is_same<typename NuggetParam<Param>::Reply,
+                                   NoData>::value,
+                      "The command has a reply");
+        return CallStructs<Param>(static_cast<const NoData*>(nullptr),
+                                  static_cast<NoData*>(nullptr));
+    }
+
+    /**
+     * Call the app, abandoning the call if the token is cancelled.
+     *
+     * @param arg      Argument to pass to the app.
+     * @param request  Data to send to the app.
+     * @param response Buffer to receive data from the app.
+     * @param cancel   Token to abandon the call.
+     */
+    uint32_t Call(uint16_t arg, const std::vector<uint8_t>& request,
+                  std::vector<uint8_t>* response,
+                  const CancellationToken& cancel) {
+        return _client.CallAppCancellable(_appId, arg, request, response, cancel);
+    }
+
+    /**
+     * Call the app, receiving the reply in chunks.
+     *
+     * @param arg      Argument to pass to the app.
+     * @param request  Data to send to the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     */
+    uint32_t CallChunked(uint16_t arg, const std::vector<uint8_t>& request,
+                         ReplyChunks* response,
+                         const CancellationToken* cancel) {
+        return _client.CallAppChunked(_appId, arg, request, response, cancel);
+    }
+
+    /**
+     * Call the app, producing the request as it is sent and receiving the
+     * reply in chunks.
+     *
+     * @param arg      Argument to pass to the app.
+     * @param request  Request to produce for the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     */
+    uint32_t CallStreamed(uint16_t arg, const StreamedRequest& request,
+                          ReplyChunks* response,
+                          const CancellationToken* cancel) {
+        return _client.CallAppStreamed(_appId, arg, request, response, cancel);
+    }
+
+    /**
+     * Call a service method of the app, producing the request as it is sent
+     * and receiving the reply in chunks.
+     *
+     * @param arg      Argument to pass to the app.
+     * @param request  Request to produce for the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     * @param method   The method being called.
+     */
+    uint32_t CallStreamed(uint16_t arg, const StreamedRequest& request,
+                          ReplyChunks* response,
+                          const CancellationToken* cancel,
+                          const MethodInfo& method) {
+        return _client.CallAppStreamed(_appId, arg, request, response, cancel,
+                                       method);
+    }
+
+    /**
+     * Call a service method of the app without waiting for it to finish.
+     *
+     * @param arg      Argument to pass to the app.
+     * @param request  Request to produce for the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     * @param method   The method being called.
+     * @param done     Called with the status code from the app.
+     */
+    void CallAsync(uint16_t arg, std::unique_ptr<const StreamedRequest> request,
+                   ReplyChunks* response, const CancellationToken* cancel,
+                   const MethodInfo& method,
+                   NuggetClientInterface::AsyncDone done) {
+        _client.CallAppAsync(_appId, arg, std::move(request), response, cancel,
+                             method, std::move(done));
+    }
+
+    /**
+     * Call a service method of the app with each of several requests, back
+     * to back.
+     *
+     * @param arg      Argument to pass to the app.
+     * @param requests Requests to produce for the app.
+     * @param response Chunks to receive each reply, or nullptr.
+     * @param cancel   Token to abandon the batch, or nullptr.
+     * @param method   The method being called.
+     * @param reply    Called after each call with its index and status code.
+     */
+    uint32_t CallBatch(uint16_t arg,
+                       const std::vector<const StreamedRequest*>& requests,
+                       ReplyChunks* response, const CancellationToken* cancel,
+                       const MethodInfo& method,
+                       const NuggetClientInterface::BatchReply& reply) {
+        return _client.CallAppBatch(_appId, arg, requests, response, cancel,
+                                    method, reply);
+    }
 
 private:
+    template <uint16_t Param, typename Request, typename Reply>
+    uint32_t CallStructs(const Request* request, Reply* reply) {
+        static_assert(std::is_trivially_copyable<Request>::value &&
+                          std::is_trivially_copyable<Reply>::value,
+                      "Commands exchange plain structs");
+        constexpr bool hasRequest = !std::is_same<Request, NoData>::value;
+        constexpr bool hasReply = !std::is_same<Reply, NoData>::value;
+        if (_appId != NuggetParam<Param>::kAppId) {
+            return APP_ERROR_BOGUS_ARGS;
+        }
+
+        uint32_t replySize = hasReply ? sizeof(Reply) : 0;
+        const uint32_t status = _client.CallAppRaw(
+                _appId, Param,
+                hasRequest ? reinterpret_cast<const uint8_t*>(request) : nullptr,
+                hasRequest ? sizeof(Request) : 0,
+                hasReply ? reinterpret_cast<uint8_t*>(reply) : nullptr,
+                &replySize);
+        if (status != APP_SUCCESS || !hasReply) {
+            return status;
+        }
+        if (replySize < NuggetParam<Param>::kMinReplySize) {
+            return APP_ERROR_RPC;
+        }
+        memset(reinterpret_cast<uint8_t*>(reply) + replySize, 0,
+               sizeof(Reply) - replySize);
+        return APP_SUCCESS;
+    }
+
     NuggetClientInterface& _client;
     uint32_t _appId;
 };
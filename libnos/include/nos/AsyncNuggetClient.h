@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_ASYNC_NUGGET_CLIENT_H
+#define NOS_ASYNC_NUGGET_CLIENT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <nos/NuggetClientInterface.h>
+
+namespace nos {
+
+/**
+ * Makes asynchronous calls through another client on a single worker thread.
+ *
+ * Nugget works on one command at a time so the calls are queued rather than
+ * each given its own thread. Interactive methods are called before others and
+ * background methods last, otherwise calls are made in the order they were
+ * made. The callbacks are run on the worker thread so must not block for
+ * long, though they can make further calls.
+ *
+ * Synchronous calls are passed straight through, taking turns with the worker
+ * so the wrapped client is only used by one thread at a time.
+ */
+class AsyncNuggetClient : public NuggetClientInterface {
+public:
+    /**
+     * @param client Client to make the calls through, which must outlive this.
+     */
+    explicit AsyncNuggetClient(NuggetClientInterface& client);
+
+    /**
+     * Finishes the queued calls before returning.
+     */
+    ~AsyncNuggetClient() override;
+
+    AsyncNuggetClient(const AsyncNuggetClient&) = delete;
+    AsyncNuggetClient& operator=(const AsyncNuggetClient&) = delete;
+
+    void Open() override;
+    void Close() override;
+    bool IsOpen() const override;
+
+    uint32_t CallApp(uint32_t appId, uint16_t arg,
+                     const std::vector<uint8_t>& request,
+                     std::vector<uint8_t>* response) override;
+    uint32_t CallAppCancellable(uint32_t appId, uint16_t arg,
+                                const std::vector<uint8_t>& request,
+                                std::vector<uint8_t>* response,
+                                const CancellationToken& cancel) override;
+    uint32_t CallAppRaw(uint32_t appId, uint16_t arg, const uint8_t* request,
+                        uint32_t requestSize, uint8_t* response,
+                        uint32_t* responseSize) override;
+    uint32_t CallAppChunked(uint32_t appId, uint16_t arg,
+                            const std::vector<uint8_t>& request,
+                            ReplyChunks* response,
+                            const CancellationToken* cancel) override;
+    uint32_t CallAppStreamed(uint32_t appId, uint16_t arg,
+                             const StreamedRequest& request,
+                             ReplyChunks* response,
+                             const CancellationToken* cancel) override;
+    uint32_t CallAppStreamed(uint32_t appId, uint16_t arg,
+                             const StreamedRequest& request,
+                             ReplyChunks* response,
+                             const CancellationToken* cancel,
+                             const MethodInfo& method) override;
+    uint32_t CallAppBatch(uint32_t appId, uint16_t arg,
+                          const std::vector<const StreamedRequest*>& requests,
+                          ReplyChunks* response,
+                          const CancellationToken* cancel,
+                          const MethodInfo& method,
+                          const BatchReply& reply) override;
+
+    /**
+     * Queue a call for the worker thread and return straight away.
+     */
+    void CallAppAsync(uint32_t appId, uint16_t arg,
+                      std::unique_ptr<const StreamedRequest> request,
+                      ReplyChunks* response,
+                      const CancellationToken* cancel,
+                      const MethodInfo& method, AsyncDone done) override;
+
+    /**
+     * Reset the wrapped client once the call in progress, if any, is done.
+     * Warm-ups run by the reset may call through this client synchronously
+     * but must not wait for asynchronous calls, which are held back.
+     */
+    uint32_t Reset() const override;
+
+    /**
+     * As the wrapped client's EventsPending().
+     */
+    bool EventsPending() const override;
+
+    /**
+     * Number of asynchronous calls that have not started yet.
+     */
+    size_t Pending() const;
+
+    /**
+     * Set how the worker thread is scheduled, as with nos::SetIoThreadScheduling().
+     * Applied by the worker before its next call.
+     *
+     * @param cpu  CPU to pin the worker to, or -1 to allow any.
+     * @param nice Nice value for the worker, lower is higher priority.
+     */
+    void SetIoThreadScheduling(int cpu, int nice);
+
+private:
+    struct Call {
+        uint32_t appId;
+        uint16_t arg;
+        std::unique_ptr<const StreamedRequest> request;
+        ReplyChunks* response;
+        const CancellationToken* cancel;
+        MethodInfo method;
+        AsyncDone done;
+    };
+
+    void Work();
+
+    NuggetClientInterface& client_;
+
+    /* Held while the wrapped client is in use, including by warm-ups run
+     * on the resetting thread */
+    mutable std::recursive_mutex call_mutex_;
+
+    mutable std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    /* Queued calls of each priority, most urgent first */
+    std::deque<Call> queues_[3];
+    bool stopping_;
+    /* Scheduling for the worker to apply, if changed */
+    bool io_scheduling_changed_;
+    int io_cpu_;
+    int io_nice_;
+
+    std::thread worker_;
+};
+
+} // namespace nos
+
+#endif // NOS_ASYNC_NUGGET_CLIENT_H
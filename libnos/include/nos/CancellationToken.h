@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_CANCELLATION_TOKEN_H
+#define NOS_CANCELLATION_TOKEN_H
+
+#include <atomic>
+
+namespace nos {
+
+/**
+ * Token that lets another thread abandon calls into Nugget.
+ *
+ * A call made with the token returns NOS_ERROR_CANCELLED if the token is
+ * cancelled before the app finishes.
+ */
+class CancellationToken {
+public:
+    CancellationToken() = default;
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken& operator=(const CancellationToken&) = delete;
+
+    /**
+     * Abandon the calls using this token. Safe to call from any thread.
+     */
+    void Cancel() {
+        cancelled_.store(true, std::memory_order_release);
+    }
+
+    /**
+     * Checks whether the calls using this token should be abandoned.
+     */
+    bool IsCancelled() const {
+        return cancelled_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<bool> cancelled_{false};
+};
+
+} // namespace nos
+
+#endif // NOS_CANCELLATION_TOKEN_H
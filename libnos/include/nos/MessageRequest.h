@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_MESSAGE_REQUEST_H
+#define NOS_MESSAGE_REQUEST_H
+
+#include <cstdint>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <google/protobuf/message_lite.h>
+
+#include <nos/device.h>
+#include <nos/StreamedRequest.h>
+
+namespace nos {
+
+/**
+ * Sends what is written to it in datagram sized pieces.
+ *
+ * Only a single datagram is buffered. Each one is sent as soon as it is full
+ * so the bus is busy while the rest of the message is still being serialized.
+ *
+ * This is header only so libnos need not depend on protobuf; it is used by
+ * the generated service clients, which do.
+ */
+class DatagramOutputStream : public google::protobuf::io::ZeroCopyOutputStream {
+public:
+    explicit DatagramOutputStream(StreamedRequest::Sink& sink)
+            : sink_(sink), used_(0), position_(0), failed_(false) {}
+
+    bool Next(void** data, int* size) override {
+        if (used_ == sizeof(buffer_) && !Flush()) {
+            return false;
+        }
+        *data = buffer_ + used_;
+        *size = sizeof(buffer_) - used_;
+        used_ = sizeof(buffer_);
+        position_ += *size;
+        return true;
+    }
+
+    void BackUp(int count) override {
+        used_ -= count;
+        position_ -= count;
+    }
+
+    int64_t ByteCount() const override {
+        return position_;
+    }
+
+    /**
+     * Send anything that is still buffered.
+     *
+     * @return Whether everything written so far has been sent.
+     */
+    bool Flush() {
+        if (!failed_ && used_ != 0) {
+            failed_ = !sink_.Write(buffer_, used_);
+            used_ = 0;
+        }
+        return !failed_;
+    }
+
+private:
+    StreamedRequest::Sink& sink_;
+    uint8_t buffer_[MAX_DEVICE_TRANSFER];
+    size_t used_;
+    int64_t position_;
+    bool failed_;
+};
+
+/**
+ * A request that is serialized from a message as it is sent.
+ */
+class MessageRequest : public StreamedRequest {
+public:
+    /**
+     * @param message Message to send, which must not change until sent.
+     * @param size    Result of calling ByteSizeLong() on the message, which
+     *                also caches the sizes needed to serialize it.
+     */
+    MessageRequest(const google::protobuf::MessageLite& message, size_t size)
+            : message_(message), size_(size) {}
+
+    size_t Size() const override {
+        return size_;
+    }
+
+    bool WriteTo(Sink& sink) const override {
+        DatagramOutputStream stream(sink);
+        {
+            google::protobuf::io::CodedOutputStream coded(&stream);
+            message_.SerializeWithCachedSizes(&coded);
+            if (coded.HadError()) {
+                return false;
+            }
+        }
+        return stream.Flush();
+    }
+
+private:
+    const google::protobuf::MessageLite& message_;
+    size_t size_;
+};
+
+/**
+ * A request that is serialized from its own copy of a message as it is sent,
+ * for calls that outlive the caller's message.
+ */
+template <typename Message>
+class OwnedMessageRequest : public StreamedRequest {
+public:
+    explicit OwnedMessageRequest(const Message& message)
+            : message_(message), request_(message_, message_.ByteSizeLong()) {}
+
+    size_t Size() const override {
+        return request_.Size();
+    }
+
+    bool WriteTo(Sink& sink) const override {
+        return request_.WriteTo(sink);
+    }
+
+private:
+    const Message message_;
+    const MessageRequest request_;
+};
+
+} // namespace nos
+
+#endif // NOS_MESSAGE_REQUEST_H
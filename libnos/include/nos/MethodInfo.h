@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_METHOD_INFO_H
+#define NOS_METHOD_INFO_H
+
+#include <cstdint>
+
+namespace nos {
+
+/**
+ * How urgently a method's callers need it, as nugget.protobuf.Priority.
+ */
+enum class CallPriority : uint8_t {
+    NORMAL = 0,
+    INTERACTIVE = 1,
+    BACKGROUND = 2,
+};
+
+/**
+ * What is known about a service method from the options in its proto.
+ *
+ * The generated service clients have a constexpr MethodInfo for each method
+ * and pass it with each call. A zero latency or timeout means it wasn't given.
+ */
+struct MethodInfo {
+    const char* name;
+    uint16_t id;
+    uint32_t expected_latency_ms;
+    uint32_t timeout_ms;
+    CallPriority priority;
+};
+
+} // namespace nos
+
+#endif // NOS_METHOD_INFO_H
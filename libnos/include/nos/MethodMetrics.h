@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_METHOD_METRICS_H
+#define NOS_METHOD_METRICS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <nos/MethodInfo.h>
+#include <nos/StreamedRequest.h>
+
+namespace nos {
+
+/**
+ * Where the time went in a call to a service method.
+ *
+ * Serializing includes producing the request while it is being sent, and
+ * the transport is only the time spent sending and waiting on the device.
+ */
+struct CallMetrics {
+    const char* service;
+    MethodInfo method;
+    std::chrono::nanoseconds serialize;
+    std::chrono::nanoseconds transport;
+    std::chrono::nanoseconds parse;
+    size_t request_bytes;
+    size_t response_bytes;
+    uint32_t status;
+};
+
+/**
+ * Receives the metrics of calls made by service clients generated with the
+ * metrics option.
+ *
+ * Record() is called once the call has finished, on the thread that made it
+ * or, for asynchronous calls, the thread that completed it. It must be thread
+ * safe and should be quick.
+ */
+class MetricsSink {
+public:
+    virtual ~MetricsSink() = default;
+
+    virtual void Record(const CallMetrics& metrics) = 0;
+};
+
+/**
+ * Set the sink for all instrumented service clients in the process.
+ *
+ * @param sink Sink that must outlive any calls being made, or nullptr to stop
+ *             recording.
+ */
+void SetMetricsSink(MetricsSink* sink);
+
+/**
+ * The sink set for the process, or nullptr if there isn't one.
+ */
+MetricsSink* GetMetricsSink();
+
+/**
+ * Times the stages of a call for the instrumented service clients.
+ *
+ * Nothing is measured unless there was a sink when the call started.
+ */
+class CallRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Counts the time spent producing a request as serializing rather than
+     * as part of the transport.
+     */
+    class Request : public StreamedRequest {
+    public:
+        Request(const StreamedRequest& request, CallRecorder& recorder)
+                : request_(request), recorder_(recorder) {}
+
+        size_t Size() const override {
+            return request_.Size();
+        }
+
+        bool WriteTo(Sink& sink) const override {
+            if (recorder_.sink_ == nullptr) {
+                return request_.WriteTo(sink);
+            }
+            TimedSink timed(sink);
+            const Clock::time_point start = Clock::now();
+            const bool written = request_.WriteTo(timed);
+            recorder_.produce_ += (Clock::now() - start) - timed.writing;
+            return written;
+        }
+
+    private:
+        struct TimedSink : public Sink {
+            explicit TimedSink(Sink& sink) : sink(sink), writing(0) {}
+            bool Write(const uint8_t* data, size_t len) override {
+                const Clock::time_point start = Clock::now();
+                const bool written = sink.Write(data, len);
+                writing += Clock::now() - start;
+                return written;
+            }
+            Sink& sink;
+            Clock::duration writing;
+        };
+
+        const StreamedRequest& request_;
+        CallRecorder& recorder_;
+    };
+
+    CallRecorder(const char* service, const MethodInfo& method)
+            : sink_(GetMetricsSink()), metrics_{service, method, {}, {}, {}, 0, 0, 0},
+              produce_(0) {
+        if (sink_ != nullptr) {
+            start_ = Clock::now();
+        }
+    }
+
+    CallRecorder(const CallRecorder&) = delete;
+    CallRecorder& operator=(const CallRecorder&) = delete;
+
+    /**
+     * The request has been sized and is about to be sent.
+     */
+    void StartCall(size_t requestBytes) {
+        if (sink_ != nullptr) {
+            metrics_.request_bytes = requestBytes;
+            call_ = Clock::now();
+        }
+    }
+
+    /**
+     * The call has returned and the reply is about to be parsed.
+     */
+    void EndCall(size_t responseBytes) {
+        if (sink_ != nullptr) {
+            metrics_.response_bytes = responseBytes;
+            reply_ = Clock::now();
+            metrics_.transport = reply_ - call_ - produce_;
+            metrics_.serialize = call_ - start_ + produce_;
+        }
+    }
+
+    /**
+     * Start timing the next call of a batch once the last has been recorded.
+     * Its request was serialized up front with the first call's.
+     */
+    void Restart() {
+        if (sink_ != nullptr) {
+            metrics_ = {metrics_.service, metrics_.method, {}, {}, {}, 0, 0, 0};
+            start_ = Clock::now();
+            call_ = Clock::time_point();
+            reply_ = Clock::time_point();
+            produce_ = Clock::duration(0);
+        }
+    }
+
+    /**
+     * Record the call, including any time spent parsing since EndCall().
+     *
+     * @return The status, to be returned to the caller.
+     */
+    uint32_t Finish(uint32_t status) {
+        if (sink_ != nullptr) {
+            const Clock::time_point end = Clock::now();
+            if (reply_ == Clock::time_point()) {
+                /* Failed before the call was made */
+                metrics_.serialize = end - start_;
+            } else {
+                metrics_.parse = end - reply_;
+            }
+            metrics_.status = status;
+            sink_->Record(metrics_);
+        }
+        return status;
+    }
+
+private:
+    MetricsSink* const sink_;
+    CallMetrics metrics_;
+    Clock::time_point start_;
+    Clock::time_point call_;
+    Clock::time_point reply_;
+    /* Time spent producing the request while it was sent */
+    Clock::duration produce_;
+};
+
+} // namespace nos
+
+#endif // NOS_METHOD_METRICS_H
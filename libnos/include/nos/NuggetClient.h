@@ -17,12 +17,19 @@
 #ifndef NOS_NUGGET_CLIENT_H
 #define NOS_NUGGET_CLIENT_H
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <nos/device.h>
 #include <nos/NuggetClientInterface.h>
+#include <nos/transport.h>
 
 namespace nos {
 
@@ -72,11 +79,192 @@ public:
                      const std::vector<uint8_t>& request,
                      std::vector<uint8_t>* response) override;
 
+    /**
+     * Call into and app running on Nugget that can be abandoned.
+     *
+     * If the token is cancelled while the app is working, its status is
+     * cleared. An app still working is left to finish, and until then the
+     * next call to it returns APP_ERROR_BUSY.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param request  Data to send to the app.
+     * @param response Buffer to receive data from the app.
+     * @param cancel   Token to abandon the call.
+     * @return         Status code from the app or NOS_ERROR_CANCELLED.
+     */
+    uint32_t CallAppCancellable(uint32_t appId, uint16_t arg,
+                                const std::vector<uint8_t>& request,
+                                std::vector<uint8_t>* response,
+                                const CancellationToken& cancel) override;
+
+    /**
+     * Call into an app running on Nugget with the request and reply in the
+     * caller's buffers.
+     *
+     * The buffers are passed straight to the transport without copying.
+     *
+     * @param app_id       The ID of the app to call.
+     * @param arg          Argument to pass to the app.
+     * @param request      Data to send to the app, or nullptr if none.
+     * @param requestSize  Size of the request.
+     * @param response     Buffer to receive data from the app, or nullptr.
+     * @param responseSize Size of the buffer, set to the size of the reply.
+     * @return             Status code from the app.
+     */
+    uint32_t CallAppRaw(uint32_t appId, uint16_t arg, const uint8_t* request,
+                        uint32_t requestSize, uint8_t* response,
+                        uint32_t* responseSize) override;
+
+    /**
+     * Call into an app running on Nugget, receiving the reply in chunks.
+     *
+     * The reply is read from the device straight into the chunks.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param request  Data to send to the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     * @return         Status code from the app.
+     */
+    uint32_t CallAppChunked(uint32_t appId, uint16_t arg,
+                            const std::vector<uint8_t>& request,
+                            ReplyChunks* response,
+                            const CancellationToken* cancel) override;
+
+    /**
+     * Call into an app running on Nugget, producing the request as it is sent
+     * and receiving the reply in chunks.
+     *
+     * Each datagram of the request is sent as soon as it is produced.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param request  Request to produce for the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     * @return         Status code from the app.
+     */
+    uint32_t CallAppStreamed(uint32_t appId, uint16_t arg,
+                             const StreamedRequest& request,
+                             ReplyChunks* response,
+                             const CancellationToken* cancel) override;
+
+    /**
+     * Call a service method, producing the request as it is sent and
+     * receiving the reply in chunks.
+     *
+     * The call returns APP_ERROR_TIMEOUT if the app takes longer than the
+     * method's timeout, leaving the app to finish.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param request  Request to produce for the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     * @param method   The method being called.
+     * @return         Status code from the app or APP_ERROR_TIMEOUT.
+     */
+    uint32_t CallAppStreamed(uint32_t appId, uint16_t arg,
+                             const StreamedRequest& request,
+                             ReplyChunks* response,
+                             const CancellationToken* cancel,
+                             const MethodInfo& method) override;
+
+    /**
+     * Call a service method with each of several requests, back to back.
+     *
+     * The calls are made with nos_call_application_pipelined() so the app's
+     * readiness is only checked before the first call, and small requests are
+     * queued on apps that can work through them while replies are read. The
+     * replies may come out of order if a request has to be sent again.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param requests Requests to produce for the app.
+     * @param response Chunks to receive each reply, or nullptr.
+     * @param cancel   Token to abandon the batch, or nullptr.
+     * @param method   The method being called.
+     * @param reply    Called after each call with its index and status code.
+     * @return         APP_SUCCESS or the status that stopped the batch.
+     */
+    uint32_t CallAppBatch(uint32_t appId, uint16_t arg,
+                          const std::vector<const StreamedRequest*>& requests,
+                          ReplyChunks* response,
+                          const CancellationToken* cancel,
+                          const MethodInfo& method,
+                          const BatchReply& reply) override;
+
     /**
      * Reset the device. Use with caution; context may be lost.
+     *
+     * Calls already in progress are finished first. Calls made by other
+     * threads meanwhile are held back until the device has rebooted and the
+     * warm-ups have run, so they neither race the warm-ups nor wait for the
+     * device to wake.
+     *
+     * @return 0 on success, APP_ERROR_NOT_READY if the client isn't open,
+     *         APP_ERROR_BUSY if called by a warm-up or the negative error
+     *         code from the device if it failed to reset or wake up.
      */
     uint32_t Reset() const override;
 
+    /**
+     * Called after a reset once the device is ready again.
+     */
+    using WarmUp = std::function<void()>;
+
+    /**
+     * Add something to do after each reset before the next call, such as
+     * refilling a cache of the device's state.
+     *
+     * Warm-ups run in the order they were added on the thread that reset the
+     * device, which is the only thread whose calls aren't held back until
+     * they are done. They must make synchronous calls, through this client or
+     * an AsyncNuggetClient wrapping it, and must not reset the device.
+     */
+    void AddWarmUp(WarmUp warmUp);
+
+    /**
+     * Choose how calls wait for the app to finish.
+     *
+     * By default the status is polled until the app is done. Commands that
+     * can take a long time are better served by spinning briefly then
+     * blocking on the device's interrupt, but only if the device interrupts
+     * when a command finishes. Citadel's interrupt only reports events, see
+     * NOS_COMPLETION_SPIN_THEN_BLOCK.
+     *
+     * The thread making the calls can also be pinned to a CPU and given a
+     * higher priority with nos::SetIoThreadScheduling().
+     *
+     * @param policy How to wait for the app.
+     * @param spinUs Microseconds to poll before blocking, if the policy blocks.
+     */
+    void SetCompletionPolicy(nos_completion_policy policy, uint32_t spinUs);
+
+    /**
+     * Access the record of the last few calls to the device.
+     *
+     * The record is logged when a call fails at the transport level. Set the
+     * slow call threshold or the dump callback to change when and how, before
+     * making calls. Use nos_flight_recorder_copy() to read it while other
+     * threads are making calls.
+     */
+    nos_flight_recorder* FlightRecorder();
+    const nos_flight_recorder* FlightRecorder() const;
+
+    /**
+     * Whether the device said it has event reports queued when last called.
+     *
+     * Every status read carries the flag, so an event service need only
+     * fetch NUGGET_PARAM_GET_EVENT_REPORT while this is true instead of
+     * polling. Each fetch updates it, so fetching until it is false drains
+     * the queue. Firmware that doesn't set the flag still interrupts when
+     * events are queued.
+     */
+    bool EventsPending() const override;
+
     /**
      * Access the underlying device.
      *
@@ -93,9 +281,91 @@ public:
     const std::string& DeviceName() const;
 
 protected:
+    /**
+     * The events pending flag of one call, which calls made by other threads
+     * can't overwrite while the transport is updating it. It is passed on to
+     * EventsPending() when the call is done.
+     */
+    class CallEventsPending {
+    public:
+        explicit CallEventsPending(std::atomic<int>& pending)
+            : pending_(pending), flag_(-1) {}
+        ~CallEventsPending() {
+            if (flag_ >= 0) {
+                pending_.store(flag_, std::memory_order_relaxed);
+            }
+        }
+
+        CallEventsPending(const CallEventsPending&) = delete;
+        CallEventsPending& operator=(const CallEventsPending&) = delete;
+
+        /** Where the transport puts the flag, left alone if not read */
+        int* get() { return &flag_; }
+
+    private:
+        std::atomic<int>& pending_;
+        int flag_;
+    };
+
+    /**
+     * Held for each call to the device so Reset() can wait for the calls in
+     * progress and hold back new ones.
+     */
+    class CallScope {
+    public:
+        explicit CallScope(NuggetClient& client) : client_(client) {
+            client_.EnterCall();
+        }
+        ~CallScope() { client_.LeaveCall(); }
+
+        CallScope(const CallScope&) = delete;
+        CallScope& operator=(const CallScope&) = delete;
+
+    private:
+        NuggetClient& client_;
+    };
+
+    /**
+     * Call into an app with transport options, which may be NULL.
+     */
+    uint32_t CallAppWithOptions(uint32_t appId, uint16_t arg,
+                                const std::vector<uint8_t>& request,
+                                std::vector<uint8_t>* response,
+                                const nos_call_options* options);
+
+    /**
+     * Call into an app with the request from either a buffer or a source, and
+     * the reply received in chunks. A timeout of 0 uses the default.
+     */
+    uint32_t CallAppChunkedWithSource(uint32_t appId, uint16_t arg,
+                                      const uint8_t* request,
+                                      size_t requestSize,
+                                      const nos_request_source* source,
+                                      ReplyChunks* response,
+                                      const CancellationToken* cancel,
+                                      uint32_t timeoutMs);
+
     std::string device_name_;
     nos_device device_;
     bool open_;
+    nos_completion_policy completion_;
+    uint32_t spin_us_;
+    nos_flight_recorder recorder_;
+    std::vector<WarmUp> warm_ups_;
+    std::atomic<int> events_pending_;
+
+private:
+    void EnterCall();
+    void LeaveCall();
+
+    /* Barrier between calls and Reset(), which is const */
+    mutable std::mutex reset_mutex_;
+    mutable std::condition_variable reset_cv_;
+    /* Calls to the device in progress */
+    size_t calls_;
+    /* Whether a reset is holding back calls, other than those of its thread */
+    mutable bool resetting_;
+    mutable std::thread::id reset_thread_;
 };
 
 } // namespace nos
@@ -44,6 +44,31 @@ public:
                    const std::vector<uint8_t>& request,
                    std::vector<uint8_t>* response) override;
 
+  uint32_t CallAppCancellable(uint32_t appId, uint16_t arg,
+                              const std::vector<uint8_t>& request,
+                              std::vector<uint8_t>* response,
+                              const CancellationToken& cancel) override;
+
+  /* The callbacks need the request and reply in one piece */
+  uint32_t CallAppRaw(uint32_t appId, uint16_t arg, const uint8_t* request,
+                      uint32_t requestSize, uint8_t* response,
+                      uint32_t* responseSize) override;
+
+  uint32_t CallAppChunked(uint32_t appId, uint16_t arg,
+                          const std::vector<uint8_t>& request,
+                          ReplyChunks* response,
+                          const CancellationToken* cancel) override;
+
+  uint32_t CallAppStreamed(uint32_t appId, uint16_t arg,
+                           const StreamedRequest& request,
+                           ReplyChunks* response,
+                           const CancellationToken* cancel) override;
+
+  uint32_t CallAppStreamed(uint32_t appId, uint16_t arg,
+                           const StreamedRequest& request,
+                           ReplyChunks* response,
+                           const CancellationToken* cancel,
+                           const MethodInfo& method) override;
 
 private:
   request_cb_t request_cb_;
@@ -17,9 +17,19 @@
 #ifndef NOS_NUGGET_CLIENT_INTERFACE_H
 #define NOS_NUGGET_CLIENT_INTERFACE_H
 
+#include <algorithm>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <vector>
 
+#include <application.h>
+#include <nos/CancellationToken.h>
+#include <nos/MethodInfo.h>
+#include <nos/ReplyChunks.h>
+#include <nos/StreamedRequest.h>
+#include <nos/status.h>
+
 namespace nos {
 
 /**
@@ -27,6 +37,18 @@ namespace nos {
  */
 class NuggetClientInterface {
 public:
+    /**
+     * Receives the status code of an asynchronous call once it has finished.
+     */
+    using AsyncDone = std::function<void(uint32_t status)>;
+
+    /**
+     * Receives each reply of a batch before the next call reuses the buffer.
+     * Returns the status to carry on with, anything but APP_SUCCESS stopping
+     * the batch.
+     */
+    using BatchReply = std::function<uint32_t(size_t index, uint32_t status)>;
+
     virtual ~NuggetClientInterface() = default;
 
     /**
@@ -58,10 +80,222 @@ public:
     virtual uint32_t CallApp(uint32_t appId, uint16_t arg,
                              const std::vector<uint8_t>& request,
                              std::vector<uint8_t>* response) = 0;
+
+    /**
+     * Call into an app running on Nugget that can be abandoned.
+     *
+     * Implementations that can't abandon a call in progress will only check
+     * the token before starting.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param request  Data to send to the app.
+     * @param response Buffer to receive data from the app.
+     * @param cancel   Token to abandon the call.
+     * @return         Status code from the app or NOS_ERROR_CANCELLED.
+     */
+    virtual uint32_t CallAppCancellable(uint32_t appId, uint16_t arg,
+                                        const std::vector<uint8_t>& request,
+                                        std::vector<uint8_t>* response,
+                                        const CancellationToken& cancel) {
+        if (cancel.IsCancelled()) {
+            return NOS_ERROR_CANCELLED;
+        }
+        return CallApp(appId, arg, request, response);
+    }
+
+    /**
+     * Call into an app running on Nugget with the request and reply in the
+     * caller's buffers, such as structs on its stack.
+     *
+     * Implementations that can't call with the caller's buffers copy them
+     * through vectors.
+     *
+     * @param app_id       The ID of the app to call.
+     * @param arg          Argument to pass to the app.
+     * @param request      Data to send to the app, or nullptr if none.
+     * @param requestSize  Size of the request.
+     * @param response     Buffer to receive data from the app, or nullptr.
+     * @param responseSize Size of the buffer, set to the size of the reply.
+     * @return             Status code from the app.
+     */
+    virtual uint32_t CallAppRaw(uint32_t appId, uint16_t arg,
+                                const uint8_t* request, uint32_t requestSize,
+                                uint8_t* response, uint32_t* responseSize) {
+        std::vector<uint8_t> flatRequest;
+        if (request != nullptr) {
+            flatRequest.assign(request, request + requestSize);
+        }
+        std::vector<uint8_t> buffer;
+        if (response != nullptr) {
+            buffer.reserve(*responseSize);
+        }
+        const uint32_t status = CallApp(appId, arg, flatRequest,
+                                        (response != nullptr) ? &buffer : nullptr);
+        if (response != nullptr) {
+            if (buffer.size() > *responseSize) {
+                return APP_ERROR_TOO_MUCH;
+            }
+            std::copy(buffer.begin(), buffer.end(), response);
+            *responseSize = buffer.size();
+        }
+        return status;
+    }
+
+    /**
+     * Call into an app running on Nugget, receiving the reply in chunks.
+     *
+     * Implementations that can't receive the reply in chunks receive it into a
+     * flat buffer and copy it into a single chunk.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param request  Data to send to the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     * @return         Status code from the app.
+     */
+    virtual uint32_t CallAppChunked(uint32_t appId, uint16_t arg,
+                                    const std::vector<uint8_t>& request,
+                                    ReplyChunks* response,
+                                    const CancellationToken* cancel) {
+        std::vector<uint8_t> buffer;
+        if (response != nullptr) {
+            buffer.reserve(response->Capacity());
+        }
+        std::vector<uint8_t>* const flat = (response != nullptr) ? &buffer : nullptr;
+        const uint32_t status = (cancel != nullptr)
+                ? CallAppCancellable(appId, arg, request, flat, *cancel)
+                : CallApp(appId, arg, request, flat);
+        if (response != nullptr && !response->Assign(buffer)) {
+            return APP_ERROR_TOO_MUCH;
+        }
+        return status;
+    }
+
+    /**
+     * Call into an app running on Nugget, producing the request as it is sent
+     * and receiving the reply in chunks.
+     *
+     * Implementations that can't send the request as it is produced flatten
+     * it first.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param request  Request to produce for the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     * @return         Status code from the app.
+     */
+    virtual uint32_t CallAppStreamed(uint32_t appId, uint16_t arg,
+                                     const StreamedRequest& request,
+                                     ReplyChunks* response,
+                                     const CancellationToken* cancel) {
+        std::vector<uint8_t> buffer;
+        if (!request.Flatten(&buffer)) {
+            return APP_ERROR_RPC;
+        }
+        return CallAppChunked(appId, arg, buffer, response, cancel);
+    }
+
+    /**
+     * Call a service method, producing the request as it is sent and
+     * receiving the reply in chunks.
+     *
+     * Implementations that don't use what is known about the method, such as
+     * its timeout or priority, make the call without it.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param request  Request to produce for the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     * @param method   The method being called.
+     * @return         Status code from the app.
+     */
+    virtual uint32_t CallAppStreamed(uint32_t appId, uint16_t arg,
+                                     const StreamedRequest& request,
+                                     ReplyChunks* response,
+                                     const CancellationToken* cancel,
+                                     const MethodInfo& method) {
+        (void)method;
+        return CallAppStreamed(appId, arg, request, response, cancel);
+    }
+
+    /**
+     * Call a service method without waiting for it to finish.
+     *
+     * The response must stay valid until done is called, which may be on
+     * another thread. Implementations that can't make calls asynchronously
+     * make the call and then call done before returning.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param request  Request to produce for the app.
+     * @param response Chunks to receive data from the app, or nullptr.
+     * @param cancel   Token to abandon the call, or nullptr.
+     * @param method   The method being called.
+     * @param done     Called with the status code from the app.
+     */
+    virtual void CallAppAsync(uint32_t appId, uint16_t arg,
+                              std::unique_ptr<const StreamedRequest> request,
+                              ReplyChunks* response,
+                              const CancellationToken* cancel,
+                              const MethodInfo& method, AsyncDone done) {
+        done(CallAppStreamed(appId, arg, *request, response, cancel, method));
+    }
+
+    /**
+     * Call a service method with each of several requests, back to back.
+     *
+     * The calls are made in order with the same response buffer, which is
+     * handed to the reply callback after each one. Implementations that can't
+     * send the calls together make them one at a time.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param requests Requests to produce for the app.
+     * @param response Chunks to receive each reply, or nullptr.
+     * @param cancel   Token to abandon the batch, or nullptr.
+     * @param method   The method being called.
+     * @param reply    Called after each call with its index and status code.
+     * @return         APP_SUCCESS or the status that stopped the batch.
+     */
+    virtual uint32_t CallAppBatch(uint32_t appId, uint16_t arg,
+                                  const std::vector<const StreamedRequest*>& requests,
+                                  ReplyChunks* response,
+                                  const CancellationToken* cancel,
+                                  const MethodInfo& method,
+                                  const BatchReply& reply) {
+        for (size_t i = 0; i < requests.size(); ++i) {
+            if (cancel != nullptr && cancel->IsCancelled()) {
+                return NOS_ERROR_CANCELLED;
+            }
+            const uint32_t status = reply(i, CallAppStreamed(
+                    appId, arg, *requests[i], response, cancel, method));
+            if (status != APP_SUCCESS) {
+                return status;
+            }
+        }
+        return APP_SUCCESS;
+    }
+
     /**
      * Reset the device. Use with caution; context may be lost.
+     *
+     * @return 0 on success or an error code, which implementations document.
      */
     virtual uint32_t Reset() const = 0;
+
+    /**
+     * Whether the device said it has event reports queued when last called.
+     *
+     * Implementations that don't see the transport status return false, so
+     * callers must still poll for whatever they fetch.
+     */
+    virtual bool EventsPending() const {
+        return false;
+    }
 };
 
 } // namespace nos
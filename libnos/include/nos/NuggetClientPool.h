@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_NUGGET_CLIENT_POOL_H
+#define NOS_NUGGET_CLIENT_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nos/NuggetClient.h>
+
+namespace nos {
+
+/**
+ * Clients for many Nugget devices on the same host, such as on a test rack.
+ *
+ * Each device has its own client and device context so calls to different
+ * devices proceed in parallel. Work is routed to a device by taking a lease on
+ * it, either on a specific device or on any that is idle. A device is only
+ * leased to one thread at a time.
+ *
+ * The pool is thread safe. It must outlive its leases.
+ */
+class NuggetClientPool {
+public:
+    /**
+     * Exclusive use of one device in the pool until destroyed or released.
+     */
+    class Lease {
+    public:
+        Lease() : pool_(nullptr), index_(0) {}
+        Lease(Lease&& other);
+        Lease& operator=(Lease&& other);
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        /**
+         * Checks whether a device is leased.
+         */
+        explicit operator bool() const { return pool_ != nullptr; }
+
+        /**
+         * The client for the leased device.
+         */
+        NuggetClient& Client() const;
+        NuggetClient* operator->() const { return &Client(); }
+
+        /**
+         * Index of the leased device in the pool.
+         */
+        size_t Index() const { return index_; }
+
+        /**
+         * Return the device to the pool early.
+         */
+        void Release();
+
+    private:
+        friend class NuggetClientPool;
+        Lease(NuggetClientPool* pool, size_t index)
+                : pool_(pool), index_(index) {}
+
+        NuggetClientPool* pool_;
+        size_t index_;
+    };
+
+    /**
+     * How much use a device has had since the statistics were reset.
+     */
+    struct DeviceStats {
+        std::string name;
+        bool open;
+        /* Number of leases taken */
+        uint64_t leases;
+        /* Time spent leased */
+        std::chrono::nanoseconds busy;
+        /* Fraction of the time spent leased */
+        double utilization;
+    };
+
+    /**
+     * Finds the devices on a host, calling found() with the name of each and
+     * returning the number found or negative on failure. The libnos_datagram
+     * variant for the host may provide one, such as Citadel's
+     * nos_device_enumerate().
+     */
+    using Enumerator = int (*)(void (*found)(void* arg, const char* name),
+                               void* arg);
+
+    /**
+     * Find the names of all the devices on this host, in order.
+     */
+    static std::vector<std::string> FindDevices(Enumerator enumerate);
+
+    /**
+     * Create a pool of all the devices on this host.
+     */
+    explicit NuggetClientPool(Enumerator enumerate);
+
+    /**
+     * Create a pool of the named devices.
+     */
+    explicit NuggetClientPool(const std::vector<std::string>& names);
+
+    ~NuggetClientPool();
+
+    NuggetClientPool(const NuggetClientPool&) = delete;
+    NuggetClientPool& operator=(const NuggetClientPool&) = delete;
+
+    /**
+     * Open a connection to each device.
+     *
+     * Devices that fail to open are left out when leasing any idle device.
+     *
+     * @return The number of devices that are open.
+     */
+    size_t Open();
+
+    /**
+     * Close the connections to the devices. There must be no leases.
+     */
+    void Close();
+
+    /**
+     * Number of devices in the pool, whether open or not.
+     */
+    size_t Size() const;
+
+    /**
+     * Lease a specific device, waiting until it is idle.
+     *
+     * @param index Index of the device in the pool.
+     * @return      The lease, or an empty one if there is no such device.
+     */
+    Lease Acquire(size_t index);
+
+    /**
+     * Lease any open device, waiting until one is idle.
+     *
+     * Idle devices are taken in turn so the work is spread across them.
+     *
+     * @return The lease, or an empty one if no device is open.
+     */
+    Lease Acquire();
+
+    /**
+     * Lease any open device that is idle, without waiting.
+     *
+     * @return The lease, or an empty one if none is idle.
+     */
+    Lease TryAcquire();
+
+    /**
+     * Statistics of each device in the pool, in order.
+     */
+    std::vector<DeviceStats> Stats() const;
+
+    /**
+     * Start measuring the statistics afresh.
+     */
+    void ResetStats();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Device {
+        std::unique_ptr<NuggetClient> client;
+        bool leased = false;
+        uint64_t leases = 0;
+        Clock::duration busy{};
+        Clock::time_point leased_at;
+    };
+
+    /* Take an idle open device, returning Size() if there are none */
+    size_t TakeIdleLocked();
+    void LeaseLocked(size_t index);
+    void Release(size_t index);
+
+    mutable std::mutex mutex_;
+    std::condition_variable idle_cv_;
+    std::vector<Device> devices_;
+    size_t next_;
+    Clock::time_point stats_start_;
+};
+
+} // namespace nos
+
+#endif // NOS_NUGGET_CLIENT_POOL_H
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NOS_NUGGET_PARAMS_H
+#define NOS_NUGGET_PARAMS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <app_nugget.h>
+#include <application.h>
+#include <citadel_events.h>
+
+namespace nos {
+
+/**
+ * Stands in for the request or reply of a command that has none.
+ */
+struct NoData {};
+
+/**
+ * The structs a Nugget app command exchanges, as documented with it in
+ * app_nugget.h, for AppClient::Call<Param>().
+ *
+ * Each command has the app it is for, its request and reply types and the
+ * least of the reply firmware may send, the rest of the reply being zeroed.
+ * Commands without an entry can't be called this way. The sizes of the structs
+ * are checked below as they are part of the firmware's interface.
+ */
+template <uint16_t Param>
+struct NuggetParam;
+
+template <>
+struct NuggetParam<NUGGET_PARAM_FLASH_BLOCK> {
+    static constexpr uint32_t kAppId = APP_ID_NUGGET;
+    using Request = nugget_app_flash_block;
+    using Reply = NoData;
+    static constexpr bool kRequestOptional = false;
+    static constexpr size_t kMinReplySize = 0;
+};
+
+template <>
+struct NuggetParam<NUGGET_PARAM_REBOOT> {
+    static constexpr uint32_t kAppId = APP_ID_NUGGET;
+    using Request = NoData;
+    using Reply = NoData;
+    static constexpr bool kRequestOptional = false;
+    static constexpr size_t kMinReplySize = 0;
+};
+
+/* Gets the ID without a request or sets it with one */
+template <>
+struct NuggetParam<NUGGET_PARAM_BOARD_ID> {
+    static constexpr uint32_t kAppId = APP_ID_NUGGET;
+    using Request = nugget_app_board_id;
+    using Reply = nugget_app_board_id;
+    static constexpr bool kRequestOptional = true;
+    static constexpr size_t kMinReplySize = sizeof(nugget_app_board_id);
+};
+
+/* An empty reply, which reads as EVENT_NONE, means none were pending */
+template <>
+struct NuggetParam<NUGGET_PARAM_GET_EVENT_REPORT> {
+    static constexpr uint32_t kAppId = APP_ID_NUGGET;
+    using Request = NoData;
+    using Reply = event_report;
+    static constexpr bool kRequestOptional = false;
+    static constexpr size_t kMinReplySize = 0;
+};
+
+template <>
+struct NuggetParam<NUGGET_PARAM_CYCLES_SINCE_BOOT> {
+    static constexpr uint32_t kAppId = APP_ID_NUGGET;
+    using Request = NoData;
+    using Reply = uint32_t;
+    static constexpr bool kRequestOptional = false;
+    static constexpr size_t kMinReplySize = sizeof(uint32_t);
+};
+
+/* Firmware before version 1 of the stats stops short of v1_magic */
+template <>
+struct NuggetParam<NUGGET_PARAM_GET_LOW_POWER_STATS> {
+    static constexpr uint32_t kAppId = APP_ID_NUGGET;
+    using Request = NoData;
+    using Reply = nugget_app_low_power_stats;
+    static constexpr bool kRequestOptional = false;
+    static constexpr size_t kMinReplySize =
+        offsetof(nugget_app_low_power_stats, v1_magic);
+};
+
+template <>
+struct NuggetParam<NUGGET_PARAM_READ32> {
+    static constexpr uint32_t kAppId = APP_ID_NUGGET;
+    using Request = uint32_t;
+    using Reply = uint32_t;
+    static constexpr bool kRequestOptional = false;
+    static constexpr size_t kMinReplySize = sizeof(uint32_t);
+};
+
+template <>
+struct NuggetParam<NUGGET_PARAM_WRITE32> {
+    static constexpr uint32_t kAppId = APP_ID_NUGGET;
+    using Request = nugget_app_write32;
+    using Reply = NoData;
+    static constexpr bool kRequestOptional = false;
+    static constexpr size_t kMinReplySize = 0;
+};
+
+static_assert(sizeof(nugget_app_flash_block) == 8 + NP_FLASH_BLOCK_SIZE,
+              "nugget_app_flash_block is part of the firmware interface");
+static_assert(sizeof(nugget_app_board_id) == 12,
+              "nugget_app_board_id is part of the firmware interface");
+static_assert(sizeof(event_report) == EVENT_REPORT_SIZE,
+              "event_report is part of the firmware interface");
+static_assert(sizeof(nugget_app_low_power_stats) == 92,
+              "nugget_app_low_power_stats is part of the firmware interface");
+static_assert(sizeof(nugget_app_write32) == 8,
+              "nugget_app_write32 is part of the firmware interface");
+
+} // namespace nos
+
+#endif // NOS_NUGGET_PARAMS_H
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_REPLY_CHUNKS_H
+#define NOS_REPLY_CHUNKS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nos {
+
+/**
+ * A reply from an app held as the datagram sized chunks it arrived in.
+ *
+ * Only as much storage as the reply needs is allocated, rather than a buffer
+ * for the largest possible reply, and the reply is not copied to reassemble
+ * it. Storage is kept when cleared so a ReplyChunks can be reused.
+ */
+class ReplyChunks {
+public:
+    /**
+     * @param capacity Most bytes of reply that will be accepted.
+     */
+    explicit ReplyChunks(size_t capacity)
+            : capacity_(capacity), size_(0), count_(0) {}
+
+    size_t Capacity() const { return capacity_; }
+
+    /**
+     * Total bytes in all of the chunks.
+     */
+    size_t Size() const { return size_; }
+
+    size_t ChunkCount() const { return count_; }
+    const uint8_t* ChunkData(size_t i) const { return chunks_[i].data(); }
+    size_t ChunkSize(size_t i) const { return chunks_[i].size(); }
+
+    /**
+     * Add a chunk to the end of the reply.
+     *
+     * @param len Size of the chunk.
+     * @return    Storage for the chunk or nullptr if it would exceed the
+     *            capacity.
+     */
+    uint8_t* Append(size_t len) {
+        if (len > capacity_ - size_) {
+            return nullptr;
+        }
+        /* Reuse the storage of a cleared chunk if there is one */
+        if (count_ == chunks_.size()) {
+            chunks_.emplace_back();
+        }
+        std::vector<uint8_t>& chunk = chunks_[count_++];
+        chunk.resize(len);
+        size_ += len;
+        return chunk.data();
+    }
+
+    /**
+     * Remove all the chunks.
+     */
+    void Clear() {
+        size_ = 0;
+        count_ = 0;
+    }
+
+    /**
+     * Replace the chunks with a copy of a flat reply.
+     *
+     * @return Whether the reply fits in the capacity.
+     */
+    bool Assign(const std::vector<uint8_t>& reply) {
+        Clear();
+        if (reply.empty()) {
+            return true;
+        }
+        uint8_t* chunk = Append(reply.size());
+        if (chunk == nullptr) {
+            return false;
+        }
+        std::copy(reply.begin(), reply.end(), chunk);
+        return true;
+    }
+
+private:
+    size_t capacity_;
+    size_t size_;
+    size_t count_;
+    std::vector<std::vector<uint8_t>> chunks_;
+};
+
+} // namespace nos
+
+#endif // NOS_REPLY_CHUNKS_H
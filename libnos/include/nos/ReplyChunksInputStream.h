@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_REPLY_CHUNKS_INPUT_STREAM_H
+#define NOS_REPLY_CHUNKS_INPUT_STREAM_H
+
+#include <cstdint>
+
+#include <google/protobuf/io/zero_copy_stream.h>
+
+#include <nos/ReplyChunks.h>
+
+namespace nos {
+
+/**
+ * Reads a chunked reply so it can be parsed without being reassembled.
+ *
+ * This is header only so libnos need not depend on protobuf; it is used by
+ * the generated service clients, which do.
+ */
+class ReplyChunksInputStream : public google::protobuf::io::ZeroCopyInputStream {
+public:
+    explicit ReplyChunksInputStream(const ReplyChunks& chunks)
+            : chunks_(chunks), chunk_(0), offset_(0), position_(0) {}
+
+    bool Next(const void** data, int* size) override {
+        while (chunk_ < chunks_.ChunkCount()
+               && offset_ == chunks_.ChunkSize(chunk_)) {
+            ++chunk_;
+            offset_ = 0;
+        }
+        if (chunk_ == chunks_.ChunkCount()) {
+            return false;
+        }
+        *data = chunks_.ChunkData(chunk_) + offset_;
+        *size = chunks_.ChunkSize(chunk_) - offset_;
+        offset_ = chunks_.ChunkSize(chunk_);
+        position_ += *size;
+        return true;
+    }
+
+    void BackUp(int count) override {
+        /* Only the end of the last buffer from Next() can be backed up */
+        offset_ -= count;
+        position_ -= count;
+    }
+
+    bool Skip(int count) override {
+        const void* data;
+        int size;
+        while (count > 0 && Next(&data, &size)) {
+            if (size > count) {
+                BackUp(size - count);
+                size = count;
+            }
+            count -= size;
+        }
+        return count == 0;
+    }
+
+    int64_t ByteCount() const override {
+        return position_;
+    }
+
+private:
+    const ReplyChunks& chunks_;
+    size_t chunk_;
+    size_t offset_;
+    int64_t position_;
+};
+
+} // namespace nos
+
+#endif // NOS_REPLY_CHUNKS_INPUT_STREAM_H
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_RESPONSE_HANDLE_H
+#define NOS_RESPONSE_HANDLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/message_lite.h>
+
+#include <nos/ReplyChunks.h>
+#include <nos/ReplyChunksInputStream.h>
+
+namespace nos {
+
+/**
+ * Read only view of bytes held elsewhere.
+ */
+class ByteView {
+public:
+    ByteView() : data_(nullptr), size_(0) {}
+    ByteView(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const uint8_t* begin() const { return data_; }
+    const uint8_t* end() const { return data_ + size_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+};
+
+/**
+ * Deepest a viewed field can be nested in the response.
+ */
+constexpr size_t kMaxViewDepth = 4;
+
+/**
+ * Field numbers leading from the response message to a bytes field.
+ */
+struct ViewPath {
+    size_t depth;
+    uint32_t fields[kMaxViewDepth];
+};
+
+/**
+ * The retained reply of an app and the views of its bytes fields.
+ *
+ * This is the part of ResponseHandle that doesn't depend on the message type.
+ */
+class ResponseViews {
+public:
+    ResponseViews(const ResponseViews&) = delete;
+    ResponseViews& operator=(const ResponseViews&) = delete;
+
+    /**
+     * Discard the previous response.
+     *
+     * @return The chunks to receive the new response into.
+     */
+    ReplyChunks* Receive() {
+        chunks_.Clear();
+        joined_.clear();
+        std::fill(views_.begin(), views_.end(), ByteView());
+        return &chunks_;
+    }
+
+protected:
+    /**
+     * @param capacity Most bytes of response that will be accepted.
+     * @param paths    Fields to view rather than copy.
+     * @param count    Number of paths.
+     */
+    ResponseViews(size_t capacity, const ViewPath* paths, size_t count)
+            : chunks_(capacity), paths_(paths), views_(count) {}
+
+    ByteView View(size_t i) const { return views_[i]; }
+
+    /**
+     * Take views of the fields from the received chunks.
+     *
+     * @param rest The response with the viewed fields removed.
+     * @return     Whether the response was well formed.
+     */
+    bool Split(std::string* rest) {
+        ReplyChunksInputStream stream(chunks_);
+        google::protobuf::io::CodedInputStream in(&stream);
+        google::protobuf::io::StringOutputStream restStream(rest);
+        google::protobuf::io::CodedOutputStream out(&restStream);
+        uint32_t prefix[kMaxViewDepth];
+        return Split(&in, &out, prefix, 0) && !out.HadError();
+    }
+
+private:
+    /* Wire types of the encoding, groups being deprecated and not used */
+    static constexpr uint32_t kWireTypeVarint = 0;
+    static constexpr uint32_t kWireTypeFixed64 = 1;
+    static constexpr uint32_t kWireTypeLengthDelimited = 2;
+    static constexpr uint32_t kWireTypeFixed32 = 5;
+
+    bool Split(google::protobuf::io::CodedInputStream* in,
+               google::protobuf::io::CodedOutputStream* out,
+               uint32_t* prefix, size_t depth) {
+        for (;;) {
+            const uint32_t tag = in->ReadTag();
+            if (tag == 0) {
+                return in->ConsumedEntireMessage();
+            }
+
+            /* Find a viewed field, or one it is nested in, with this number */
+            const uint32_t number = tag >> 3;
+            size_t match = views_.size();
+            if ((tag & 7) == kWireTypeLengthDelimited) {
+                for (size_t i = 0; i < views_.size(); ++i) {
+                    const ViewPath& path = paths_[i];
+                    if (path.depth > depth && path.fields[depth] == number
+                            && std::equal(prefix, prefix + depth, path.fields)) {
+                        match = i;
+                        break;
+                    }
+                }
+            }
+            if (match == views_.size()) {
+                if (!CopyField(in, tag, out)) {
+                    return false;
+                }
+                continue;
+            }
+
+            uint32_t len;
+            if (!in->ReadVarint32(&len)) {
+                return false;
+            }
+            if (paths_[match].depth == depth + 1) {
+                if (!ReadView(in, len, &views_[match])) {
+                    return false;
+                }
+                continue;
+            }
+
+            /* Copy the enclosing message without the viewed fields */
+            std::string nested;
+            {
+                google::protobuf::io::StringOutputStream nestedStream(&nested);
+                google::protobuf::io::CodedOutputStream nestedOut(&nestedStream);
+                prefix[depth] = number;
+                const auto limit = in->PushLimit(len);
+                const bool ok = Split(in, &nestedOut, prefix, depth + 1);
+                in->PopLimit(limit);
+                if (!ok || nestedOut.HadError()) {
+                    return false;
+                }
+            }
+            out->WriteTag(tag);
+            out->WriteVarint32(nested.size());
+            out->WriteString(nested);
+        }
+    }
+
+    /* Copy a field that isn't viewed as it is */
+    static bool CopyField(google::protobuf::io::CodedInputStream* in, uint32_t tag,
+                          google::protobuf::io::CodedOutputStream* out) {
+        out->WriteTag(tag);
+        switch (tag & 7) {
+        case kWireTypeVarint: {
+            uint64_t value;
+            if (!in->ReadVarint64(&value)) {
+                return false;
+            }
+            out->WriteVarint64(value);
+            return true;
+        }
+        case kWireTypeFixed64: {
+            uint64_t value;
+            if (!in->ReadLittleEndian64(&value)) {
+                return false;
+            }
+            out->WriteLittleEndian64(value);
+            return true;
+        }
+        case kWireTypeLengthDelimited: {
+            uint32_t len;
+            std::string value;
+            if (!in->ReadVarint32(&len) || !in->ReadString(&value, len)) {
+                return false;
+            }
+            out->WriteVarint32(len);
+            out->WriteString(value);
+            return true;
+        }
+        case kWireTypeFixed32: {
+            uint32_t value;
+            if (!in->ReadLittleEndian32(&value)) {
+                return false;
+            }
+            out->WriteLittleEndian32(value);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    bool ReadView(google::protobuf::io::CodedInputStream* in, uint32_t len, ByteView* view) {
+        if (len == 0) {
+            *view = ByteView();
+            return true;
+        }
+        /* Point into the chunk if the field lies within it */
+        const void* data;
+        int available;
+        if (in->GetDirectBufferPointer(&data, &available)
+                && static_cast<uint32_t>(available) >= len) {
+            *view = ByteView(static_cast<const uint8_t*>(data), len);
+            return in->Skip(len);
+        }
+        /* Otherwise join the pieces of it from each chunk */
+        if (len > chunks_.Size()) {
+            return false;
+        }
+        joined_.emplace_back(len);
+        if (!in->ReadRaw(joined_.back().data(), len)) {
+            return false;
+        }
+        *view = ByteView(joined_.back().data(), len);
+        return true;
+    }
+
+    ReplyChunks chunks_;
+    const ViewPath* paths_;
+    std::vector<ByteView> views_;
+    std::vector<std::vector<uint8_t>> joined_;
+};
+
+/**
+ * A response whose large bytes fields are viewed in the retained reply rather
+ * than copied into the message.
+ *
+ * The viewed fields are left empty in the message. The views are valid until
+ * the handle is destroyed or receives another response. Fields that arrived
+ * split across datagrams are joined, which is the only copy made of them.
+ *
+ * The generated service clients derive a handle for each method whose
+ * response has bytes fields, adding an accessor for each view. This is header
+ * only so libnos need not depend on protobuf.
+ */
+template <typename Message>
+class ResponseHandle : public ResponseViews {
+public:
+    const Message& Get() const { return message_; }
+    const Message* operator->() const { return &message_; }
+
+    ReplyChunks* Receive() {
+        message_.Clear();
+        return ResponseViews::Receive();
+    }
+
+    /**
+     * Parse the received response.
+     *
+     * @return Whether the response was well formed.
+     */
+    bool Parse() {
+        std::string rest;
+        return Split(&rest) && message_.ParseFromString(rest);
+    }
+
+    /**
+     * Replace the response with a message that has already been parsed.
+     *
+     * This is for implementations of the service that don't talk to the
+     * device, such as mocks.
+     *
+     * @return Whether the message fits and could be serialized.
+     */
+    bool Assign(const Message& message) {
+        ReplyChunks* chunks = Receive();
+        const size_t size = message.ByteSizeLong();
+        if (size != 0) {
+            uint8_t* chunk = chunks->Append(size);
+            if (chunk == nullptr || !message.SerializeToArray(chunk, size)) {
+                return false;
+            }
+        }
+        return Parse();
+    }
+
+protected:
+    ResponseHandle(size_t capacity, const ViewPath* paths, size_t count)
+            : ResponseViews(capacity, paths, count) {}
+
+private:
+    Message message_;
+};
+
+} // namespace nos
+
+#endif // NOS_RESPONSE_HANDLE_H
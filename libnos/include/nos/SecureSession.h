@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_SECURE_SESSION_H
+#define NOS_SECURE_SESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <citadel_events.h>
+#include <nos/NuggetClientInterface.h>
+
+namespace nos {
+
+/**
+ * A secure transport session with Citadel shared by the clients of a device,
+ * so the Noise handshake is only run once for each boot of the chip.
+ *
+ * The handshake costs Citadel its EC operations and the host two calls.
+ * Rather than each component running it whenever it wants the channel, they
+ * share a session and call Establish() before using it. The session is kept
+ * until it is invalidated by Citadel rebooting, by it reporting a different
+ * secure channel state, or by a caller finding the channel broken. The next
+ * Establish() then runs the handshake again.
+ *
+ * The keys are held by the Handshaker so the session only tracks whether the
+ * channel is established. It is thread safe.
+ */
+class SecureSession {
+public:
+    /**
+     * Length of each message of the handshake: an EC public key followed by
+     * the encrypted "MSGA" or "MSGB" and its tag.
+     */
+    static constexpr size_t kHandshakeMessageSize = 64 + 4 + 16;
+
+    /**
+     * The GSA side of the Noise handshake.
+     */
+    class Handshaker {
+    public:
+        virtual ~Handshaker() = default;
+
+        /**
+         * Start a handshake with a new ephemeral key.
+         *
+         * @param message Filled with the first message of the handshake.
+         * @return        Whether the message could be made.
+         */
+        virtual bool Start(std::vector<uint8_t>* message) = 0;
+
+        /**
+         * Finish the handshake with Citadel's reply.
+         *
+         * @param message Citadel's message of the handshake.
+         * @param state   Set to the handshake state to report to Citadel.
+         * @return        Whether the channel is established.
+         */
+        virtual bool Finish(const std::vector<uint8_t>& message,
+                            uint8_t* state) = 0;
+    };
+
+    /**
+     * @param client     Client of the device, which must outlive this.
+     * @param handshaker GSA side of the handshake, which must outlive this.
+     */
+    SecureSession(NuggetClientInterface& client, Handshaker& handshaker);
+
+    SecureSession(const SecureSession&) = delete;
+    SecureSession& operator=(const SecureSession&) = delete;
+
+    /**
+     * Make sure the channel is established, running the handshake if there is
+     * no session. Callers that arrive during a handshake wait for it.
+     *
+     * @return APP_SUCCESS once established, the app's error if a call failed
+     *         or APP_ERROR_RPC if the handshake was refused.
+     */
+    uint32_t Establish();
+
+    /**
+     * Whether there is a session that can be used without a handshake.
+     */
+    bool Established() const;
+
+    /**
+     * Drop the session, such as after a call over the channel failed.
+     */
+    void Invalidate();
+
+    /**
+     * Track Citadel's events, dropping the session if it rebooted or reports a
+     * secure channel state other than the one established.
+     */
+    void OnEvent(const event_report& event);
+
+    /**
+     * Number of handshakes run, whether they succeeded or not.
+     */
+    uint64_t Handshakes() const;
+
+private:
+    uint32_t HandshakeLocked();
+
+    NuggetClientInterface& client_;
+    Handshaker& handshaker_;
+
+    /* Held for the whole handshake so it is only run once */
+    mutable std::mutex mutex_;
+    bool established_;
+    /* State reported to Citadel when the session was established */
+    uint8_t state_;
+    uint64_t handshakes_;
+};
+
+} // namespace nos
+
+#endif // NOS_SECURE_SESSION_H
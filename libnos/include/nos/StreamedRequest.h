@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_STREAMED_REQUEST_H
+#define NOS_STREAMED_REQUEST_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <nos/device.h>
+
+namespace nos {
+
+/**
+ * A request that is produced as it is sent rather than held in one buffer.
+ */
+class StreamedRequest {
+public:
+    /**
+     * Receives the request a datagram at a time.
+     */
+    class Sink {
+    public:
+        /**
+         * @return Whether the data was sent.
+         */
+        virtual bool Write(const uint8_t* data, size_t len) = 0;
+
+    protected:
+        ~Sink() = default;
+    };
+
+    virtual ~StreamedRequest() = default;
+
+    /**
+     * Total size of the request.
+     */
+    virtual size_t Size() const = 0;
+
+    /**
+     * Produce the whole request, writing at most MAX_DEVICE_TRANSFER bytes at
+     * a time. May be called again if the request needs to be resent.
+     *
+     * @return Whether the whole request was written.
+     */
+    virtual bool WriteTo(Sink& sink) const = 0;
+
+    /**
+     * Produce the whole request into a flat buffer.
+     */
+    bool Flatten(std::vector<uint8_t>* buffer) const {
+        struct VectorSink : public Sink {
+            std::vector<uint8_t>* buffer;
+            bool Write(const uint8_t* data, size_t len) override {
+                buffer->insert(buffer->end(), data, data + len);
+                return true;
+            }
+        } sink;
+        sink.buffer = buffer;
+        buffer->clear();
+        buffer->reserve(Size());
+        return WriteTo(sink) && buffer->size() == Size();
+    }
+};
+
+/**
+ * A request that has already been produced into memory.
+ */
+class BufferRequest : public StreamedRequest {
+public:
+    /**
+     * @param data Request, which must stay valid until sent.
+     * @param size Size of the request.
+     */
+    BufferRequest(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    size_t Size() const override {
+        return size_;
+    }
+
+    bool WriteTo(Sink& sink) const override {
+        for (size_t sent = 0; sent < size_; sent += MAX_DEVICE_TRANSFER) {
+            const size_t len = std::min<size_t>(size_ - sent, MAX_DEVICE_TRANSFER);
+            if (!sink.Write(data_ + sent, len)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+};
+
+} // namespace nos
+
+#endif // NOS_STREAMED_REQUEST_H
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_THREAD_SCHEDULING_H
+#define NOS_THREAD_SCHEDULING_H
+
+namespace nos {
+
+/**
+ * Set how the calling thread is scheduled while it makes calls to a device.
+ *
+ * Calls complete sooner if the thread is not migrated or queued behind other
+ * work while waiting on the device. A thread making synchronous calls through
+ * a NuggetClient can call this on itself. AsyncNuggetClient and NuggetBroker
+ * apply it to the threads they make calls on.
+ *
+ * @param cpu  CPU to pin the thread to, or -1 to allow any.
+ * @param nice Nice value for the thread, lower is higher priority.
+ * @return     0 on success or a negative errno if either couldn't be set.
+ */
+int SetIoThreadScheduling(int cpu, int nice);
+
+} // namespace nos
+
+#endif // NOS_THREAD_SCHEDULING_H
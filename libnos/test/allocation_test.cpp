@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the number of heap allocations each call makes on the calling thread
+ * against a budget, so that a new allocation on the hot path fails a test
+ * rather than showing up in production.
+ *
+ * If a change legitimately needs more allocations, raise the budget in the
+ * same change so the cost is visible in review. If it saves some, lower it.
+ *
+ * C++ allocations are counted by replacing operator new. The test is linked
+ * statically with --wrap for malloc, calloc and realloc so allocations made by
+ * the C layer, such as the transport, are counted too.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <app_nugget.h>
+#include <application.h>
+#include <nos/AppClient.h>
+#include <nos/NuggetClient.h>
+#include <nos/transport.h>
+
+#include <Identity.client.h>
+#include <Keymaster.client.h>
+#include <Weaver.client.h>
+
+#include <gtest/gtest.h>
+
+#include "simulator.h"
+
+using nos::test::Simulator;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* p, size_t size);
+}
+
+namespace {
+
+/* Allocations are only counted on the calling thread as the simulator's own
+ * thread stands in for Nugget */
+thread_local bool counting = false;
+thread_local size_t allocations = 0;
+
+void Count() {
+  if (counting) {
+    ++allocations;
+  }
+}
+
+void* Allocate(size_t size) {
+  Count();
+  return __real_malloc(size == 0 ? 1 : size);
+}
+
+}  // namespace
+
+extern "C" void* __wrap_malloc(size_t size) {
+  Count();
+  return __real_malloc(size);
+}
+extern "C" void* __wrap_calloc(size_t count, size_t size) {
+  Count();
+  return __real_calloc(count, size);
+}
+/* Counted even if it grows in place as the caller can't rely on that */
+extern "C" void* __wrap_realloc(void* p, size_t size) {
+  Count();
+  return __real_realloc(p, size);
+}
+
+void* operator new(size_t size) {
+  void* p = Allocate(size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size);
+}
+void operator delete(void* p) noexcept {
+  free(p);
+}
+void operator delete[](void* p) noexcept {
+  free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+  free(p);
+}
+
+namespace {
+
+Simulator* simulator;
+
+/* Number of calls averaged over */
+constexpr size_t kCalls = 16;
+
+/* Budgets of allocations per call. The generated clients allocate the
+ * chunks the response is received into. */
+constexpr size_t kTransportBudget = 0;
+constexpr size_t kNuggetClientBudget = 0;
+constexpr size_t kAppClientBudget = 0;
+constexpr size_t kAppClientStructsBudget = 0;
+constexpr size_t kWeaverReadBudget = 2;
+/* A batch of four allocates its buffers once for all of the calls */
+constexpr size_t kWeaverReadBatchBudget = 8;
+constexpr size_t kKeymasterUpdateOperationBudget = 2;
+constexpr size_t kIdentityRetrieveEntryValueBudget = 2;
+
+/* Average allocations of a successful call after a first call has warmed up
+ * any storage that is reused, rounded up so an allocation on only some calls
+ * counts */
+template <typename Call>
+size_t AllocationsPerCall(Call call) {
+  EXPECT_EQ(APP_SUCCESS, call());
+  allocations = 0;
+  counting = true;
+  for (size_t i = 0; i < kCalls; ++i) {
+    if (call() != APP_SUCCESS) {
+      counting = false;
+      ADD_FAILURE() << "Call failed";
+      return 0;
+    }
+  }
+  counting = false;
+  return (allocations + kCalls - 1) / kCalls;
+}
+
+class AllocationTest : public testing::Test {
+ protected:
+  AllocationTest()
+      : simulator_(
+            [this](uint8_t, uint16_t, const std::vector<uint8_t>&,
+                   std::vector<uint8_t>* reply) {
+              *reply = reply_;
+              return APP_SUCCESS;
+            },
+            std::chrono::microseconds(0)) {
+    simulator = &simulator_;
+  }
+
+  ~AllocationTest() override {
+    simulator = nullptr;
+  }
+
+  void SetReply(const google::protobuf::MessageLite& message) {
+    reply_.resize(message.ByteSizeLong());
+    message.SerializeToArray(reply_.data(), reply_.size());
+  }
+
+  std::vector<uint8_t> reply_;
+  Simulator simulator_;
+};
+
+}  // namespace
+
+extern "C" int nos_device_open(const char*, struct nos_device* dev) {
+  simulator->Open(dev);
+  return 0;
+}
+
+TEST_F(AllocationTest, Transport) {
+  reply_.assign(64, 0xa5);
+  nos_device dev;
+  simulator_.Open(&dev);
+
+  uint8_t request[32] = {};
+  uint8_t reply[64];
+  const size_t per_call = AllocationsPerCall([&] {
+    uint32_t reply_len = sizeof(reply);
+    return nos_call_application(&dev, APP_ID_TEST, 0, request, sizeof(request),
+                                reply, &reply_len);
+  });
+  EXPECT_LE(per_call, kTransportBudget);
+}
+
+TEST_F(AllocationTest, NuggetClientCallApp) {
+  reply_.assign(64, 0xa5);
+  nos::NuggetClient client;
+  client.Open();
+  ASSERT_TRUE(client.IsOpen());
+
+  const std::vector<uint8_t> request(32);
+  std::vector<uint8_t> response;
+  const size_t per_call = AllocationsPerCall([&] {
+    response.resize(64);
+    return client.CallApp(APP_ID_TEST, 0, request, &response);
+  });
+  EXPECT_LE(per_call, kNuggetClientBudget);
+}
+
+TEST_F(AllocationTest, AppClientCall) {
+  reply_.assign(64, 0xa5);
+  nos::NuggetClient client;
+  client.Open();
+  nos::AppClient app(client, APP_ID_TEST);
+
+  const std::vector<uint8_t> request(32);
+  std::vector<uint8_t> response;
+  const size_t per_call = AllocationsPerCall([&] {
+    response.resize(64);
+    return app.Call(0, request, &response);
+  });
+  EXPECT_LE(per_call, kAppClientBudget);
+}
+
+TEST_F(AllocationTest, AppClientCallStructs) {
+  reply_.assign(sizeof(nugget_app_low_power_stats), 0);
+  reply_[offsetof(nugget_app_low_power_stats, hard_reset_count)] = 5;
+  nos::NuggetClient client;
+  client.Open();
+  nos::AppClient app(client, APP_ID_NUGGET);
+
+  nugget_app_low_power_stats stats;
+  const size_t per_call = AllocationsPerCall([&] {
+    return app.Call<NUGGET_PARAM_GET_LOW_POWER_STATS>(&stats);
+  });
+  EXPECT_LE(per_call, kAppClientStructsBudget);
+  EXPECT_EQ(5u, stats.hard_reset_count);
+}
+
+TEST_F(AllocationTest, WeaverRead) {
+  nugget::app::weaver::ReadResponse message;
+  message.set_value(std::string(16, 'v'));
+  SetReply(message);
+  nos::NuggetClient client;
+  client.Open();
+  nugget::app::weaver::Weaver weaver(client);
+
+  nugget::app::weaver::ReadRequest request;
+  request.set_slot(3);
+  request.set_key(std::string(16, 'k'));
+  nugget::app::weaver::ReadResponse response;
+  const size_t per_call = AllocationsPerCall([&] {
+    return weaver.Read(request, &response);
+  });
+  EXPECT_LE(per_call, kWeaverReadBudget);
+}
+
+TEST_F(AllocationTest, WeaverReadBatch) {
+  nugget::app::weaver::ReadResponse message;
+  message.set_value(std::string(16, 'v'));
+  SetReply(message);
+  nos::NuggetClient client;
+  client.Open();
+  nugget::app::weaver::Weaver weaver(client);
+
+  std::vector<nugget::app::weaver::ReadRequest> requests(4);
+  for (size_t i = 0; i < requests.size(); ++i) {
+    requests[i].set_slot(i);
+    requests[i].set_key(std::string(16, 'k'));
+  }
+  std::vector<nugget::app::weaver::ReadResponse> responses;
+  const size_t per_call = AllocationsPerCall([&] {
+    const uint32_t status = weaver.ReadBatch(requests, &responses);
+    if (responses.size() != requests.size() ||
+        responses.back().value() != message.value()) {
+      return static_cast<uint32_t>(APP_ERROR_RPC);
+    }
+    return status;
+  });
+  EXPECT_LE(per_call, kWeaverReadBatchBudget);
+}
+
+TEST_F(AllocationTest, KeymasterUpdateOperation) {
+  nugget::app::keymaster::UpdateOperationResponse message;
+  message.set_consumed(1024);
+  message.set_output(std::string(1024, 'o'));
+  SetReply(message);
+  nos::NuggetClient client;
+  client.Open();
+  nugget::app::keymaster::Keymaster keymaster(client);
+
+  nugget::app::keymaster::UpdateOperationRequest request;
+  request.mutable_handle()->set_handle(0x1234);
+  request.set_input(std::string(1024, 'i'));
+  nugget::app::keymaster::UpdateOperationResponse response;
+  const size_t per_call = AllocationsPerCall([&] {
+    return keymaster.UpdateOperation(request, &response);
+  });
+  EXPECT_LE(per_call, kKeymasterUpdateOperationBudget);
+}
+
+TEST_F(AllocationTest, IdentityRetrieveEntryValue) {
+  nugget::app::identity::ICretrieveEntryValueResponse message;
+  message.set_content(std::string(512, 'c'));
+  SetReply(message);
+  nos::NuggetClient client;
+  client.Open();
+  nugget::app::identity::Identity identity(client);
+
+  nugget::app::identity::ICretrieveEntryValueRequest request;
+  request.set_encryptedcontent(std::string(512, 'e'));
+  request.set_namespace_("namespace");
+  request.set_name("name");
+  nugget::app::identity::ICretrieveEntryValueResponse response;
+  const size_t per_call = AllocationsPerCall([&] {
+    return identity.ICretrieveEntryValue(request, &response);
+  });
+  EXPECT_LE(per_call, kIdentityRetrieveEntryValueBudget);
+}
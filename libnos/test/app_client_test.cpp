@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cstring>
+#include <vector>
+
+#include <app_nugget.h>
+#include <application.h>
+#include <citadel_events.h>
+#include <nos/AppClient.h>
+
+#include <gtest/gtest.h>
+
+using nos::AppClient;
+
+namespace {
+
+/* Records the last request and replies with the bytes it is given */
+class FakeNugget : public nos::NuggetClientInterface {
+ public:
+  void Open() override {}
+  void Close() override {}
+  bool IsOpen() const override { return true; }
+  uint32_t Reset() const override { return APP_SUCCESS; }
+
+  uint32_t CallApp(uint32_t appId, uint16_t arg,
+                   const std::vector<uint8_t>& request,
+                   std::vector<uint8_t>* response) override {
+    app_id_ = appId;
+    arg_ = arg;
+    request_ = request;
+    if (response != nullptr) {
+      if (reply_.size() > response->capacity()) {
+        return APP_ERROR_TOO_MUCH;
+      }
+      *response = reply_;
+    }
+    return APP_SUCCESS;
+  }
+
+  template <typename T>
+  void SetReply(const T& value, size_t size = sizeof(T)) {
+    reply_.resize(size);
+    memcpy(reply_.data(), &value, size);
+  }
+
+  uint32_t app_id_ = 0;
+  uint16_t arg_ = 0;
+  std::vector<uint8_t> request_;
+  std::vector<uint8_t> reply_;
+};
+
+}  // namespace
+
+TEST(AppClientTest, CallsWithStructs) {
+  FakeNugget nugget;
+  AppClient app(nugget, APP_ID_NUGGET);
+
+  const nugget_app_board_id set = {1, 2, ~1u};
+  nugget.SetReply(set);
+  nugget_app_board_id board_id = {};
+  ASSERT_EQ(APP_SUCCESS, app.Call<NUGGET_PARAM_BOARD_ID>(set, &board_id));
+  EXPECT_EQ(static_cast<uint32_t>(APP_ID_NUGGET), nugget.app_id_);
+  EXPECT_EQ(NUGGET_PARAM_BOARD_ID, nugget.arg_);
+  ASSERT_EQ(sizeof(set), nugget.request_.size());
+  EXPECT_EQ(0, memcmp(&set, nugget.request_.data(), sizeof(set)));
+  EXPECT_EQ(1u, board_id.type);
+  EXPECT_EQ(2u, board_id.flag);
+
+  /* The request is optional when getting the ID */
+  board_id = {};
+  ASSERT_EQ(APP_SUCCESS, app.Call<NUGGET_PARAM_BOARD_ID>(&board_id));
+  EXPECT_TRUE(nugget.request_.empty());
+  EXPECT_EQ(1u, board_id.type);
+
+  const nugget_app_write32 write = {0x40000000, 7};
+  nugget.reply_.clear();
+  EXPECT_EQ(APP_SUCCESS, app.Call<NUGGET_PARAM_WRITE32>(write));
+  EXPECT_EQ(sizeof(write), nugget.request_.size());
+
+  EXPECT_EQ(APP_SUCCESS, app.Call<NUGGET_PARAM_REBOOT>());
+  EXPECT_EQ(NUGGET_PARAM_REBOOT, nugget.arg_);
+  EXPECT_TRUE(nugget.request_.empty());
+}
+
+TEST(AppClientTest, ShortRepliesChecked) {
+  FakeNugget nugget;
+  AppClient app(nugget, APP_ID_NUGGET);
+
+  /* Stats from before v1 stop short and the rest reads as zero */
+  nugget_app_low_power_stats sent = {};
+  sent.hard_reset_count = 3;
+  sent.v1_magic = 0xffffffff;
+  nugget.SetReply(sent, offsetof(nugget_app_low_power_stats, v1_magic));
+  nugget_app_low_power_stats stats;
+  memset(&stats, 0xa5, sizeof(stats));
+  ASSERT_EQ(APP_SUCCESS,
+            app.Call<NUGGET_PARAM_GET_LOW_POWER_STATS>(&stats));
+  EXPECT_EQ(3u, stats.hard_reset_count);
+  EXPECT_EQ(0u, stats.v1_magic);
+
+  /* But anything shorter is an error */
+  nugget.SetReply(sent, sizeof(uint64_t));
+  EXPECT_EQ(APP_ERROR_RPC, app.Call<NUGGET_PARAM_GET_LOW_POWER_STATS>(&stats));
+
+  /* No event pending is an empty reply */
+  nugget.reply_.clear();
+  event_report event;
+  memset(&event, 0xa5, sizeof(event));
+  ASSERT_EQ(APP_SUCCESS, app.Call<NUGGET_PARAM_GET_EVENT_REPORT>(&event));
+  EXPECT_EQ(static_cast<uint32_t>(EVENT_NONE), event.id);
+}
+
+TEST(AppClientTest, OtherAppsRejected) {
+  FakeNugget nugget;
+  AppClient app(nugget, APP_ID_TEST);
+  uint32_t cycles;
+  EXPECT_EQ(APP_ERROR_BOGUS_ARGS,
+            app.Call<NUGGET_PARAM_CYCLES_SINCE_BOOT>(&cycles));
+  EXPECT_EQ(0u, nugget.app_id_);
+}
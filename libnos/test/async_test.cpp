@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <sys/resource.h>
+
+#include <application.h>
+#include <nos/AsyncNuggetClient.h>
+
+#include <gtest/gtest.h>
+
+using nos::AsyncNuggetClient;
+using nos::CallPriority;
+using nos::MethodInfo;
+using nos::StreamedRequest;
+
+namespace {
+
+/* Records the calls made, holding up the first one until released */
+class GatedClient : public nos::NuggetClientInterface {
+ public:
+  void Open() override {}
+  void Close() override {}
+  bool IsOpen() const override { return true; }
+  uint32_t Reset() const override { return APP_SUCCESS; }
+
+  uint32_t CallApp(uint32_t, uint16_t arg, const std::vector<uint8_t>&,
+                   std::vector<uint8_t>* response) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    calls_.push_back(arg);
+    cv_.notify_all();
+    cv_.wait(lock, [this] { return released_; });
+    if (response != nullptr) {
+      response->assign(1, arg);
+    }
+    return APP_SUCCESS;
+  }
+
+  void WaitForCalls(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return calls_.size() >= count; });
+  }
+
+  void Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    released_ = true;
+    cv_.notify_all();
+  }
+
+  std::vector<uint16_t> Calls() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return calls_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool released_ = false;
+  std::vector<uint16_t> calls_;
+};
+
+/* Runs a warm-up from Reset() as NuggetClient does */
+class WarmingClient : public GatedClient {
+ public:
+  explicit WarmingClient(std::function<void()> warmUp) : warm_up_(warmUp) {}
+
+  uint32_t Reset() const override {
+    warm_up_();
+    return APP_SUCCESS;
+  }
+
+ private:
+  std::function<void()> warm_up_;
+};
+
+class EmptyRequest : public StreamedRequest {
+ public:
+  size_t Size() const override { return 0; }
+  bool WriteTo(Sink&) const override { return true; }
+};
+
+/* Make an asynchronous call whose arg identifies it */
+std::future<uint32_t> CallAsync(AsyncNuggetClient* client, uint16_t arg,
+                                CallPriority priority) {
+  auto promise = std::make_shared<std::promise<uint32_t>>();
+  std::future<uint32_t> future = promise->get_future();
+  const MethodInfo method = {"Test", arg, 0, 0, priority};
+  client->CallAppAsync(APP_ID_TEST, arg,
+                       std::unique_ptr<const StreamedRequest>(new EmptyRequest),
+                       nullptr, nullptr, method, [promise](uint32_t status) {
+                         promise->set_value(status);
+                       });
+  return future;
+}
+
+}  // namespace
+
+TEST(AsyncNuggetClientTest, CallsMadeOnWorkerByPriority) {
+  GatedClient inner;
+  AsyncNuggetClient client(inner);
+
+  std::vector<std::future<uint32_t>> results;
+  results.push_back(CallAsync(&client, 1, CallPriority::NORMAL));
+  inner.WaitForCalls(1);
+
+  // Queue up behind the first call
+  results.push_back(CallAsync(&client, 2, CallPriority::BACKGROUND));
+  results.push_back(CallAsync(&client, 3, CallPriority::NORMAL));
+  results.push_back(CallAsync(&client, 4, CallPriority::INTERACTIVE));
+  results.push_back(CallAsync(&client, 5, CallPriority::NORMAL));
+  EXPECT_EQ(4u, client.Pending());
+
+  inner.Release();
+  for (std::future<uint32_t>& result : results) {
+    EXPECT_EQ(APP_SUCCESS, result.get());
+  }
+  EXPECT_EQ((std::vector<uint16_t>{1, 4, 3, 5, 2}), inner.Calls());
+  EXPECT_EQ(0u, client.Pending());
+}
+
+TEST(AsyncNuggetClientTest, DestructionFinishesQueuedCalls) {
+  GatedClient inner;
+  std::vector<std::future<uint32_t>> results;
+  {
+    AsyncNuggetClient client(inner);
+    for (uint16_t arg = 0; arg < 3; ++arg) {
+      results.push_back(CallAsync(&client, arg, CallPriority::NORMAL));
+    }
+    inner.Release();
+  }
+  for (std::future<uint32_t>& result : results) {
+    ASSERT_EQ(std::future_status::ready,
+              result.wait_for(std::chrono::seconds(0)));
+    EXPECT_EQ(APP_SUCCESS, result.get());
+  }
+  EXPECT_EQ(3u, inner.Calls().size());
+}
+
+TEST(AsyncNuggetClientTest, SynchronousCallsPassThrough) {
+  GatedClient inner;
+  inner.Release();
+  AsyncNuggetClient client(inner);
+
+  std::vector<uint8_t> response;
+  response.reserve(1);
+  EXPECT_EQ(APP_SUCCESS, client.CallApp(APP_ID_TEST, 7, {}, &response));
+  EXPECT_EQ(std::vector<uint8_t>{7}, response);
+  EXPECT_EQ(std::vector<uint16_t>{7}, inner.Calls());
+}
+
+TEST(AsyncNuggetClientTest, WorkerScheduled) {
+  cpu_set_t allowed;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+  int cpu = 0;
+  while (!CPU_ISSET(cpu, &allowed)) {
+    ++cpu;
+  }
+  /* Lowering the priority needs no privileges */
+  const int nice = getpriority(PRIO_PROCESS, 0) + 1;
+
+  GatedClient inner;
+  inner.Release();
+  AsyncNuggetClient client(inner);
+  client.SetIoThreadScheduling(cpu, nice);
+
+  auto promise = std::make_shared<std::promise<bool>>();
+  std::future<bool> scheduled = promise->get_future();
+  const MethodInfo method = {"Test", 0, 0, 0, CallPriority::NORMAL};
+  client.CallAppAsync(
+      APP_ID_TEST, 0, std::unique_ptr<const StreamedRequest>(new EmptyRequest),
+      nullptr, nullptr, method, [promise, cpu, nice](uint32_t) {
+        cpu_set_t cpus;
+        promise->set_value(sched_getaffinity(0, sizeof(cpus), &cpus) == 0 &&
+                           CPU_COUNT(&cpus) == 1 && CPU_ISSET(cpu, &cpus) &&
+                           getpriority(PRIO_PROCESS, 0) == nice);
+      });
+  EXPECT_TRUE(scheduled.get());
+}
+
+TEST(AsyncNuggetClientTest, WarmUpCallsThroughWrapper) {
+  AsyncNuggetClient* wrapper = nullptr;
+  uint32_t warmed = APP_ERROR_INTERNAL;
+  WarmingClient inner([&] {
+    std::vector<uint8_t> response;
+    warmed = wrapper->CallApp(APP_ID_TEST, 7, {}, &response);
+  });
+  inner.Release();
+  AsyncNuggetClient client(inner);
+  wrapper = &client;
+
+  EXPECT_EQ(APP_SUCCESS, client.Reset());
+  EXPECT_EQ(APP_SUCCESS, warmed);
+  EXPECT_EQ((std::vector<uint16_t>{7}), inner.Calls());
+}
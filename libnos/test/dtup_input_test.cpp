@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <application.h>
+#include <citadel_events.h>
+#include <nos/NuggetClient.h>
+
+#include <DTupInputQueue.h>
+#include <Keymaster.client.h>
+
+#include <gtest/gtest.h>
+
+#include "simulator.h"
+
+using nos::test::Simulator;
+using nugget::app::keymaster::DTupError;
+using nugget::app::keymaster::DTupFetchInputEventResponse;
+using nugget::app::keymaster::DTupInputQueue;
+using nugget::app::keymaster::DTupKeyEvent;
+using nugget::app::keymaster::Keymaster;
+
+namespace {
+
+constexpr uint16_t kFetchDTupInputEvent = 22;
+
+Simulator* simulator;
+
+/* Keymaster holds key presses until they are fetched */
+class DTupInputTest : public testing::Test {
+ protected:
+  DTupInputTest()
+      : simulator_(
+            [this](uint8_t appId, uint16_t arg, const std::vector<uint8_t>&,
+                   std::vector<uint8_t>* reply) {
+              if (appId == APP_ID_TEST) {
+                return APP_SUCCESS;
+              }
+              if (appId != APP_ID_KEYMASTER || arg != kFetchDTupInputEvent) {
+                return APP_ERROR_BOGUS_ARGS;
+              }
+              DTupFetchInputEventResponse response;
+              {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++fetches_;
+                if (keys_.empty()) {
+                  response.set_error_code(DTupError::DTUP_NO_EVENT);
+                } else {
+                  response.set_event(keys_.front());
+                  response.set_signature("signed");
+                  keys_.pop_front();
+                }
+              }
+              const std::string message = response.SerializeAsString();
+              reply->assign(message.begin(), message.end());
+              return APP_SUCCESS;
+            },
+            std::chrono::microseconds(0)) {
+    simulator = &simulator_;
+    client_.Open();
+  }
+
+  ~DTupInputTest() override {
+    client_.Close();
+    simulator = nullptr;
+  }
+
+  void Press(DTupKeyEvent key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    keys_.push_back(key);
+  }
+
+  /* Any call sees the events pending flag */
+  void Call() {
+    ASSERT_EQ(APP_SUCCESS, client_.CallApp(APP_ID_TEST, 0, {}, nullptr));
+  }
+
+  int Fetches() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fetches_;
+  }
+
+  std::mutex mutex_;
+  std::deque<DTupKeyEvent> keys_;
+  int fetches_ = 0;
+  Simulator simulator_;
+  nos::NuggetClient client_{"/dev/sim"};
+  Keymaster keymaster_{client_};
+};
+
+}  // namespace
+
+extern "C" int nos_device_open(const char*, struct nos_device* dev) {
+  simulator->Open(dev);
+  return 0;
+}
+
+TEST_F(DTupInputTest, FetchQueuesInput) {
+  DTupInputQueue queue(keymaster_, client_);
+  Press(DTupKeyEvent::DTUP_VOL_UP);
+  Press(DTupKeyEvent::DTUP_PWR);
+  EXPECT_EQ(APP_SUCCESS, queue.Fetch());
+  EXPECT_EQ(2u, queue.Queued());
+
+  DTupFetchInputEventResponse event;
+  ASSERT_TRUE(queue.Next(&event, std::chrono::milliseconds(0)));
+  EXPECT_EQ(DTupKeyEvent::DTUP_VOL_UP, event.event());
+  EXPECT_EQ("signed", event.signature());
+  ASSERT_TRUE(queue.Next(&event, std::chrono::milliseconds(0)));
+  EXPECT_EQ(DTupKeyEvent::DTUP_PWR, event.event());
+  EXPECT_FALSE(queue.Next(&event, std::chrono::milliseconds(0)));
+
+  /* Fetching stops once keymaster has no more */
+  EXPECT_EQ(3, Fetches());
+}
+
+TEST_F(DTupInputTest, FetchIsBounded) {
+  DTupInputQueue queue(keymaster_, client_);
+  for (size_t i = 0; i < DTupInputQueue::kMaxFetches + 1; ++i) {
+    Press(DTupKeyEvent::DTUP_VOL_DOWN);
+  }
+  EXPECT_EQ(APP_SUCCESS, queue.Fetch());
+  EXPECT_EQ(DTupInputQueue::kMaxFetches, queue.Queued());
+  EXPECT_EQ(static_cast<int>(DTupInputQueue::kMaxFetches), Fetches());
+}
+
+TEST_F(DTupInputTest, NextWaitsForInput) {
+  DTupInputQueue queue(keymaster_, client_);
+  DTupFetchInputEventResponse event;
+  bool got = false;
+  std::thread prompt([&] {
+    got = queue.Next(&event, std::chrono::seconds(10));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  Press(DTupKeyEvent::DTUP_VOL_DOWN);
+  EXPECT_EQ(APP_SUCCESS, queue.Fetch());
+  prompt.join();
+  ASSERT_TRUE(got);
+  EXPECT_EQ(DTupKeyEvent::DTUP_VOL_DOWN, event.event());
+}
+
+TEST_F(DTupInputTest, RebootDropsInput) {
+  DTupInputQueue queue(keymaster_, client_);
+  Press(DTupKeyEvent::DTUP_PWR);
+  EXPECT_EQ(APP_SUCCESS, queue.Fetch());
+  EXPECT_EQ(1u, queue.Queued());
+
+  event_report event = {};
+  event.id = EVENT_REBOOTED;
+  queue.OnEvent(event);
+  EXPECT_EQ(0u, queue.Queued());
+}
+
+TEST_F(DTupInputTest, FetchIfPendingNeedsFlag) {
+  DTupInputQueue queue(keymaster_, client_);
+  Press(DTupKeyEvent::DTUP_PWR);
+  Call();
+  EXPECT_EQ(APP_SUCCESS, queue.FetchIfPending());
+  EXPECT_EQ(0, Fetches());
+
+  /* Fetched early once the device flags event reports */
+  event_report event = {};
+  event.id = EVENT_ALERT;
+  simulator_.QueueEvent(event);
+  Call();
+  EXPECT_EQ(APP_SUCCESS, queue.FetchIfPending());
+  EXPECT_EQ(1u, queue.Queued());
+  EXPECT_EQ(2, Fetches());
+}
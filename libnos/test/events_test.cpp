@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <app_nugget.h>
+#include <application.h>
+#include <citadel_events.h>
+#include <nos/NuggetClient.h>
+
+#include <gtest/gtest.h>
+
+#include "simulator.h"
+
+using nos::NuggetClient;
+using nos::test::Simulator;
+
+namespace {
+
+Simulator* simulator;
+
+class EventsTest : public testing::Test {
+ protected:
+  EventsTest()
+      : simulator_([](uint8_t, uint16_t, const std::vector<uint8_t>&,
+                      std::vector<uint8_t>*) { return APP_SUCCESS; },
+                   std::chrono::microseconds(0)),
+        client_("/dev/sim") {
+    simulator = &simulator_;
+    client_.Open();
+  }
+
+  ~EventsTest() override {
+    client_.Close();
+    simulator = nullptr;
+  }
+
+  static event_report Event(uint32_t id) {
+    event_report event = {};
+    event.id = id;
+    event.priority = EVENT_PRIORITY_MEDIUM;
+    return event;
+  }
+
+  /* Fetch events only while they are flagged, as an event service would */
+  std::vector<uint32_t> Drain() {
+    std::vector<uint32_t> ids;
+    std::vector<uint8_t> reply;
+    while (client_.EventsPending()) {
+      reply.reserve(sizeof(event_report));
+      if (client_.CallApp(APP_ID_NUGGET, NUGGET_PARAM_GET_EVENT_REPORT, {},
+                          &reply) != APP_SUCCESS ||
+          reply.size() != sizeof(event_report)) {
+        break;
+      }
+      event_report event;
+      memcpy(&event, reply.data(), sizeof(event));
+      ids.push_back(event.id);
+    }
+    return ids;
+  }
+
+  Simulator simulator_;
+  NuggetClient client_;
+};
+
+}  // namespace
+
+extern "C" int nos_device_open(const char* name, struct nos_device* dev) {
+  if (name == nullptr || std::string(name) != "/dev/sim" ||
+      simulator == nullptr) {
+    return -ENODEV;
+  }
+  simulator->Open(dev);
+  return 0;
+}
+
+TEST_F(EventsTest, NoneFlaggedWithoutEvents) {
+  ASSERT_TRUE(client_.IsOpen());
+  EXPECT_FALSE(client_.EventsPending());
+  EXPECT_EQ(APP_SUCCESS, client_.CallApp(APP_ID_TEST, 0, {}, nullptr));
+  EXPECT_FALSE(client_.EventsPending());
+  EXPECT_TRUE(Drain().empty());
+}
+
+TEST_F(EventsTest, FlaggedByOtherCallsAndDrained) {
+  ASSERT_TRUE(client_.IsOpen());
+  simulator_.QueueEvent(Event(EVENT_ALERT));
+  simulator_.QueueEvent(Event(EVENT_UPGRADED));
+
+  /* Noticed on a call to another app without asking */
+  EXPECT_EQ(APP_SUCCESS, client_.CallApp(APP_ID_TEST, 0, {}, nullptr));
+  EXPECT_TRUE(client_.EventsPending());
+
+  EXPECT_EQ((std::vector<uint32_t>{EVENT_ALERT, EVENT_UPGRADED}), Drain());
+  EXPECT_FALSE(client_.EventsPending());
+}
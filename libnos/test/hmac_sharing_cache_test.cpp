@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+#include <app_nugget.h>
+#include <application.h>
+#include <nos/NuggetClient.h>
+
+#include <HmacSharingCache.h>
+#include <Keymaster.client.h>
+
+#include <gtest/gtest.h>
+
+#include "simulator.h"
+
+using nos::test::Simulator;
+using nugget::app::keymaster::ComputeSharedHmacRequest;
+using nugget::app::keymaster::ComputeSharedHmacResponse;
+using nugget::app::keymaster::ErrorCode;
+using nugget::app::keymaster::GetHmacSharingParametersRequest;
+using nugget::app::keymaster::GetHmacSharingParametersResponse;
+using nugget::app::keymaster::HmacSharingCache;
+using nugget::app::keymaster::Keymaster;
+
+namespace {
+
+constexpr uint16_t kGetHmacSharingParameters = 19;
+constexpr uint16_t kComputeSharedHmac = 20;
+
+Simulator* simulator;
+
+/* Answers keymaster's HMAC sharing and the low power stats, counting the calls
+ * to each */
+class HmacSharingCacheTest : public testing::Test {
+ protected:
+  HmacSharingCacheTest()
+      : path_(testing::TempDir() + "hmac_sharing_cache"),
+        simulator_(
+            [this](uint8_t appId, uint16_t arg,
+                   const std::vector<uint8_t>& request,
+                   std::vector<uint8_t>* reply) {
+              return Handle(appId, arg, request, reply);
+            },
+            std::chrono::microseconds(0)) {
+    std::remove(path_.c_str());
+    simulator = &simulator_;
+    client_.Open();
+  }
+
+  ~HmacSharingCacheTest() override {
+    client_.Close();
+    simulator = nullptr;
+    std::remove(path_.c_str());
+  }
+
+  uint32_t Handle(uint8_t appId, uint16_t arg,
+                  const std::vector<uint8_t>& request,
+                  std::vector<uint8_t>* reply) {
+    ++calls_[arg];
+    if (appId == APP_ID_NUGGET && arg == NUGGET_PARAM_GET_LOW_POWER_STATS) {
+      struct nugget_app_low_power_stats stats = {};
+      stats.hard_reset_count = hard_reset_count_;
+      stats.time_since_hard_reset = time_since_hard_reset_++;
+      reply->resize(sizeof(stats));
+      memcpy(reply->data(), &stats, sizeof(stats));
+      return APP_SUCCESS;
+    }
+    if (appId != APP_ID_KEYMASTER) {
+      return APP_ERROR_BOGUS_ARGS;
+    }
+
+    std::string message;
+    if (arg == kGetHmacSharingParameters) {
+      GetHmacSharingParametersResponse response;
+      response.set_error_code(error_code_);
+      response.mutable_hmac_sharing_params()->set_seed("seed");
+      response.mutable_hmac_sharing_params()->set_nonce(
+          "nonce" + std::to_string(hard_reset_count_));
+      message = response.SerializeAsString();
+    } else if (arg == kComputeSharedHmac) {
+      ComputeSharedHmacRequest parsed;
+      if (!parsed.ParseFromArray(request.data(), request.size())) {
+        return APP_ERROR_RPC;
+      }
+      ComputeSharedHmacResponse response;
+      response.set_error_code(error_code_);
+      response.set_sharing_check(
+          "check" + std::to_string(parsed.hmac_sharing_params_size()));
+      message = response.SerializeAsString();
+    } else {
+      return APP_ERROR_BOGUS_ARGS;
+    }
+    reply->assign(message.begin(), message.end());
+    return APP_SUCCESS;
+  }
+
+  static ComputeSharedHmacRequest Participants(int count) {
+    ComputeSharedHmacRequest request;
+    for (int i = 0; i < count; ++i) {
+      request.add_hmac_sharing_params()->set_nonce(std::to_string(i));
+    }
+    return request;
+  }
+
+  /* Negotiate as the HAL does at boot, returning the sharing check */
+  std::string Negotiate(HmacSharingCache* cache, int participants = 2) {
+    GetHmacSharingParametersResponse params;
+    EXPECT_EQ(APP_SUCCESS, cache->GetHmacSharingParameters({}, &params));
+    EXPECT_EQ(ErrorCode::OK, params.error_code());
+    EXPECT_EQ("nonce" + std::to_string(hard_reset_count_),
+              params.hmac_sharing_params().nonce());
+
+    ComputeSharedHmacResponse shared;
+    EXPECT_EQ(APP_SUCCESS, cache->ComputeSharedHmac(Participants(participants),
+                                                    &shared));
+    return shared.sharing_check();
+  }
+
+  /* Files in the cache's directory that are left from saving it */
+  std::vector<std::string> TempFiles() const {
+    const size_t slash = path_.rfind('/');
+    const std::string dir = path_.substr(0, slash + 1);
+    const std::string prefix = path_.substr(slash + 1) + ".";
+    std::vector<std::string> files;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) {
+      return files;
+    }
+    while (const dirent* entry = readdir(d)) {
+      if (std::string(entry->d_name).compare(0, prefix.size(), prefix) == 0) {
+        files.push_back(entry->d_name);
+      }
+    }
+    closedir(d);
+    return files;
+  }
+
+  const std::string path_;
+  std::map<uint16_t, int> calls_;
+  uint64_t hard_reset_count_ = 7;
+  uint64_t time_since_hard_reset_ = 1000;
+  ErrorCode error_code_ = ErrorCode::OK;
+  Simulator simulator_;
+  nos::NuggetClient client_;
+  Keymaster keymaster_{client_};
+};
+
+}  // namespace
+
+extern "C" int nos_device_open(const char*, struct nos_device* dev) {
+  simulator->Open(dev);
+  return 0;
+}
+
+TEST_F(HmacSharingCacheTest, RestartDuringBootSkipsNegotiation) {
+  {
+    HmacSharingCache cache(client_, keymaster_, path_);
+    EXPECT_EQ("check2", Negotiate(&cache));
+    EXPECT_EQ("check2", Negotiate(&cache));
+  }
+  EXPECT_EQ(1, calls_[kGetHmacSharingParameters]);
+  EXPECT_EQ(1, calls_[kComputeSharedHmac]);
+  EXPECT_EQ(1, calls_[NUGGET_PARAM_GET_LOW_POWER_STATS]);
+
+  /* A restarted HAL only checks the chip's boot */
+  HmacSharingCache cache(client_, keymaster_, path_);
+  EXPECT_EQ("check2", Negotiate(&cache));
+  EXPECT_EQ(1, calls_[kGetHmacSharingParameters]);
+  EXPECT_EQ(1, calls_[kComputeSharedHmac]);
+  EXPECT_EQ(2, calls_[NUGGET_PARAM_GET_LOW_POWER_STATS]);
+}
+
+TEST_F(HmacSharingCacheTest, OnlyLatestParticipants) {
+  HmacSharingCache cache(client_, keymaster_, path_);
+  EXPECT_EQ("check2", Negotiate(&cache, 2));
+  EXPECT_EQ("check2", Negotiate(&cache, 2));
+  EXPECT_EQ(1, calls_[kComputeSharedHmac]);
+
+  /* The chip now holds the key for 3 so 2 has to be negotiated again */
+  EXPECT_EQ("check3", Negotiate(&cache, 3));
+  EXPECT_EQ("check2", Negotiate(&cache, 2));
+  EXPECT_EQ(1, calls_[kGetHmacSharingParameters]);
+  EXPECT_EQ(3, calls_[kComputeSharedHmac]);
+
+  /* Another process sees the latest negotiation */
+  HmacSharingCache restarted(client_, keymaster_, path_);
+  EXPECT_EQ("check2", Negotiate(&restarted, 2));
+  EXPECT_EQ(3, calls_[kComputeSharedHmac]);
+}
+
+TEST_F(HmacSharingCacheTest, SeesOtherProcessNegotiation) {
+  HmacSharingCache cache(client_, keymaster_, path_);
+  EXPECT_EQ("check2", Negotiate(&cache, 2));
+
+  /* Another process negotiates with other participants */
+  HmacSharingCache other(client_, keymaster_, path_);
+  EXPECT_EQ("check3", Negotiate(&other, 3));
+  EXPECT_EQ(2, calls_[kComputeSharedHmac]);
+
+  /* The chip no longer holds the key for 2 */
+  EXPECT_EQ("check2", Negotiate(&cache, 2));
+  EXPECT_EQ(3, calls_[kComputeSharedHmac]);
+  EXPECT_EQ("check2", Negotiate(&other, 2));
+  EXPECT_EQ(3, calls_[kComputeSharedHmac]);
+  EXPECT_EQ(1, calls_[kGetHmacSharingParameters]);
+}
+
+TEST_F(HmacSharingCacheTest, ChipRebootMisses) {
+  {
+    HmacSharingCache cache(client_, keymaster_, path_);
+    Negotiate(&cache);
+  }
+
+  ++hard_reset_count_;
+  {
+    HmacSharingCache cache(client_, keymaster_, path_);
+    Negotiate(&cache);
+    EXPECT_EQ(2, calls_[kGetHmacSharingParameters]);
+    EXPECT_EQ(2, calls_[kComputeSharedHmac]);
+
+    /* A reset while running is noticed once invalidated */
+    ++hard_reset_count_;
+    cache.Invalidate();
+    Negotiate(&cache);
+    EXPECT_EQ(3, calls_[kGetHmacSharingParameters]);
+    EXPECT_EQ(3, calls_[kComputeSharedHmac]);
+  }
+
+  /* A power loss clears the count but the time since goes backwards */
+  time_since_hard_reset_ = 0;
+  HmacSharingCache cache(client_, keymaster_, path_);
+  Negotiate(&cache);
+  EXPECT_EQ(4, calls_[kGetHmacSharingParameters]);
+  EXPECT_EQ(4, calls_[kComputeSharedHmac]);
+}
+
+TEST_F(HmacSharingCacheTest, ErrorsNotCached) {
+  error_code_ = ErrorCode::UNKNOWN_ERROR;
+  HmacSharingCache cache(client_, keymaster_, path_);
+  GetHmacSharingParametersResponse params;
+  ComputeSharedHmacResponse shared;
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(APP_SUCCESS, cache.GetHmacSharingParameters({}, &params));
+    EXPECT_EQ(ErrorCode::UNKNOWN_ERROR, params.error_code());
+    EXPECT_EQ(APP_SUCCESS, cache.ComputeSharedHmac(Participants(2), &shared));
+  }
+  EXPECT_EQ(2, calls_[kGetHmacSharingParameters]);
+  EXPECT_EQ(2, calls_[kComputeSharedHmac]);
+
+  error_code_ = ErrorCode::OK;
+  EXPECT_EQ("check2", Negotiate(&cache));
+  EXPECT_EQ("check2", Negotiate(&cache));
+  EXPECT_EQ(3, calls_[kGetHmacSharingParameters]);
+  EXPECT_EQ(3, calls_[kComputeSharedHmac]);
+}
+
+TEST_F(HmacSharingCacheTest, SaveUsesItsOwnTempFile) {
+  /* Another process is part way through saving */
+  const std::string other = path_ + ".tmp";
+  {
+    std::ofstream out(other, std::ios::binary);
+    out << "other";
+  }
+
+  {
+    HmacSharingCache cache(client_, keymaster_, path_);
+    EXPECT_EQ("check2", Negotiate(&cache));
+  }
+  std::string contents;
+  {
+    std::ifstream in(other, std::ios::binary);
+    std::getline(in, contents);
+  }
+  std::remove(other.c_str());
+  EXPECT_EQ("other", contents);
+  EXPECT_TRUE(TempFiles().empty());
+
+  HmacSharingCache restarted(client_, keymaster_, path_);
+  EXPECT_EQ("check2", Negotiate(&restarted));
+  EXPECT_EQ(1, calls_[kComputeSharedHmac]);
+}
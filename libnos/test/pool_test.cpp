@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <application.h>
+#include <nos/NuggetClientPool.h>
+
+#include <gtest/gtest.h>
+
+#include "simulator.h"
+
+using nos::NuggetClientPool;
+using nos::test::Simulator;
+
+namespace {
+
+constexpr size_t kDevices = 4;
+
+/* Each simulated device replies with its own index */
+std::vector<std::unique_ptr<Simulator>>* simulators;
+
+class PoolTest : public testing::Test {
+ protected:
+  PoolTest() {
+    for (size_t i = 0; i < kDevices; ++i) {
+      simulators_.emplace_back(new Simulator(
+          [i](uint8_t, uint16_t, const std::vector<uint8_t>&,
+              std::vector<uint8_t>* reply) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            reply->assign(1, i);
+            return APP_SUCCESS;
+          },
+          std::chrono::microseconds(0)));
+    }
+    simulators = &simulators_;
+  }
+
+  ~PoolTest() override {
+    simulators = nullptr;
+  }
+
+  static std::vector<std::string> Names() {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < kDevices; ++i) {
+      names.push_back("/dev/sim" + std::to_string(i));
+    }
+    return names;
+  }
+
+  /* Index of the device that answered the call */
+  static int Call(const NuggetClientPool::Lease& lease) {
+    std::vector<uint8_t> response;
+    response.reserve(1);
+    if (lease->CallApp(APP_ID_TEST, 0, {}, &response) != APP_SUCCESS ||
+        response.size() != 1) {
+      return -1;
+    }
+    return response[0];
+  }
+
+  std::vector<std::unique_ptr<Simulator>> simulators_;
+};
+
+int EnumerateSimulators(void (*found)(void* arg, const char* name),
+                        void* arg) {
+  /* Out of order to check they are sorted */
+  for (size_t i = kDevices; i-- > 0;) {
+    found(arg, ("/dev/sim" + std::to_string(i)).c_str());
+  }
+  return kDevices;
+}
+
+}  // namespace
+
+extern "C" int nos_device_open(const char* name, struct nos_device* dev) {
+  const std::string prefix = "/dev/sim";
+  if (name == nullptr || std::string(name).compare(0, prefix.size(), prefix)) {
+    return -ENODEV;
+  }
+  const size_t index = std::stoul(name + prefix.size());
+  if (index >= simulators->size()) {
+    return -ENODEV;
+  }
+  (*simulators)[index]->Open(dev);
+  return 0;
+}
+
+TEST_F(PoolTest, FindsAllDevices) {
+  EXPECT_EQ(Names(), NuggetClientPool::FindDevices(EnumerateSimulators));
+  NuggetClientPool pool(EnumerateSimulators);
+  EXPECT_EQ(kDevices, pool.Size());
+  EXPECT_EQ(kDevices, pool.Open());
+}
+
+TEST_F(PoolTest, RoutesToSpecificDevice) {
+  NuggetClientPool pool(Names());
+  ASSERT_EQ(kDevices, pool.Open());
+  for (size_t i = 0; i < kDevices; ++i) {
+    NuggetClientPool::Lease lease = pool.Acquire(i);
+    ASSERT_TRUE(lease);
+    EXPECT_EQ(i, lease.Index());
+    EXPECT_EQ(static_cast<int>(i), Call(lease));
+  }
+  EXPECT_FALSE(pool.Acquire(kDevices));
+}
+
+TEST_F(PoolTest, AnyIdleSkipsLeasedAndClosedDevices) {
+  std::vector<std::string> names = Names();
+  names[2] = "/dev/missing";
+  NuggetClientPool pool(names);
+  ASSERT_EQ(kDevices - 1, pool.Open());
+
+  NuggetClientPool::Lease held = pool.Acquire(0);
+  std::vector<NuggetClientPool::Lease> leases;
+  while (NuggetClientPool::Lease lease = pool.TryAcquire()) {
+    EXPECT_NE(0u, lease.Index());
+    EXPECT_NE(2u, lease.Index());
+    EXPECT_EQ(static_cast<int>(lease.Index()), Call(lease));
+    leases.push_back(std::move(lease));
+  }
+  EXPECT_EQ(kDevices - 2, leases.size());
+
+  held.Release();
+  NuggetClientPool::Lease lease = pool.TryAcquire();
+  ASSERT_TRUE(lease);
+  EXPECT_EQ(0u, lease.Index());
+}
+
+TEST_F(PoolTest, AcquireWaitsForIdleDevice) {
+  NuggetClientPool pool({"/dev/sim0"});
+  ASSERT_EQ(1u, pool.Open());
+  NuggetClientPool::Lease held = pool.Acquire();
+  ASSERT_TRUE(held);
+
+  std::atomic<bool> acquired(false);
+  std::thread waiter([&] {
+    NuggetClientPool::Lease lease = pool.Acquire();
+    acquired = static_cast<bool>(lease);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_FALSE(acquired);
+  held.Release();
+  waiter.join();
+  EXPECT_TRUE(acquired);
+}
+
+TEST_F(PoolTest, AcquireWithNoOpenDevice) {
+  NuggetClientPool pool({"/dev/missing"});
+  EXPECT_EQ(0u, pool.Open());
+  EXPECT_FALSE(pool.Acquire());
+  EXPECT_FALSE(pool.TryAcquire());
+}
+
+TEST_F(PoolTest, SpreadsWorkAndReportsUtilization) {
+  NuggetClientPool pool(Names());
+  ASSERT_EQ(kDevices, pool.Open());
+
+  /* One worker per device keeps every device busy */
+  constexpr int kCallsPerWorker = 20;
+  std::vector<std::thread> workers;
+  std::atomic<int> failures(0);
+  for (size_t i = 0; i < kDevices; ++i) {
+    workers.emplace_back([&] {
+      for (int n = 0; n < kCallsPerWorker; ++n) {
+        NuggetClientPool::Lease lease = pool.Acquire();
+        if (Call(lease) != static_cast<int>(lease.Index())) {
+          ++failures;
+        }
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  EXPECT_EQ(0, failures);
+
+  uint64_t leases = 0;
+  for (const NuggetClientPool::DeviceStats& stats : pool.Stats()) {
+    EXPECT_TRUE(stats.open);
+    EXPECT_GT(stats.leases, 0u) << stats.name;
+    EXPECT_GT(stats.busy.count(), 0) << stats.name;
+    EXPECT_GT(stats.utilization, 0.0) << stats.name;
+    EXPECT_LE(stats.utilization, 1.0) << stats.name;
+    leases += stats.leases;
+  }
+  EXPECT_EQ(kDevices * kCallsPerWorker, leases);
+
+  pool.ResetStats();
+  for (const NuggetClientPool::DeviceStats& stats : pool.Stats()) {
+    EXPECT_EQ(0u, stats.leases);
+    EXPECT_EQ(0, stats.busy.count());
+  }
+}
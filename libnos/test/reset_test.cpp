@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <application.h>
+#include <nos/NuggetClient.h>
+
+#include <gtest/gtest.h>
+
+#include "simulator.h"
+
+using nos::NuggetClient;
+using nos::test::Simulator;
+
+namespace {
+
+Simulator* simulator;
+/* Whether opened devices fail to reset */
+bool fail_reset;
+
+class ResetTest : public testing::Test {
+ protected:
+  ResetTest()
+      : simulator_([](uint8_t, uint16_t arg, const std::vector<uint8_t>&,
+                      std::vector<uint8_t>* reply) {
+                     reply->assign(1, arg);
+                     return APP_SUCCESS;
+                   },
+                   std::chrono::microseconds(0)) {
+    simulator = &simulator_;
+    fail_reset = false;
+  }
+
+  ~ResetTest() override {
+    simulator = nullptr;
+  }
+
+  /* The arg the device echoed back, or -1 if the call failed */
+  static int Call(NuggetClient* client, uint16_t arg) {
+    std::vector<uint8_t> response;
+    response.reserve(1);
+    if (client->CallApp(APP_ID_TEST, arg, {}, &response) != APP_SUCCESS ||
+        response.size() != 1) {
+      return -1;
+    }
+    return response[0];
+  }
+
+  Simulator simulator_;
+};
+
+}  // namespace
+
+extern "C" int nos_device_open(const char* name, struct nos_device* dev) {
+  if (name == nullptr || std::string(name) != "/dev/sim" ||
+      simulator == nullptr) {
+    return -ENODEV;
+  }
+  simulator->Open(dev);
+  if (fail_reset) {
+    dev->ops.reset = [](void*) { return -EIO; };
+  }
+  return 0;
+}
+
+TEST_F(ResetTest, WaitsForDeviceToReboot) {
+  NuggetClient client("/dev/sim");
+  client.Open();
+  ASSERT_TRUE(client.IsOpen());
+
+  const auto reboot_time = std::chrono::milliseconds(20);
+  simulator_.SetRebootTime(reboot_time);
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(0u, client.Reset());
+  EXPECT_GE(std::chrono::steady_clock::now() - start, reboot_time);
+
+  /* The first call after the reset goes straight through */
+  EXPECT_EQ(5, Call(&client, 5));
+}
+
+TEST_F(ResetTest, WarmUpsRunOnceReady) {
+  NuggetClient client("/dev/sim");
+  client.Open();
+  ASSERT_TRUE(client.IsOpen());
+
+  std::vector<int> warmed;
+  client.AddWarmUp([&] { warmed.push_back(Call(&client, 1)); });
+  client.AddWarmUp([&] { warmed.push_back(Call(&client, 2)); });
+  EXPECT_TRUE(warmed.empty());
+
+  simulator_.SetRebootTime(std::chrono::milliseconds(5));
+  EXPECT_EQ(0u, client.Reset());
+  EXPECT_EQ((std::vector<int>{1, 2}), warmed);
+
+  EXPECT_EQ(0u, client.Reset());
+  EXPECT_EQ((std::vector<int>{1, 2, 1, 2}), warmed);
+}
+
+TEST_F(ResetTest, CallsWaitForWarmUps) {
+  NuggetClient client("/dev/sim");
+  client.Open();
+  ASSERT_TRUE(client.IsOpen());
+
+  std::mutex order_mutex;
+  std::vector<int> order;
+  std::atomic<bool> warming(false);
+  client.AddWarmUp([&] {
+    warming = true;
+    /* Give the other thread's call time to overtake if it isn't held */
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const int warmed = Call(&client, 1);
+    std::lock_guard<std::mutex> lock(order_mutex);
+    order.push_back(warmed);
+  });
+
+  std::thread caller([&] {
+    while (!warming) {
+      std::this_thread::yield();
+    }
+    const int called = Call(&client, 2);
+    std::lock_guard<std::mutex> lock(order_mutex);
+    order.push_back(called);
+  });
+  EXPECT_EQ(APP_SUCCESS, client.Reset());
+  caller.join();
+
+  EXPECT_EQ((std::vector<int>{1, 2}), order);
+}
+
+TEST_F(ResetTest, WarmUpCannotReset) {
+  NuggetClient client("/dev/sim");
+  client.Open();
+  ASSERT_TRUE(client.IsOpen());
+
+  uint32_t nested = APP_SUCCESS;
+  client.AddWarmUp([&] { nested = client.Reset(); });
+  EXPECT_EQ(APP_SUCCESS, client.Reset());
+  EXPECT_EQ(APP_ERROR_BUSY, nested);
+}
+
+TEST_F(ResetTest, FailureIsDeviceError) {
+  fail_reset = true;
+  NuggetClient client("/dev/sim");
+  client.Open();
+  ASSERT_TRUE(client.IsOpen());
+
+  bool warmed = false;
+  client.AddWarmUp([&] { warmed = true; });
+  EXPECT_EQ(static_cast<uint32_t>(-EIO), client.Reset());
+  EXPECT_FALSE(warmed);
+
+  /* Calls aren't held back after a failed reset */
+  EXPECT_EQ(3, Call(&client, 3));
+}
+
+TEST_F(ResetTest, ClosedIsNotReady) {
+  NuggetClient client("/dev/sim");
+  EXPECT_EQ(APP_ERROR_NOT_READY, client.Reset());
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <app_nugget.h>
+#include <application.h>
+#include <nos/SecureSession.h>
+
+#include <gtest/gtest.h>
+
+using nos::SecureSession;
+
+namespace {
+
+constexpr uint8_t kEstablished = 1;
+
+/* Answers the handshake as Citadel would, recording the calls made */
+class FakeCitadel : public nos::NuggetClientInterface {
+ public:
+  void Open() override {}
+  void Close() override {}
+  bool IsOpen() const override { return true; }
+  uint32_t Reset() const override { return APP_SUCCESS; }
+
+  uint32_t CallApp(uint32_t appId, uint16_t arg,
+                   const std::vector<uint8_t>& request,
+                   std::vector<uint8_t>* response) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    calls_.push_back(arg);
+    if (appId != APP_ID_NUGGET) {
+      return APP_ERROR_BOGUS_ARGS;
+    }
+    switch (arg) {
+      case NUGGET_PARAM_SECURE_TRANSPORT_HANDSHAKE:
+        if (request.size() != SecureSession::kHandshakeMessageSize) {
+          return APP_ERROR_BOGUS_ARGS;
+        }
+        if (refuse_) {
+          response->assign(1, 0xee);
+        } else {
+          response->assign(SecureSession::kHandshakeMessageSize, 0xb);
+        }
+        return APP_SUCCESS;
+      case NUGGET_PARAM_SECURE_TRANSPORT_REPORT_STATE:
+        if (request.size() != 1) {
+          return APP_ERROR_BOGUS_ARGS;
+        }
+        reported_.push_back(request[0]);
+        return APP_SUCCESS;
+      default:
+        return APP_ERROR_BOGUS_ARGS;
+    }
+  }
+
+  std::vector<uint16_t> calls_;
+  std::vector<uint8_t> reported_;
+  bool refuse_ = false;
+
+ private:
+  std::mutex mutex_;
+};
+
+class FakeHandshaker : public SecureSession::Handshaker {
+ public:
+  bool Start(std::vector<uint8_t>* message) override {
+    message->assign(SecureSession::kHandshakeMessageSize, 0xa);
+    return true;
+  }
+
+  bool Finish(const std::vector<uint8_t>& message, uint8_t* state) override {
+    const bool ok = message ==
+        std::vector<uint8_t>(SecureSession::kHandshakeMessageSize, 0xb);
+    *state = ok ? kEstablished : 0;
+    return ok;
+  }
+};
+
+event_report Event(uint32_t id, uint32_t state) {
+  event_report event = {};
+  event.id = id;
+  event.event.sec_ch_state.state = state;
+  return event;
+}
+
+}  // namespace
+
+TEST(SecureSessionTest, HandshakeSharedUntilReboot) {
+  FakeCitadel citadel;
+  FakeHandshaker handshaker;
+  SecureSession session(citadel, handshaker);
+  EXPECT_FALSE(session.Established());
+
+  EXPECT_EQ(APP_SUCCESS, session.Establish());
+  EXPECT_EQ(APP_SUCCESS, session.Establish());
+  EXPECT_TRUE(session.Established());
+  EXPECT_EQ(1u, session.Handshakes());
+  EXPECT_EQ((std::vector<uint16_t>{NUGGET_PARAM_SECURE_TRANSPORT_HANDSHAKE,
+                                   NUGGET_PARAM_SECURE_TRANSPORT_REPORT_STATE}),
+            citadel.calls_);
+  EXPECT_EQ(std::vector<uint8_t>{kEstablished}, citadel.reported_);
+
+  /* Citadel confirming the state doesn't need a new handshake */
+  session.OnEvent(Event(EVENT_SEC_CH_STATE, kEstablished));
+  session.OnEvent(Event(EVENT_ALERT, 0));
+  EXPECT_TRUE(session.Established());
+
+  session.OnEvent(Event(EVENT_REBOOTED, 0));
+  EXPECT_FALSE(session.Established());
+  EXPECT_EQ(APP_SUCCESS, session.Establish());
+  EXPECT_EQ(2u, session.Handshakes());
+}
+
+TEST(SecureSessionTest, ChangedStateOrErrorInvalidates) {
+  FakeCitadel citadel;
+  FakeHandshaker handshaker;
+  SecureSession session(citadel, handshaker);
+  ASSERT_EQ(APP_SUCCESS, session.Establish());
+
+  session.OnEvent(Event(EVENT_SEC_CH_STATE, kEstablished + 1));
+  EXPECT_FALSE(session.Established());
+  ASSERT_EQ(APP_SUCCESS, session.Establish());
+
+  session.Invalidate();
+  EXPECT_FALSE(session.Established());
+  ASSERT_EQ(APP_SUCCESS, session.Establish());
+  EXPECT_EQ(3u, session.Handshakes());
+}
+
+TEST(SecureSessionTest, RefusedHandshakeRetried) {
+  FakeCitadel citadel;
+  FakeHandshaker handshaker;
+  SecureSession session(citadel, handshaker);
+
+  citadel.refuse_ = true;
+  EXPECT_EQ(APP_ERROR_RPC, session.Establish());
+  EXPECT_FALSE(session.Established());
+
+  citadel.refuse_ = false;
+  EXPECT_EQ(APP_SUCCESS, session.Establish());
+  EXPECT_EQ(2u, session.Handshakes());
+}
+
+TEST(SecureSessionTest, ConcurrentCallersShareOneHandshake) {
+  FakeCitadel citadel;
+  FakeHandshaker handshaker;
+  SecureSession session(citadel, handshaker);
+
+  std::vector<std::thread> threads;
+  std::vector<uint32_t> results(8, APP_ERROR_INTERNAL);
+  for (size_t i = 0; i < results.size(); ++i) {
+    threads.emplace_back([&, i] { results[i] = session.Establish(); });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (uint32_t result : results) {
+    EXPECT_EQ(APP_SUCCESS, result);
+  }
+  EXPECT_EQ(1u, session.Handshakes());
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NOS_BROKER_LOG_H
+#define NOS_BROKER_LOG_H
+
+#ifdef ANDROID
+/* Logging for Android */
+#include <log/log.h>
+
+#else
+/* Logging for other platforms */
+#include <cstdio>
+
+#define ALOGE(...) do { fprintf(stderr, __VA_ARGS__); \
+  fprintf(stderr, "\n"); } while (0)
+#define ALOGW(...) do { fprintf(stderr, __VA_ARGS__); \
+  fprintf(stderr, "\n"); } while (0)
+
+#endif
+
+#endif // NOS_BROKER_LOG_H
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BrokerProtocol.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace nos {
+namespace broker {
+
+namespace {
+
+/* One byte of real data has to accompany the descriptors */
+constexpr char kFdMarker = 'F';
+
+} // namespace
+
+bool SendFds(int socket, const std::vector<int>& fds) {
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+  char marker = kFdMarker;
+  iovec iov = {&marker, sizeof(marker)};
+
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+  memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+  ssize_t sent;
+  do {
+    sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  return sent == sizeof(marker);
+}
+
+bool ReceiveFds(int socket, size_t count, std::vector<int>* fds) {
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * count));
+  char marker = 0;
+  iovec iov = {&marker, sizeof(marker)};
+
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  ssize_t received;
+  do {
+    received = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+  if (received != sizeof(marker) || marker != kFdMarker) {
+    return false;
+  }
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET
+      || cmsg->cmsg_type != SCM_RIGHTS
+      || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * count)
+      || (msg.msg_flags & MSG_CTRUNC)) {
+    /* Close whatever did arrive so it doesn't leak */
+    if (cmsg != nullptr && cmsg->cmsg_type == SCM_RIGHTS) {
+      const size_t got = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const int* received_fds = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+      for (size_t i = 0; i < got; ++i) {
+        close(received_fds[i]);
+      }
+    }
+    return false;
+  }
+
+  fds->resize(count);
+  memcpy(fds->data(), CMSG_DATA(cmsg), sizeof(int) * count);
+  return true;
+}
+
+} // namespace broker
+} // namespace nos
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_BROKER_PROTOCOL_H
+#define NOS_BROKER_PROTOCOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nos {
+namespace broker {
+
+/*
+ * Each client shares a ring of slots with the broker. A client thread claims a
+ * free slot, fills in the request, marks it submitted and rings the submit
+ * doorbell. The broker writes the response into the same slot, marks it
+ * complete and rings that slot's completion doorbell.
+ */
+
+/* Number of calls each client can have in flight */
+constexpr size_t kRingSlots = 4;
+
+/* Largest request or response that can be exchanged through a slot */
+constexpr size_t kSlotDataSize = 8192;
+
+constexpr uint32_t kRingMagic = 0x4e4f5342; /* "NOSB" */
+
+enum SlotState : uint32_t {
+  kSlotFree = 0,
+  kSlotSubmitted,
+  kSlotBusy,
+  kSlotComplete,
+};
+
+enum SlotOp : uint32_t {
+  kOpCallApp = 0,
+  kOpReset,
+};
+
+struct Slot {
+  std::atomic<uint32_t> state;
+  uint32_t op;
+  uint32_t appId;
+  uint32_t arg;
+  uint32_t requestLen;
+  uint32_t responseLen;  /* capacity when submitted, length when complete */
+  uint32_t status;
+  uint8_t data[kSlotDataSize];
+};
+
+struct Ring {
+  uint32_t magic;
+  uint32_t slotCount;
+  Slot slots[kRingSlots];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "Slot state is shared between processes");
+
+/*
+ * File descriptors handed to a client, in order: the shared ring, the submit
+ * doorbell, then the completion doorbell for each slot.
+ */
+constexpr size_t kConnectionFds = 2 + kRingSlots;
+
+/* Pass file descriptors over a unix domain socket. */
+bool SendFds(int socket, const std::vector<int>& fds);
+
+/* Receive exactly count file descriptors from a unix domain socket. */
+bool ReceiveFds(int socket, size_t count, std::vector<int>* fds);
+
+} // namespace broker
+} // namespace nos
+
+#endif // NOS_BROKER_PROTOCOL_H
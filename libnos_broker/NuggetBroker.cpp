@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "libnos_broker"
+
+#include <nos/NuggetBroker.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <application.h>
+#include <nos/MethodInfo.h>
+#include <nos/ReplyChunks.h>
+#include <nos/StreamedRequest.h>
+#include <nos/ThreadScheduling.h>
+
+#include "BrokerLog.h"
+#include "BrokerProtocol.h"
+
+namespace nos {
+
+using broker::kConnectionFds;
+using broker::kOpCallApp;
+using broker::kOpReset;
+using broker::kRingMagic;
+using broker::kRingSlots;
+using broker::kSlotBusy;
+using broker::kSlotComplete;
+using broker::kSlotDataSize;
+using broker::kSlotSubmitted;
+using broker::Ring;
+using broker::Slot;
+
+struct NuggetBroker::Client {
+  int socket = -1;
+  int ring_fd = -1;
+  int submit_fd = -1;
+  int complete_fds[kRingSlots] = {-1, -1, -1, -1};
+  Ring* ring = nullptr;
+  /* Whether the peer runs as root or as the broker's user */
+  bool may_reset = false;
+  /* Where to look for the next call so each slot gets a turn */
+  size_t next_slot = 0;
+
+  ~Client() {
+    if (ring != nullptr) {
+      munmap(ring, sizeof(*ring));
+    }
+    for (int fd : complete_fds) {
+      if (fd >= 0) close(fd);
+    }
+    if (submit_fd >= 0) close(submit_fd);
+    if (ring_fd >= 0) close(ring_fd);
+    if (socket >= 0) close(socket);
+  }
+};
+
+/* A call taken from a client's slot */
+struct NuggetBroker::Call {
+  Client* client;
+  size_t index;
+  uint32_t op;
+  uint32_t appId;
+  uint16_t arg;
+  uint32_t responseLen;
+  std::vector<uint8_t> request;
+  /* Whether the client has been answered */
+  bool done;
+};
+
+namespace {
+
+void RingDoorbell(int doorbell) {
+  const uint64_t one = 1;
+  ssize_t written;
+  do {
+    written = write(doorbell, &one, sizeof(one));
+  } while (written < 0 && errno == EINTR);
+}
+
+void DrainDoorbell(int doorbell) {
+  uint64_t count;
+  while (read(doorbell, &count, sizeof(count)) < 0 && errno == EINTR) {}
+}
+
+} // namespace
+
+NuggetBroker::NuggetBroker(NuggetClientInterface& client)
+    : client_(client),
+      epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      stopped_(false),
+      io_scheduling_set_(false),
+      io_cpu_(-1),
+      io_nice_(0),
+      client_count_(0) {
+  if (epoll_fd_ < 0 || wake_fd_ < 0) {
+    ALOGE("Failed to create broker doorbells: %s", strerror(errno));
+    return;
+  }
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = wake_fd_;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) != 0) {
+    ALOGE("Failed to watch broker wake doorbell: %s", strerror(errno));
+  }
+}
+
+NuggetBroker::~NuggetBroker() {
+  if (wake_fd_ >= 0) close(wake_fd_);
+  if (epoll_fd_ >= 0) close(epoll_fd_);
+}
+
+bool NuggetBroker::AddClient(int socket) {
+  std::unique_ptr<Client> client(new Client);
+  client->socket = socket;
+
+  ucred peer = {};
+  socklen_t peerLen = sizeof(peer);
+  if (getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &peer, &peerLen) == 0) {
+    client->may_reset = peer.uid == 0 || peer.uid == getuid();
+  } else {
+    ALOGW("Failed to get client credentials: %s", strerror(errno));
+  }
+
+  client->ring_fd = memfd_create("nos_broker_ring",
+                                 MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (client->ring_fd < 0 || ftruncate(client->ring_fd, sizeof(Ring)) != 0) {
+    ALOGE("Failed to create client ring: %s", strerror(errno));
+    return false;
+  }
+  /* The client shares the ring, so stop it from shrinking it under the
+   * broker, which would fault when it next touched the slots */
+  if (fcntl(client->ring_fd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+    ALOGE("Failed to seal client ring: %s", strerror(errno));
+    return false;
+  }
+  void* ring = mmap(nullptr, sizeof(Ring), PROT_READ | PROT_WRITE, MAP_SHARED,
+                    client->ring_fd, 0);
+  if (ring == MAP_FAILED) {
+    ALOGE("Failed to map client ring: %s", strerror(errno));
+    return false;
+  }
+  /* All slots start out free */
+  client->ring = new (ring) Ring();
+  client->ring->magic = kRingMagic;
+  client->ring->slotCount = kRingSlots;
+
+  client->submit_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (client->submit_fd < 0) {
+    ALOGE("Failed to create client doorbell: %s", strerror(errno));
+    return false;
+  }
+  for (int& fd : client->complete_fds) {
+    fd = eventfd(0, EFD_CLOEXEC);
+    if (fd < 0) {
+      ALOGE("Failed to create client doorbell: %s", strerror(errno));
+      return false;
+    }
+  }
+
+  std::vector<int> fds = {client->ring_fd, client->submit_fd};
+  fds.insert(fds.end(), std::begin(client->complete_fds),
+             std::end(client->complete_fds));
+  if (fds.size() != kConnectionFds || !broker::SendFds(socket, fds)) {
+    ALOGE("Failed to send connection to client");
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(new_clients_mutex_);
+    new_clients_.push_back(std::move(client));
+  }
+  RingDoorbell(wake_fd_);
+  return true;
+}
+
+void NuggetBroker::SetIoThreadScheduling(int cpu, int nice) {
+  io_scheduling_set_ = true;
+  io_cpu_ = cpu;
+  io_nice_ = nice;
+}
+
+void NuggetBroker::ApplyIoThreadScheduling() const {
+  if (!io_scheduling_set_) {
+    return;
+  }
+
+  const int error = ::nos::SetIoThreadScheduling(io_cpu_, io_nice_);
+  if (error != 0) {
+    ALOGE("Failed to schedule broker on CPU %d with nice %d: %s", io_cpu_,
+          io_nice_, strerror(-error));
+  }
+}
+
+void NuggetBroker::Run() {
+  constexpr int kMaxEvents = 16;
+  epoll_event events[kMaxEvents];
+
+  ApplyIoThreadScheduling();
+
+  while (!stopped_.load()) {
+    const int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      ALOGE("Broker failed to wait for calls: %s", strerror(errno));
+      return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      const int fd = events[i].data.fd;
+      if (fd == wake_fd_) {
+        DrainDoorbell(wake_fd_);
+        AdoptNewClients();
+      } else if (events[i].events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) {
+        /* Only the client sockets are watched for hang ups */
+        DropClient(fd);
+      } else {
+        DrainDoorbell(fd);
+      }
+    }
+
+    /* Serve everything that is pending before waiting again */
+    while (!stopped_.load() && ServeRound()) {}
+  }
+}
+
+void NuggetBroker::Stop() {
+  stopped_.store(true);
+  RingDoorbell(wake_fd_);
+}
+
+size_t NuggetBroker::ClientCount() const {
+  return client_count_.load();
+}
+
+void NuggetBroker::AdoptNewClients() {
+  std::vector<std::unique_ptr<Client>> adopted;
+  {
+    std::lock_guard<std::mutex> lock(new_clients_mutex_);
+    adopted.swap(new_clients_);
+  }
+
+  for (auto& client : adopted) {
+    epoll_event event = {};
+    event.events = EPOLLRDHUP;
+    event.data.fd = client->socket;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client->socket, &event) != 0) {
+      ALOGE("Failed to watch client socket: %s", strerror(errno));
+      continue;
+    }
+    event.events = EPOLLIN;
+    event.data.fd = client->submit_fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client->submit_fd, &event) != 0) {
+      ALOGE("Failed to watch client doorbell: %s", strerror(errno));
+      epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client->socket, nullptr);
+      continue;
+    }
+    clients_.push_back(std::move(client));
+  }
+  client_count_.store(clients_.size());
+}
+
+void NuggetBroker::DropClient(int fd) {
+  auto it = std::find_if(clients_.begin(), clients_.end(),
+                         [fd](const std::unique_ptr<Client>& client) {
+                           return client->socket == fd;
+                         });
+  if (it == clients_.end()) {
+    return;
+  }
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, (*it)->socket, nullptr);
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, (*it)->submit_fd, nullptr);
+  clients_.erase(it);
+  client_count_.store(clients_.size());
+}
+
+/*
+ * Serve at most one call from each client, batching the calls to the same app
+ * and arg. Returns whether any were served.
+ */
+bool NuggetBroker::ServeRound() {
+  std::vector<Call> round;
+  for (auto& client : clients_) {
+    for (size_t i = 0; i < kRingSlots; ++i) {
+      const size_t index = (client->next_slot + i) % kRingSlots;
+      Slot& slot = client->ring->slots[index];
+      uint32_t expected = kSlotSubmitted;
+      if (slot.state.compare_exchange_strong(expected, kSlotBusy,
+                                             std::memory_order_acquire)) {
+        client->next_slot = (index + 1) % kRingSlots;
+        round.push_back(Take(*client, index));
+        break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < round.size(); ++i) {
+    Call& call = round[i];
+    if (call.done) {
+      continue;
+    }
+    if (call.op == kOpReset) {
+      Complete(call, call.client->may_reset
+                         ? client_.Reset()
+                         : static_cast<uint32_t>(APP_ERROR_BOGUS_ARGS), 0);
+      continue;
+    }
+
+    /* Later calls to the same method join the batch, up to a reset */
+    std::vector<Call*> batch = {&call};
+    for (size_t j = i + 1; j < round.size() && round[j].op != kOpReset; ++j) {
+      if (!round[j].done && round[j].appId == call.appId
+          && round[j].arg == call.arg) {
+        batch.push_back(&round[j]);
+      }
+    }
+    if (batch.size() == 1) {
+      ServeCall(call);
+    } else {
+      ServeBatch(batch);
+    }
+  }
+  return !round.empty();
+}
+
+/*
+ * Take a submitted call from a slot. Calls that aren't valid are completed
+ * straight away.
+ */
+NuggetBroker::Call NuggetBroker::Take(Client& client, size_t index) {
+  /* The client can still write to the slot so only these copies are used */
+  const Slot& slot = client.ring->slots[index];
+  Call call = {};
+  call.client = &client;
+  call.index = index;
+  call.op = slot.op;
+  call.appId = slot.appId;
+  const uint32_t arg = slot.arg;
+  const uint32_t requestLen = slot.requestLen;
+  call.responseLen = slot.responseLen;
+
+  if (call.op == kOpReset) {
+    return call;
+  }
+  if (call.op != kOpCallApp || requestLen > kSlotDataSize
+      || call.responseLen > kSlotDataSize || arg > UINT16_MAX) {
+    Complete(call, APP_ERROR_BOGUS_ARGS, 0);
+    return call;
+  }
+  call.arg = arg;
+  call.request.assign(slot.data, slot.data + requestLen);
+  return call;
+}
+
+void NuggetBroker::ServeCall(Call& call) {
+  std::vector<uint8_t> response;
+  response.reserve(call.responseLen);
+  const uint32_t status = client_.CallApp(
+      call.appId, call.arg, call.request,
+      call.responseLen ? &response : nullptr);
+  /* The reply is truncated to the client's buffer, as for a direct call */
+  const uint32_t replyLen = std::min<size_t>(response.size(), call.responseLen);
+  if (replyLen) {
+    memcpy(call.client->ring->slots[call.index].data, response.data(),
+           replyLen);
+  }
+  Complete(call, status, replyLen);
+}
+
+/*
+ * Make calls from several clients back to back. Each client is answered as
+ * soon as its reply is in rather than when the whole batch is done.
+ */
+void NuggetBroker::ServeBatch(const std::vector<Call*>& batch) {
+  std::vector<BufferRequest> requests;
+  std::vector<const StreamedRequest*> sources;
+  requests.reserve(batch.size());
+  size_t capacity = 0;
+  for (const Call* call : batch) {
+    requests.emplace_back(call->request.data(), call->request.size());
+    sources.push_back(&requests.back());
+    capacity = std::max<size_t>(capacity, call->responseLen);
+  }
+
+  ReplyChunks response(capacity);
+  const Call& first = *batch.front();
+  const MethodInfo method = {"NuggetBroker", first.arg, 0, 0,
+                             CallPriority::NORMAL};
+  const uint32_t status = client_.CallAppBatch(
+      first.appId, first.arg, sources, &response, nullptr, method,
+      [&](size_t index, uint32_t callStatus) {
+        Call& call = *batch[index];
+        /* Truncated to the client's buffer as ServeCall() does, the batch's
+         * buffer being as big as the biggest of them */
+        uint8_t* data = call.client->ring->slots[call.index].data;
+        uint32_t replyLen = 0;
+        for (size_t i = 0;
+             i < response.ChunkCount() && replyLen < call.responseLen; ++i) {
+          const size_t len = std::min<size_t>(response.ChunkSize(i),
+                                              call.responseLen - replyLen);
+          memcpy(data + replyLen, response.ChunkData(i), len);
+          replyLen += len;
+        }
+        Complete(call, callStatus, replyLen);
+        return static_cast<uint32_t>(APP_SUCCESS);
+      });
+
+  /* Nothing cancels the batch, so it only stops early if the device failed */
+  const uint32_t unmade = (status == APP_SUCCESS
+                           || status == NOS_ERROR_CANCELLED)
+                               ? static_cast<uint32_t>(APP_ERROR_IO)
+                               : status;
+  for (Call* call : batch) {
+    if (!call->done) {
+      Complete(*call, unmade, 0);
+    }
+  }
+}
+
+void NuggetBroker::Complete(Call& call, uint32_t status, uint32_t replyLen) {
+  Slot& slot = call.client->ring->slots[call.index];
+  slot.status = status;
+  slot.responseLen = replyLen;
+  slot.state.store(kSlotComplete, std::memory_order_release);
+  RingDoorbell(call.client->complete_fds[call.index]);
+  call.done = true;
+}
+
+} // namespace nos
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "libnos_broker"
+
+#include <nos/NuggetBrokerClient.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <application.h>
+
+#include "BrokerLog.h"
+#include "BrokerProtocol.h"
+
+namespace nos {
+
+using broker::kConnectionFds;
+using broker::kOpCallApp;
+using broker::kOpReset;
+using broker::kRingMagic;
+using broker::kRingSlots;
+using broker::kSlotComplete;
+using broker::kSlotDataSize;
+using broker::kSlotFree;
+using broker::kSlotSubmitted;
+using broker::Ring;
+using broker::Slot;
+
+NuggetBrokerClient::NuggetBrokerClient(const std::string& socket_path)
+    : socket_path_(socket_path), socket_(-1), submit_fd_(-1), ring_(nullptr),
+      open_(false), slots_in_use_(0), submits_(0) {
+}
+
+NuggetBrokerClient::~NuggetBrokerClient() {
+  Close();
+}
+
+void NuggetBrokerClient::Open() {
+  if (open_) {
+    return;
+  }
+  /* Let go of the connection that calls gave up on, if any */
+  Close();
+
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (socket_path_.size() >= sizeof(addr.sun_path)) {
+    ALOGE("Broker socket path is too long: %s", socket_path_.c_str());
+    return;
+  }
+  strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+
+  socket_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (socket_ < 0) {
+    ALOGE("Failed to create broker socket: %s", strerror(errno));
+    return;
+  }
+  if (connect(socket_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    ALOGE("Failed to connect to broker %s: %s", socket_path_.c_str(),
+          strerror(errno));
+    Close();
+    return;
+  }
+
+  std::vector<int> fds;
+  if (!broker::ReceiveFds(socket_, kConnectionFds, &fds)) {
+    ALOGE("Failed to receive connection from broker");
+    Close();
+    return;
+  }
+  const int ring_fd = fds[0];
+  submit_fd_ = fds[1];
+  complete_fds_.assign(fds.begin() + 2, fds.end());
+
+  void* ring = mmap(nullptr, sizeof(Ring), PROT_READ | PROT_WRITE, MAP_SHARED,
+                    ring_fd, 0);
+  close(ring_fd);
+  if (ring == MAP_FAILED) {
+    ALOGE("Failed to map broker ring: %s", strerror(errno));
+    Close();
+    return;
+  }
+  ring_ = static_cast<Ring*>(ring);
+  if (ring_->magic != kRingMagic || ring_->slotCount != kRingSlots) {
+    ALOGE("Incompatible broker ring");
+    Close();
+    return;
+  }
+
+  open_ = true;
+}
+
+void NuggetBrokerClient::Close() {
+  /* Calls waiting for the broker see it hang up and fail */
+  if (socket_ >= 0) {
+    shutdown(socket_, SHUT_RDWR);
+  }
+  {
+    std::unique_lock<std::mutex> lock(slots_mutex_);
+    open_ = false;
+    slot_released_.notify_all();
+    submits_done_.wait(lock, [this] { return submits_ == 0; });
+  }
+
+  if (ring_ != nullptr) {
+    munmap(ring_, sizeof(Ring));
+    ring_ = nullptr;
+  }
+  for (int fd : complete_fds_) {
+    close(fd);
+  }
+  complete_fds_.clear();
+  if (submit_fd_ >= 0) {
+    close(submit_fd_);
+    submit_fd_ = -1;
+  }
+  if (socket_ >= 0) {
+    close(socket_);
+    socket_ = -1;
+  }
+}
+
+bool NuggetBrokerClient::IsOpen() const {
+  return open_;
+}
+
+uint32_t NuggetBrokerClient::CallApp(uint32_t appId, uint16_t arg,
+                                     const std::vector<uint8_t>& request,
+                                     std::vector<uint8_t>* response) {
+  return Submit(kOpCallApp, appId, arg, request, response);
+}
+
+uint32_t NuggetBrokerClient::Reset() const {
+  return Submit(kOpReset, 0, 0, {}, nullptr);
+}
+
+/*
+ * Claim a free slot, waiting for one if they are all in use. Returns
+ * kRingSlots if the client is closed meanwhile.
+ */
+size_t NuggetBrokerClient::ClaimSlot() const {
+  std::unique_lock<std::mutex> lock(slots_mutex_);
+  constexpr uint32_t kAllSlots = (1u << kRingSlots) - 1;
+  slot_released_.wait(lock, [this] {
+    return !open_ || slots_in_use_ != kAllSlots;
+  });
+  if (!open_) {
+    return kRingSlots;
+  }
+  size_t slot = 0;
+  while (slots_in_use_ & (1u << slot)) {
+    ++slot;
+  }
+  slots_in_use_ |= 1u << slot;
+  return slot;
+}
+
+void NuggetBrokerClient::ReleaseSlot(size_t slot) const {
+  {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    slots_in_use_ &= ~(1u << slot);
+  }
+  slot_released_.notify_one();
+}
+
+/*
+ * Give up on the broker after a call in the slot failed. The broker may still
+ * own the slot, but no more calls are submitted until the client is reopened
+ * so the threads waiting for slots are failed rather than left waiting.
+ */
+void NuggetBrokerClient::Disconnect(size_t slot) const {
+  {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    open_ = false;
+    slots_in_use_ &= ~(1u << slot);
+  }
+  slot_released_.notify_all();
+}
+
+uint32_t NuggetBrokerClient::Submit(uint32_t op, uint32_t appId, uint16_t arg,
+                                    const std::vector<uint8_t>& request,
+                                    std::vector<uint8_t>* response) const {
+  {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    if (!open_) {
+      return APP_ERROR_IO;
+    }
+    ++submits_;
+  }
+
+  const uint32_t status = SubmitInSlot(op, appId, arg, request, response);
+
+  {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    if (--submits_ == 0) {
+      submits_done_.notify_all();
+    }
+  }
+  return status;
+}
+
+uint32_t NuggetBrokerClient::SubmitInSlot(uint32_t op, uint32_t appId,
+                                          uint16_t arg,
+                                          const std::vector<uint8_t>& request,
+                                          std::vector<uint8_t>* response) const {
+  if (request.size() > kSlotDataSize) {
+    return APP_ERROR_TOO_MUCH;
+  }
+
+  const size_t index = ClaimSlot();
+  if (index == kRingSlots) {
+    return APP_ERROR_IO;
+  }
+  Slot& slot = ring_->slots[index];
+
+  slot.op = op;
+  slot.appId = appId;
+  slot.arg = arg;
+  slot.requestLen = request.size();
+  slot.responseLen = 0;
+  if (response != nullptr) {
+    slot.responseLen = std::min(response->capacity(), kSlotDataSize);
+  }
+  std::copy(request.begin(), request.end(), slot.data);
+  slot.state.store(kSlotSubmitted, std::memory_order_release);
+
+  const uint64_t one = 1;
+  if (write(submit_fd_, &one, sizeof(one)) != sizeof(one)) {
+    ALOGE("Failed to ring broker doorbell: %s", strerror(errno));
+  }
+
+  /* Wait for the broker to finish, or to go away */
+  pollfd fds[] = {
+    {complete_fds_[index], POLLIN, 0},
+    {socket_, POLLRDHUP, 0},
+  };
+  while (slot.state.load(std::memory_order_acquire) != kSlotComplete) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      ALOGE("Failed to wait for broker: %s", strerror(errno));
+      Disconnect(index);
+      return APP_ERROR_IO;
+    }
+    if (fds[0].revents & POLLIN) {
+      uint64_t count;
+      (void)read(complete_fds_[index], &count, sizeof(count));
+    } else if (fds[1].revents) {
+      ALOGE("Broker went away during call");
+      Disconnect(index);
+      return APP_ERROR_IO;
+    }
+  }
+
+  uint32_t status = slot.status;
+  if (response != nullptr) {
+    const uint32_t replyLen = slot.responseLen;
+    if (replyLen > response->capacity() || replyLen > kSlotDataSize) {
+      status = APP_ERROR_TOO_MUCH;
+      response->clear();
+    } else {
+      response->assign(slot.data, slot.data + replyLen);
+    }
+  }
+
+  slot.state.store(kSlotFree, std::memory_order_relaxed);
+  ReleaseSlot(index);
+  return status;
+}
+
+} // namespace nos
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_NUGGET_BROKER_H
+#define NOS_NUGGET_BROKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <nos/NuggetClientInterface.h>
+
+namespace nos {
+
+namespace broker {
+struct Ring;
+struct Slot;
+} // namespace broker
+
+/**
+ * Shares a single connection to Nugget between client processes.
+ *
+ * The broker is run by the daemon that owns the device. The daemon accepts
+ * connections on a unix domain socket and hands each one to AddClient(). The
+ * client process then uses NuggetBrokerClient to make calls, which are
+ * exchanged through shared memory rather than the socket.
+ *
+ * Calls are served round-robin between clients, one call per client per round,
+ * so a busy client can't starve the others. Calls of a round to the same app
+ * and arg are made as a batch, which the device can work through back to back.
+ * All pending calls are drained before the broker waits for more.
+ *
+ * Only clients running as root or as the broker's user may reset the device.
+ */
+class NuggetBroker {
+public:
+    /**
+     * Create a broker for calls to the given client, which must be open.
+     */
+    explicit NuggetBroker(NuggetClientInterface& client);
+    ~NuggetBroker();
+
+    NuggetBroker(const NuggetBroker&) = delete;
+    NuggetBroker& operator=(const NuggetBroker&) = delete;
+
+    /**
+     * Set up a new client connected over the socket.
+     *
+     * The shared ring and doorbells are passed to the client over the socket.
+     * The broker takes ownership of the socket and drops the client when it is
+     * closed. Safe to call while Run() is serving other clients.
+     *
+     * @param socket Connected unix domain socket.
+     * @return       Whether the client was set up.
+     */
+    bool AddClient(int socket);
+
+    /**
+     * Set how the thread that calls Run() is scheduled, as with
+     * nos::SetIoThreadScheduling(). Applied when Run() starts.
+     *
+     * @param cpu  CPU to pin the thread to, or -1 to allow any.
+     * @param nice Nice value for the thread, lower is higher priority.
+     */
+    void SetIoThreadScheduling(int cpu, int nice);
+
+    /**
+     * Serve client calls until Stop() is called.
+     */
+    void Run();
+
+    /**
+     * Make Run() return. Safe to call from any thread.
+     */
+    void Stop();
+
+    /**
+     * Number of clients currently being served.
+     */
+    size_t ClientCount() const;
+
+private:
+    struct Client;
+    struct Call;
+
+    void ApplyIoThreadScheduling() const;
+    void AdoptNewClients();
+    void DropClient(int fd);
+    bool ServeRound();
+    Call Take(Client& client, size_t index);
+    void ServeCall(Call& call);
+    void ServeBatch(const std::vector<Call*>& batch);
+    static void Complete(Call& call, uint32_t status, uint32_t replyLen);
+
+    NuggetClientInterface& client_;
+    int epoll_fd_;
+    int wake_fd_;
+    std::atomic<bool> stopped_;
+    bool io_scheduling_set_;
+    int io_cpu_;
+    int io_nice_;
+
+    /* Only used by the thread in Run() */
+    std::vector<std::unique_ptr<Client>> clients_;
+
+    /* Clients added by other threads are picked up by Run() */
+    mutable std::mutex new_clients_mutex_;
+    std::vector<std::unique_ptr<Client>> new_clients_;
+    std::atomic<size_t> client_count_;
+};
+
+} // namespace nos
+
+#endif // NOS_NUGGET_BROKER_H
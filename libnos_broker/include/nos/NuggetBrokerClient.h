@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_NUGGET_BROKER_CLIENT_H
+#define NOS_NUGGET_BROKER_CLIENT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nos/NuggetClientInterface.h>
+
+namespace nos {
+
+namespace broker {
+struct Ring;
+} // namespace broker
+
+/**
+ * Client to communicate with Nugget through a NuggetBroker.
+ *
+ * This can be used in place of NuggetClient by anything written against
+ * NuggetClientInterface. Multiple threads may make calls concurrently.
+ *
+ * If the broker goes away the client is closed, failing calls in progress and
+ * any made later with APP_ERROR_IO until it is opened again.
+ */
+class NuggetBrokerClient : public NuggetClientInterface {
+public:
+    /**
+     * Create a client for the broker listening on the named unix domain
+     * socket.
+     */
+    explicit NuggetBrokerClient(const std::string& socket_path);
+
+    ~NuggetBrokerClient() override;
+
+    /**
+     * Connects to the broker.
+     *
+     * If this fails, isOpen() will return false.
+     */
+    void Open() override;
+
+    /**
+     * Closes the connection to the broker.
+     *
+     * Calls in progress on other threads are failed with APP_ERROR_IO and
+     * waited for before the connection is released.
+     */
+    void Close() override;
+
+    /**
+     * Checked whether a connection is open to the broker.
+     */
+    bool IsOpen() const override;
+
+    /**
+     * Call into an app running on Nugget via the broker.
+     *
+     * As with NuggetClient, the reply is truncated to the response's
+     * capacity, whether or not the broker batched the call with others.
+     *
+     * @param app_id   The ID of the app to call.
+     * @param arg      Argument to pass to the app.
+     * @param request  Data to send to the app.
+     * @param response Buffer to receive data from the app.
+     * @return         Status code from the app, or APP_ERROR_TOO_MUCH if the
+     *                 request is too big for the broker.
+     */
+    uint32_t CallApp(uint32_t appId, uint16_t arg,
+                     const std::vector<uint8_t>& request,
+                     std::vector<uint8_t>* response) override;
+
+    /**
+     * Reset the device. Use with caution; context may be lost for all of the
+     * broker's clients.
+     *
+     * Only processes running as root or as the broker's user may reset the
+     * device; others get APP_ERROR_BOGUS_ARGS.
+     */
+    uint32_t Reset() const override;
+
+private:
+    uint32_t Submit(uint32_t op, uint32_t appId, uint16_t arg,
+                    const std::vector<uint8_t>& request,
+                    std::vector<uint8_t>* response) const;
+    uint32_t SubmitInSlot(uint32_t op, uint32_t appId, uint16_t arg,
+                          const std::vector<uint8_t>& request,
+                          std::vector<uint8_t>* response) const;
+    size_t ClaimSlot() const;
+    void ReleaseSlot(size_t slot) const;
+    void Disconnect(size_t slot) const;
+
+    std::string socket_path_;
+    int socket_;
+    int submit_fd_;
+    std::vector<int> complete_fds_;
+    broker::Ring* ring_;
+    /* Cleared by calls that give up on the broker */
+    mutable std::atomic<bool> open_;
+
+    /* Slots are shared between the threads of this process */
+    mutable std::mutex slots_mutex_;
+    mutable std::condition_variable slot_released_;
+    mutable uint32_t slots_in_use_;
+    /* Calls using the ring, which Close() waits for before unmapping it */
+    mutable uint32_t submits_;
+    mutable std::condition_variable submits_done_;
+};
+
+} // namespace nos
+
+#endif // NOS_NUGGET_BROKER_CLIENT_H
@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <application.h>
+#include <nos/NuggetBroker.h>
+#include <nos/NuggetBrokerClient.h>
+
+#include <gtest/gtest.h>
+
+#include "BrokerProtocol.h"
+
+using nos::NuggetBroker;
+using nos::NuggetBrokerClient;
+using nos::broker::kRingSlots;
+
+namespace {
+
+/* Echoes each request followed by the arg, holding calls up while told to */
+class EchoDevice : public nos::NuggetClientInterface {
+ public:
+  void Open() override {}
+  void Close() override {}
+  bool IsOpen() const override { return true; }
+
+  uint32_t Reset() const override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++resets_;
+    return APP_SUCCESS;
+  }
+
+  uint32_t CallApp(uint32_t, uint16_t arg, const std::vector<uint8_t>& request,
+                   std::vector<uint8_t>* response) override {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ++calls_;
+      cv_.notify_all();
+      cv_.wait(lock, [this] { return !held_; });
+    }
+    if (response != nullptr) {
+      *response = request;
+      response->push_back(arg);
+    }
+    return APP_SUCCESS;
+  }
+
+  uint32_t CallAppBatch(uint32_t appId, uint16_t arg,
+                        const std::vector<const nos::StreamedRequest*>& requests,
+                        nos::ReplyChunks* response,
+                        const nos::CancellationToken* cancel,
+                        const nos::MethodInfo& method,
+                        const BatchReply& reply) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      batches_.push_back(requests.size());
+    }
+    return NuggetClientInterface::CallAppBatch(appId, arg, requests, response,
+                                               cancel, method, reply);
+  }
+
+  void Hold() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    held_ = true;
+  }
+
+  void Release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    held_ = false;
+    cv_.notify_all();
+  }
+
+  void WaitForCalls(size_t count) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return calls_ >= count; });
+  }
+
+  size_t Calls() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return calls_;
+  }
+
+  size_t Resets() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return resets_;
+  }
+
+  std::vector<size_t> Batches() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return batches_;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  bool held_ = false;
+  size_t calls_ = 0;
+  mutable size_t resets_ = 0;
+  std::vector<size_t> batches_;
+};
+
+/* Listen for clients on a unix domain socket, or return -1 */
+int Listen(const std::string& path) {
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    return -1;
+  }
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(path.c_str());
+
+  const int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0) {
+    return -1;
+  }
+  if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(listener, 4) != 0) {
+    close(listener);
+    return -1;
+  }
+  return listener;
+}
+
+/* Make a call whose arg identifies it, expecting it echoed back */
+uint32_t Call(NuggetBrokerClient* client, uint16_t arg) {
+  const std::vector<uint8_t> request = {1, 2, 3};
+  std::vector<uint8_t> response;
+  response.reserve(request.size() + 1);
+  const uint32_t status = client->CallApp(APP_ID_TEST, arg, request, &response);
+  if (status == APP_SUCCESS &&
+      response != std::vector<uint8_t>{1, 2, 3, static_cast<uint8_t>(arg)}) {
+    return APP_ERROR_INTERNAL;
+  }
+  return status;
+}
+
+class BrokerTest : public testing::Test {
+ protected:
+  BrokerTest() : path_(testing::TempDir() + "nos_broker"), broker_(device_) {}
+
+  void SetUp() override {
+    listener_ = Listen(path_);
+    ASSERT_GE(listener_, 0);
+    serving_ = std::thread([this] { broker_.Run(); });
+  }
+
+  void TearDown() override {
+    device_.Release();
+    broker_.Stop();
+    if (serving_.joinable()) {
+      serving_.join();
+    }
+    if (listener_ >= 0) {
+      close(listener_);
+    }
+    unlink(path_.c_str());
+  }
+
+  /* Open the client, handing its connection to the broker */
+  void Connect(NuggetBrokerClient* client) {
+    std::thread accepting([this] {
+      const int fd = accept4(listener_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd >= 0) {
+        broker_.AddClient(fd);
+      }
+    });
+    client->Open();
+    accepting.join();
+  }
+
+  std::string path_;
+  EchoDevice device_;
+  NuggetBroker broker_;
+  int listener_ = -1;
+  std::thread serving_;
+};
+
+}  // namespace
+
+TEST_F(BrokerTest, CallsRoundTrip) {
+  NuggetBrokerClient client(path_);
+  Connect(&client);
+  ASSERT_TRUE(client.IsOpen());
+
+  for (uint16_t arg = 0; arg < 10; ++arg) {
+    EXPECT_EQ(APP_SUCCESS, Call(&client, arg));
+  }
+  EXPECT_EQ(10u, device_.Calls());
+}
+
+TEST_F(BrokerTest, ClientsShareBroker) {
+  NuggetBrokerClient first(path_);
+  NuggetBrokerClient second(path_);
+  Connect(&first);
+  Connect(&second);
+  ASSERT_TRUE(first.IsOpen());
+  ASSERT_TRUE(second.IsOpen());
+
+  EXPECT_EQ(APP_SUCCESS, Call(&first, 1));
+  EXPECT_EQ(APP_SUCCESS, Call(&second, 2));
+  EXPECT_EQ(2u, broker_.ClientCount());
+}
+
+TEST_F(BrokerTest, ClientsCallsBatched) {
+  NuggetBrokerClient clients[3] = {NuggetBrokerClient(path_),
+                                   NuggetBrokerClient(path_),
+                                   NuggetBrokerClient(path_)};
+  for (auto& client : clients) {
+    Connect(&client);
+    ASSERT_TRUE(client.IsOpen());
+  }
+
+  /* Hold up the first call so the others are submitted meanwhile */
+  device_.Hold();
+  std::vector<std::future<uint32_t>> results;
+  results.push_back(std::async(std::launch::async, [&clients] {
+    return Call(&clients[0], 1);
+  }));
+  device_.WaitForCalls(1);
+  for (size_t i = 1; i < 3; ++i) {
+    results.push_back(std::async(std::launch::async, [&clients, i] {
+      return Call(&clients[i], 1);
+    }));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  device_.Release();
+
+  for (auto& result : results) {
+    EXPECT_EQ(APP_SUCCESS, result.get());
+  }
+  EXPECT_EQ(3u, device_.Calls());
+  EXPECT_EQ((std::vector<size_t>{2}), device_.Batches());
+}
+
+TEST_F(BrokerTest, ReplyTruncatedToResponse) {
+  NuggetBrokerClient client(path_);
+  Connect(&client);
+  ASSERT_TRUE(client.IsOpen());
+
+  std::vector<uint8_t> response;
+  response.reserve(1);
+  EXPECT_EQ(APP_SUCCESS, client.CallApp(APP_ID_TEST, 1, {1, 2, 3}, &response));
+  EXPECT_EQ((std::vector<uint8_t>{1}), response);
+}
+
+TEST_F(BrokerTest, BatchedRepliesTruncatedToResponse) {
+  NuggetBrokerClient clients[4] = {NuggetBrokerClient(path_),
+                                   NuggetBrokerClient(path_),
+                                   NuggetBrokerClient(path_),
+                                   NuggetBrokerClient(path_)};
+  for (auto& client : clients) {
+    Connect(&client);
+    ASSERT_TRUE(client.IsOpen());
+  }
+
+  /* Hold up another call while a call wanting the whole reply is batched
+   * with one wanting part of it and one wanting none of it */
+  device_.Hold();
+  auto held = std::async(std::launch::async, [&clients] {
+    return Call(&clients[0], 9);
+  });
+  device_.WaitForCalls(1);
+  auto whole = std::async(std::launch::async, [&clients] {
+    return Call(&clients[1], 1);
+  });
+  std::vector<uint8_t> part;
+  part.reserve(2);
+  auto partial = std::async(std::launch::async, [&clients, &part] {
+    return clients[2].CallApp(APP_ID_TEST, 1, {1, 2, 3}, &part);
+  });
+  auto none = std::async(std::launch::async, [&clients] {
+    return clients[3].CallApp(APP_ID_TEST, 1, {1, 2, 3}, nullptr);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  device_.Release();
+
+  EXPECT_EQ(APP_SUCCESS, held.get());
+  EXPECT_EQ(APP_SUCCESS, whole.get());
+  EXPECT_EQ(APP_SUCCESS, partial.get());
+  EXPECT_EQ(APP_SUCCESS, none.get());
+  EXPECT_EQ((std::vector<uint8_t>{1, 2}), part);
+  EXPECT_EQ((std::vector<size_t>{3}), device_.Batches());
+}
+
+TEST_F(BrokerTest, CallsWaitForFreeSlot) {
+  NuggetBrokerClient client(path_);
+  Connect(&client);
+  ASSERT_TRUE(client.IsOpen());
+
+  /* More calls than slots, the rest waiting while the first is held up */
+  device_.Hold();
+  const size_t count = kRingSlots + 2;
+  std::vector<std::future<uint32_t>> results;
+  for (size_t i = 0; i < count; ++i) {
+    results.push_back(std::async(std::launch::async, [&client, i] {
+      return Call(&client, i);
+    }));
+  }
+  device_.WaitForCalls(1);
+  device_.Release();
+
+  for (auto& result : results) {
+    EXPECT_EQ(APP_SUCCESS, result.get());
+  }
+  EXPECT_EQ(count, device_.Calls());
+}
+
+TEST_F(BrokerTest, CloseFailsCallsInProgress) {
+  NuggetBrokerClient client(path_);
+  Connect(&client);
+  ASSERT_TRUE(client.IsOpen());
+
+  device_.Hold();
+  auto result = std::async(std::launch::async, [&client] {
+    return Call(&client, 1);
+  });
+  device_.WaitForCalls(1);
+  client.Close();
+  EXPECT_EQ(APP_ERROR_IO, result.get());
+  EXPECT_FALSE(client.IsOpen());
+
+  /* The client can connect again once the broker is free */
+  device_.Release();
+  Connect(&client);
+  ASSERT_TRUE(client.IsOpen());
+  EXPECT_EQ(APP_SUCCESS, Call(&client, 2));
+}
+
+TEST_F(BrokerTest, ClientCannotTruncateRing) {
+  /* Connect without a client to get hold of the ring */
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+  const int raw = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  ASSERT_GE(raw, 0);
+  std::thread accepting([this] {
+    const int fd = accept4(listener_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd >= 0) {
+      broker_.AddClient(fd);
+    }
+  });
+  ASSERT_EQ(0, connect(raw, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+  accepting.join();
+  std::vector<int> fds;
+  ASSERT_TRUE(nos::broker::ReceiveFds(raw, nos::broker::kConnectionFds, &fds));
+
+  const int truncated = ftruncate(fds[0], 0);
+  const int error = errno;
+  EXPECT_NE(0, truncated);
+  EXPECT_EQ(EPERM, error);
+
+  /* The broker still looks at the ring when rung */
+  const uint64_t ring = 1;
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(ring)),
+            write(fds[1], &ring, sizeof(ring)));
+  NuggetBrokerClient client(path_);
+  Connect(&client);
+  EXPECT_EQ(APP_SUCCESS, Call(&client, 1));
+
+  for (int fd : fds) {
+    close(fd);
+  }
+  close(raw);
+}
+
+TEST_F(BrokerTest, ResetBySameUser) {
+  NuggetBrokerClient client(path_);
+  Connect(&client);
+  ASSERT_TRUE(client.IsOpen());
+
+  EXPECT_EQ(APP_SUCCESS, client.Reset());
+  EXPECT_EQ(1u, device_.Resets());
+}
+
+TEST(BrokerDeathTest, CallsFailWhenBrokerDies) {
+  const std::string path = testing::TempDir() + "nos_broker_death";
+  const int listener = Listen(path);
+  ASSERT_GE(listener, 0);
+
+  const pid_t broker = fork();
+  ASSERT_GE(broker, 0);
+  if (broker == 0) {
+    /* Never answer so the calls are still in flight when the broker dies */
+    EchoDevice device;
+    device.Hold();
+    NuggetBroker server(device);
+    const int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd >= 0 && server.AddClient(fd)) {
+      server.Run();
+    }
+    _exit(1);
+  }
+  close(listener);
+
+  NuggetBrokerClient client(path);
+  client.Open();
+  ASSERT_TRUE(client.IsOpen());
+
+  /* Fill every slot and have more calls waiting for one */
+  const size_t count = kRingSlots + 2;
+  std::vector<std::future<uint32_t>> results;
+  for (size_t i = 0; i < count; ++i) {
+    results.push_back(std::async(std::launch::async, [&client, i] {
+      return Call(&client, i);
+    }));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  kill(broker, SIGKILL);
+  waitpid(broker, nullptr, 0);
+
+  for (auto& result : results) {
+    EXPECT_EQ(APP_ERROR_IO, result.get());
+  }
+  EXPECT_FALSE(client.IsOpen());
+  EXPECT_EQ(APP_ERROR_IO, Call(&client, 0));
+  unlink(path.c_str());
+}
@@ -16,9 +16,11 @@
 
 #define LOG_TAG "libnos_datagram"
 #include <log/log.h>
+#include <nos/citadel.h>
 #include <nos/device.h>
 
 #include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
@@ -51,25 +53,39 @@ struct citadel_ioc_tpm_datagram {
 #define DEV_CITADEL   "/dev/citadel0"
 #define DEV_DAUNTLESS "/dev/gsc0"
 
-static pthread_mutex_t in_buf_mutex = PTHREAD_MUTEX_INITIALIZER;
-static uint8_t in_buf[MAX_DEVICE_TRANSFER];
-static int read_datagram(void *ctx, uint32_t command, uint8_t *buf, uint32_t len) {
-    struct citadel_ioc_tpm_datagram dg = {
-        .buf = (unsigned long)in_buf,
-        .len = len,
-        .command = command,
-    };
-    int ret;
+/*
+ * Each device has its own buffers so that calls to different devices, such
+ * as on a rack with many of them, proceed in parallel. The fd must stay first
+ * as the context used to be just a pointer to it.
+ */
+struct citadel_device {
     int fd;
+    pthread_mutex_t in_buf_mutex;
+    uint8_t in_buf[MAX_DEVICE_TRANSFER];
+    pthread_mutex_t out_buf_mutex;
+    uint8_t out_buf[MAX_DEVICE_TRANSFER];
+};
 
-    if (!ctx) {
+static struct citadel_device *get_device(void *ctx, const char *func) {
+    struct citadel_device *device = (struct citadel_device *)ctx;
 
-        ALOGE("%s: invalid (NULL) device\n", __func__);
-        return -ENODEV;
+    if (!device) {
+        ALOGE("%s: invalid (NULL) device\n", func);
+        return NULL;
     }
-    fd = *(int *)ctx;
-    if (fd < 0) {
-        ALOGE("%s: invalid device\n", __func__);
+    if (device->fd < 0) {
+        ALOGE("%s: invalid device\n", func);
+        return NULL;
+    }
+    return device;
+}
+
+static int read_datagram(void *ctx, uint32_t command, uint8_t *buf, uint32_t len) {
+    struct citadel_device *device = get_device(ctx, __func__);
+    struct citadel_ioc_tpm_datagram dg;
+    int ret;
+
+    if (!device) {
         return -ENODEV;
     }
 
@@ -79,47 +95,39 @@ static int read_datagram(void *ctx, uint32_t command, uint8_t *buf, uint32_t len
         return -E2BIG;
     }
 
+    dg.buf = (unsigned long)device->in_buf;
+    dg.len = len;
+    dg.command = command;
+
     /* Lock the in buffer while it is used for this transaction */
-    if (pthread_mutex_lock(&in_buf_mutex) != 0) {
+    if (pthread_mutex_lock(&device->in_buf_mutex) != 0) {
         ALOGE("%s: failed to lock in_buf_mutex: %s", __func__, strerror(errno));
         return -errno;
     }
 
-    ret = ioctl(fd, CITADEL_IOC_TPM_DATAGRAM, &dg);
+    ret = ioctl(device->fd, CITADEL_IOC_TPM_DATAGRAM, &dg);
     if (ret < 0) {
         ALOGE("can't send spi message: %s", strerror(errno));
         ret = -errno;
         goto out;
     }
 
-    memcpy(buf, in_buf, len);
+    memcpy(buf, device->in_buf, len);
 
 out:
-    if (pthread_mutex_unlock(&in_buf_mutex) != 0) {
+    if (pthread_mutex_unlock(&device->in_buf_mutex) != 0) {
         ALOGE("%s: failed to unlock in_buf_mutex: %s", __func__, strerror(errno));
         ret = -errno;
     }
     return ret;
 }
 
-static pthread_mutex_t out_buf_mutex = PTHREAD_MUTEX_INITIALIZER;
-static uint8_t out_buf[MAX_DEVICE_TRANSFER];
 static int write_datagram(void *ctx, uint32_t command, const uint8_t *buf, uint32_t len) {
-    struct citadel_ioc_tpm_datagram dg = {
-        .buf = (unsigned long)out_buf,
-        .len = len,
-        .command = command,
-    };
+    struct citadel_device *device = get_device(ctx, __func__);
+    struct citadel_ioc_tpm_datagram dg;
     int ret;
-    int fd;
 
-    if (!ctx) {
-        ALOGE("%s: invalid (NULL) device\n", __func__);
-        return -ENODEV;
-    }
-    fd = *(int *)ctx;
-    if (fd < 0) {
-        ALOGE("%s: invalid device\n", __func__);
+    if (!device) {
         return -ENODEV;
     }
 
@@ -129,15 +137,19 @@ static int write_datagram(void *ctx, uint32_t command, const uint8_t *buf, uint3
         return -E2BIG;
     }
 
+    dg.buf = (unsigned long)device->out_buf;
+    dg.len = len;
+    dg.command = command;
+
     /* Lock the out buffer while it is used for this transaction */
-    if (pthread_mutex_lock(&out_buf_mutex) != 0) {
+    if (pthread_mutex_lock(&device->out_buf_mutex) != 0) {
         ALOGE("%s: failed to lock out_buf_mutex: %s", __func__, strerror(errno));
         return -errno;
     }
 
-    memcpy(out_buf, buf, len);
+    memcpy(device->out_buf, buf, len);
 
-    ret = ioctl(fd, CITADEL_IOC_TPM_DATAGRAM, &dg);
+    ret = ioctl(device->fd, CITADEL_IOC_TPM_DATAGRAM, &dg);
     if (ret < 0) {
         ALOGE("can't send spi message: %s", strerror(errno));
         ret = -errno;
@@ -145,7 +157,7 @@ static int write_datagram(void *ctx, uint32_t command, const uint8_t *buf, uint3
     }
 
 out:
-    if (pthread_mutex_unlock(&out_buf_mutex) != 0) {
+    if (pthread_mutex_unlock(&device->out_buf_mutex) != 0) {
         ALOGE("%s: failed to unlock out_buf_mutex: %s", __func__, strerror(errno));
         ret = -errno;
     }
@@ -153,8 +165,8 @@ out:
 }
 
 static int wait_for_interrupt(void *ctx, int msecs) {
-    int fd = *(int *)ctx;
-    struct pollfd fds = {fd, POLLIN, 0};
+    struct citadel_device *device = (struct citadel_device *)ctx;
+    struct pollfd fds = {device->fd, POLLIN, 0};
     int rv;
 
     rv = poll(&fds, 1 /*nfds*/, msecs);
@@ -166,21 +178,14 @@ static int wait_for_interrupt(void *ctx, int msecs) {
 }
 
 static int reset(void *ctx) {
+    struct citadel_device *device = get_device(ctx, __func__);
     int ret;
-    int fd;
 
-    if (!ctx) {
-
-        ALOGE("%s: invalid (NULL) device\n", __func__);
-        return -ENODEV;
-    }
-    fd = *(int *)ctx;
-    if (fd < 0) {
-        ALOGE("%s: invalid device\n", __func__);
+    if (!device) {
         return -ENODEV;
     }
 
-    ret = ioctl(fd, CITADEL_IOC_RESET);
+    ret = ioctl(device->fd, CITADEL_IOC_RESET);
     if (ret < 0) {
         ALOGE("can't reset Citadel: %s", strerror(errno));
         return -errno;
@@ -189,21 +194,22 @@ static int reset(void *ctx) {
 }
 
 static void close_device(void *ctx) {
-    int fd;
+    struct citadel_device *device = (struct citadel_device *)ctx;
 
-    if (!ctx) {
+    if (!device) {
         ALOGE("%s: invalid (NULL) device (ignored)\n", __func__);
         return;
     }
-    fd = *(int *)ctx;
-    if (fd < 0) {
+    if (device->fd < 0) {
         ALOGE("%s: invalid device (ignored)\n", __func__);
         return;
     }
 
-    if (close(fd) < 0)
+    if (close(device->fd) < 0)
         ALOGE("Problem closing device (ignored): %s", strerror(errno));
-    free(ctx);
+    pthread_mutex_destroy(&device->in_buf_mutex);
+    pthread_mutex_destroy(&device->out_buf_mutex);
+    free(device);
 }
 
 static const char *default_device(void) {
@@ -223,8 +229,51 @@ static const char *default_device(void) {
     return 0;
 }
 
+/* Whether the name is the prefix followed only by digits */
+static int is_device_node(const char *name, const char *prefix) {
+    size_t len = strlen(prefix);
+
+    if (strncmp(name, prefix, len) != 0 || !name[len]) {
+        return 0;
+    }
+    for (name += len; *name; ++name) {
+        if (!isdigit((unsigned char)*name)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int nos_device_enumerate(void (*found)(void *arg, const char *name),
+                         void *arg) {
+    char path[sizeof("/dev/") + sizeof(((struct dirent *)0)->d_name)];
+    struct dirent *entry;
+    DIR *dir;
+    int count = 0;
+
+    dir = opendir("/dev");
+    if (!dir) {
+        ALOGE("can't open /dev: %s", strerror(errno));
+        return -errno;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (!is_device_node(entry->d_name, "citadel") &&
+            !is_device_node(entry->d_name, "gsc")) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/dev/%s", entry->d_name);
+        found(arg, path);
+        count++;
+    }
+
+    closedir(dir);
+    return count;
+}
+
 int nos_device_open(const char *device_name, struct nos_device *dev) {
-    int fd, *new_ctx;
+    struct citadel_device *new_ctx;
+    int fd;
 
     if (!device_name) {
         device_name = default_device();
@@ -241,14 +290,15 @@ int nos_device_open(const char *device_name, struct nos_device *dev) {
         return -errno;
     }
 
-    /* Our context is just a pointer to an int holding the fd */
-    new_ctx = (int *)malloc(sizeof(int));
+    new_ctx = (struct citadel_device *)malloc(sizeof(*new_ctx));
     if (!new_ctx) {
         ALOGE("can't malloc new ctx: %s", strerror(errno));
         close(fd);
         return -ENOMEM;
     }
-    *new_ctx = fd;
+    new_ctx->fd = fd;
+    pthread_mutex_init(&new_ctx->in_buf_mutex, NULL);
+    pthread_mutex_init(&new_ctx->out_buf_mutex, NULL);
 
     dev->ctx = new_ctx;
     dev->ops.read = read_datagram;
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_CITADEL_H
+#define NOS_CITADEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Find the names of all the Citadel devices that can be opened.
+ *
+ * The callback is called with the name of each device, which can be passed to
+ * nos_device_open(). Each device has its own context so they can be used in
+ * parallel. It can be passed to NuggetClientPool to pool them.
+ *
+ * Returns the number of devices found or negative on failure.
+ */
+int nos_device_enumerate(void (*found)(void *arg, const char *name),
+                         void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NOS_CITADEL_H */
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_STATUS_H
+#define NOS_STATUS_H
+
+/*
+ * Status codes returned by the host libraries as well as those in enum
+ * app_status. They are never sent by apps, which don't set bit 31, so they are
+ * kept out of the enum that is shared with the firmware.
+ */
+
+/* The caller abandoned the call */
+#define NOS_ERROR_CANCELLED 0x80000000u
+
+#endif /* NOS_STATUS_H */
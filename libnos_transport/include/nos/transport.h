@@ -16,9 +16,11 @@
 #ifndef NOS_TRANSPORT_H
 #define NOS_TRANSPORT_H
 
+#include <pthread.h>
 #include <stdint.h>
 
 #include <nos/device.h>
+#include <nos/status.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,6 +32,251 @@ uint32_t nos_call_application(const struct nos_device *dev,
                               const uint8_t *args, uint32_t arg_len,
                               uint8_t *reply, uint32_t *reply_len);
 
+/* How to wait for the app to finish a command */
+enum nos_completion_policy {
+  /* Keep polling the status. Lowest latency but occupies a core throughout. */
+  NOS_COMPLETION_POLL = 0,
+  /*
+   * Poll the status for spin_us then block on the device's interrupt between
+   * polls. Short commands complete as quickly as polling without long commands
+   * burning a core.
+   *
+   * This assumes the device interrupts when an app finishes a command, which
+   * Citadel doesn't: its interrupt line reports events and stays asserted
+   * while any are pending. There, each wait either returns at once or lasts
+   * the full interrupt wait of up to 10ms, so keep to NOS_COMPLETION_POLL
+   * unless the firmware raises a completion interrupt.
+   */
+  NOS_COMPLETION_SPIN_THEN_BLOCK,
+};
+
+/*
+ * Receives the reply in datagram sized chunks rather than into one flat buffer
+ * so the caller doesn't need to reassemble it.
+ */
+struct nos_reply_chunks {
+  /* Storage for the next len bytes of the reply, or NULL to fail the call */
+  uint8_t *(*next)(void *arg, uint32_t len);
+  /* Discard the chunks received so far as the reply is being read again */
+  void (*restart)(void *arg);
+  void *arg;
+};
+
+/*
+ * Produces the request as it is sent rather than from one flat buffer, so the
+ * first datagram can be sent while the rest is still being produced.
+ */
+struct nos_request_source {
+  /*
+   * Produce the whole request by calling emit() with at most
+   * MAX_DEVICE_TRANSFER bytes at a time, returning non-zero if emit() fails or
+   * the request can't be produced. Called again if the request is resent.
+   */
+  int (*produce)(void *arg,
+                 int (*emit)(void *emit_arg, const uint8_t *data, uint32_t len),
+                 void *emit_arg);
+  void *arg;
+};
+
+/* Number of transactions kept by a flight recorder */
+#define NOS_FLIGHT_RECORDER_ENTRIES 16
+
+/* Phases of a transaction, in the order they happen */
+enum nos_flight_phase {
+  NOS_PHASE_READY = 0,  /* Making sure the app is idle */
+  NOS_PHASE_SEND,       /* Sending the request and go command */
+  NOS_PHASE_POLL,       /* Waiting for the app to be done */
+  NOS_PHASE_RECEIVE,    /* Reading the reply */
+  NOS_PHASE_CLEAR,      /* Clearing the status for the next caller */
+  NOS_PHASE_COUNT,
+};
+
+/* Marks a phase that the transaction didn't reach */
+#define NOS_PHASE_NOT_REACHED 0xffffffffu
+
+/* What happened during one transaction */
+struct nos_flight_record {
+  uint64_t start_ns;      /* CLOCK_MONOTONIC when the call started */
+  uint32_t total_us;      /* Duration of the whole call */
+  uint32_t result;        /* Code returned to the caller */
+  uint32_t arg_len;
+  uint32_t reply_len;     /* Bytes of reply received */
+  uint32_t datagrams;     /* Reads and writes the device completed */
+  uint16_t retries;       /* Datagrams and commands that had to be repeated */
+  uint16_t polls;         /* Status reads while waiting for the app */
+  uint16_t params;
+  uint8_t app_id;
+  uint8_t phase;          /* Last phase reached */
+  /* When each phase last began, from the start of the call */
+  uint32_t phase_us[NOS_PHASE_COUNT];
+  /* Last status word read from the app in each phase */
+  uint32_t phase_status[NOS_PHASE_COUNT];
+};
+
+/*
+ * Always-on record of the last few transactions with a device, dumped when a
+ * call fails at the transport level or is slow. Recording costs a few stores
+ * per datagram and a clock read per phase.
+ *
+ * Zero initialize it, which logs dumps as text and disables the slow call
+ * threshold. Calls to different apps can share a recorder while they overlap,
+ * as each call is only added to it once done. Read it from the dump callback or
+ * through nos_flight_recorder_copy() while calls are being made.
+ */
+struct nos_flight_recorder {
+  struct nos_flight_record records[NOS_FLIGHT_RECORDER_ENTRIES];
+  /* Transactions recorded so far; the next goes in records[count % ENTRIES] */
+  uint32_t count;
+  /* Dump after calls taking at least this many microseconds, 0 for never */
+  uint32_t slow_call_us;
+  /*
+   * Called to dump the recorder, or NULL to log it with
+   * nos_flight_recorder_log(). It is passed a copy taken when the call was
+   * added, after the recorder is unlocked, so it can make calls.
+   */
+  void (*dump)(const struct nos_flight_recorder *recorder, void *arg);
+  void *dump_arg;
+  /*
+   * Held while a call is added or the recorder is copied. A zeroed mutex is
+   * unlocked on Linux and Android so zero initializing the recorder is enough.
+   */
+  pthread_mutex_t lock;
+};
+
+/* Log the recorded transactions as text, oldest first */
+void nos_flight_recorder_log(const struct nos_flight_recorder *recorder);
+
+/* Copy a recorder that calls may be adding to */
+void nos_flight_recorder_copy(const struct nos_flight_recorder *recorder,
+                              struct nos_flight_recorder *copy);
+
+/* Optional per-call behaviour. Zero fields select the default behaviour. */
+struct nos_call_options {
+  /*
+   * Checked while polling for the app to finish and before each retry wait.
+   * Return non-zero to abandon the call, which then returns
+   * NOS_ERROR_CANCELLED. The app's status is cleared, but if it is still
+   * working on the abandoned command it is left to finish and the next call
+   * gets APP_ERROR_BUSY until it has. The device is never reset for it.
+   */
+  int (*is_cancelled)(const void *cancel_arg);
+  const void *cancel_arg;
+
+  /* How to wait for the app to finish */
+  enum nos_completion_policy completion;
+  /* Microseconds to poll before blocking with NOS_COMPLETION_SPIN_THEN_BLOCK */
+  uint32_t spin_us;
+
+  /*
+   * Where to put the reply instead of the reply buffer, which may then be
+   * NULL. reply_len still limits and returns the length of the reply.
+   */
+  const struct nos_reply_chunks *reply_chunks;
+
+  /*
+   * Where to get the request from instead of the args buffer, which may then
+   * be NULL. arg_len is still the length of the request.
+   */
+  const struct nos_request_source *request_source;
+
+  /* Where to record the transaction */
+  struct nos_flight_recorder *recorder;
+
+  /*
+   * Milliseconds to wait for the app to finish before abandoning the call
+   * with APP_ERROR_TIMEOUT, or 0 for the default limit. The app is left to
+   * finish as for a cancelled call.
+   */
+  uint32_t timeout_ms;
+
+  /*
+   * Set to whether the last status read during the call had
+   * STATUS_FLAG_EVENTS_PENDING, if not NULL. Left alone if no valid v1 status
+   * was read. Firmware without the flag never sets it.
+   */
+  int *events_pending;
+};
+
+/* As nos_call_application() but with options, which may be NULL */
+uint32_t nos_call_application_opts(const struct nos_device *dev,
+                                   uint8_t app_id, uint16_t params,
+                                   const uint8_t *args, uint32_t arg_len,
+                                   uint8_t *reply, uint32_t *reply_len,
+                                   const struct nos_call_options *opts);
+
+/* One call of a batch */
+struct nos_batch_call {
+  uint8_t app_id;
+  uint16_t params;
+  const uint8_t *args;
+  uint32_t arg_len;
+  uint8_t *reply;
+  /* Size of the reply buffer, replaced with the length of the reply */
+  uint32_t reply_len;
+  /* Used instead of the batch's options if not NULL */
+  const struct nos_request_source *request_source;
+  const struct nos_reply_chunks *reply_chunks;
+  /* Code returned by the call, once it has been made */
+  uint32_t result;
+};
+
+/*
+ * Make several calls back to back, in order, with options that apply to each,
+ * which may be NULL.
+ *
+ * The app's readiness is only checked if the previous call was to a different
+ * app or didn't leave it idle. The batch stops early if a call fails at the
+ * transport level, is cancelled or times out, or if done is not NULL and
+ * returns non-zero. done is called with the index of each call once it has
+ * been made, such as to consume a reply buffer shared by the calls.
+ *
+ * Returns the number of calls made, whose results have been set.
+ */
+uint32_t nos_call_application_batch(const struct nos_device *dev,
+                                    struct nos_batch_call *calls,
+                                    uint32_t count,
+                                    const struct nos_call_options *opts,
+                                    int (*done)(void *arg, uint32_t index),
+                                    void *done_arg);
+
+/*
+ * Make several calls as nos_call_application_batch() does, but queue them on
+ * the app when it can take more than one at a time.
+ *
+ * A v3 app queues up to TRANSPORT_QUEUE_DEPTH small requests and works through
+ * them while the replies of earlier calls are read, so the calls only wait on
+ * the bus for the first request. Calls are queued if they are all to the same
+ * app and their requests fit in a single datagram, otherwise, or if the app is
+ * older, they are made as a batch.
+ *
+ * done is called as each reply is taken, which is in order unless a request
+ * was corrupted, or the app was too busy to take it, and it had to be queued
+ * again. If the pipeline stops early, including when it is cancelled, the calls
+ * still queued are waited for and finished without their replies and aren't
+ * passed to done. The device is only reset if the app can't be brought back to
+ * idle.
+ *
+ * Returns the number of calls passed to done.
+ */
+uint32_t nos_call_application_pipelined(const struct nos_device *dev,
+                                        struct nos_batch_call *calls,
+                                        uint32_t count,
+                                        const struct nos_call_options *opts,
+                                        int (*done)(void *arg, uint32_t index),
+                                        void *done_arg);
+
+/*
+ * Wait for the device to be ready for calls after it has been reset.
+ *
+ * The device is probed quickly at first, backing off to the interval the
+ * transport retries at, and again as soon as it interrupts, so callers can use
+ * it as soon as it has rebooted rather than finding it still asleep.
+ *
+ * Returns 0 once ready, -ETIMEDOUT if it wasn't ready within timeout_ms, or
+ * the device's error. A timeout_ms of 0 waits as long as a call would retry.
+ */
+int nos_wait_until_ready(const struct nos_device *dev, uint32_t timeout_ms);
+
 #ifdef __cplusplus
 }
 #endif
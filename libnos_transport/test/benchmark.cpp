@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the latency and CPU cost of the completion policies against the
+ * simulator for commands of different lengths.
+ *
+ * Usage: benchmark [--cpu=N] [--nice=N] [--calls=N]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include <application.h>
+#include <nos/ThreadScheduling.h>
+#include <nos/transport.h>
+
+#include "simulator.h"
+
+using nos::test::Simulator;
+using std::chrono::microseconds;
+
+namespace {
+
+struct Policy {
+  const char* name;
+  nos_completion_policy completion;
+  uint32_t spin_us;
+};
+
+const Policy kPolicies[] = {
+  {"poll", NOS_COMPLETION_POLL, 0},
+  {"spin200+block", NOS_COMPLETION_SPIN_THEN_BLOCK, 200},
+  {"block", NOS_COMPLETION_SPIN_THEN_BLOCK, 0},
+};
+
+const microseconds kCommandTimes[] = {
+  microseconds(50), microseconds(200), microseconds(1000), microseconds(10000),
+};
+
+/* Typical time for a datagram on the SPI bus */
+const microseconds kTransferTime(20);
+
+double ThreadCpuUs() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+double Percentile(std::vector<double>* samples, double p) {
+  const size_t i = std::min(samples->size() - 1,
+                            static_cast<size_t>(p * samples->size()));
+  std::nth_element(samples->begin(), samples->begin() + i, samples->end());
+  return (*samples)[i];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int cpu = -1;
+  /* Unless asked, keep the nice value it was started with */
+  int nice = getpriority(PRIO_PROCESS, 0);
+  int calls = 500;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--cpu=", 6) == 0) {
+      cpu = atoi(argv[i] + 6);
+    } else if (strncmp(argv[i], "--nice=", 7) == 0) {
+      nice = atoi(argv[i] + 7);
+    } else if (strncmp(argv[i], "--calls=", 8) == 0) {
+      calls = std::max(1, atoi(argv[i] + 8));
+    } else {
+      fprintf(stderr, "Usage: %s [--cpu=N] [--nice=N] [--calls=N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  /* Schedule this thread as the I/O thread would be */
+  const int scheduled = nos::SetIoThreadScheduling(cpu, nice);
+  if (scheduled != 0) {
+    fprintf(stderr, "SetIoThreadScheduling: %s\n", strerror(-scheduled));
+  }
+
+  microseconds command_time(0);
+  Simulator sim(
+      [&command_time](uint8_t, uint16_t, const std::vector<uint8_t>& request,
+                      std::vector<uint8_t>* reply) {
+        std::this_thread::sleep_for(command_time);
+        *reply = request;
+        return APP_SUCCESS;
+      },
+      kTransferTime);
+  nos_device dev;
+  sim.Open(&dev);
+
+  printf("%-10s %-14s %10s %10s %12s\n",
+         "command", "policy", "p50 (us)", "p99 (us)", "cpu/call (us)");
+  const std::vector<uint8_t> request(64, 0xa5);
+  std::vector<uint8_t> reply(64);
+  for (const microseconds time : kCommandTimes) {
+    command_time = time;
+    /* Keep the long commands from taking too long */
+    const int count = time.count() >= 10000 ? std::max(1, calls / 10) : calls;
+
+    for (const Policy& policy : kPolicies) {
+      const nos_call_options opts = {
+        .completion = policy.completion,
+        .spin_us = policy.spin_us,
+      };
+      std::vector<double> latencies;
+      latencies.reserve(count);
+      const double cpu_start = ThreadCpuUs();
+      for (int i = 0; i < count; ++i) {
+        uint32_t reply_len = reply.size();
+        const auto start = std::chrono::steady_clock::now();
+        const uint32_t res = nos_call_application_opts(
+            &dev, 1, 0, request.data(), request.size(), reply.data(),
+            &reply_len, &opts);
+        const auto end = std::chrono::steady_clock::now();
+        if (res != APP_SUCCESS) {
+          fprintf(stderr, "Call failed: 0x%x\n", res);
+          return 1;
+        }
+        latencies.push_back(
+            std::chrono::duration<double, std::micro>(end - start).count());
+      }
+      const double cpu_per_call = (ThreadCpuUs() - cpu_start) / count;
+
+      printf("%-10lld %-14s %10.1f %10.1f %12.1f\n",
+             static_cast<long long>(time.count()), policy.name,
+             Percentile(&latencies, 0.50), Percentile(&latencies, 0.99),
+             cpu_per_call);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures how throughput and tail latency degrade as the transport's retry
+ * loops deal with injected faults, to compare retry policies.
+ *
+ * Usage: fault_benchmark [--calls=N] [--seed=N]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <application.h>
+#include <nos/transport.h>
+
+#include "faulty_device.h"
+#include "simulator.h"
+
+using nos::test::FaultyDevice;
+using nos::test::Simulator;
+using std::chrono::microseconds;
+
+namespace {
+
+struct Scenario {
+  const char* name;
+  FaultyDevice::Faults faults;
+};
+
+std::vector<Scenario> Scenarios() {
+  std::vector<Scenario> scenarios;
+  FaultyDevice::Faults faults;
+  scenarios.push_back({"none", faults});
+
+  faults = {};
+  faults.eagain_storm = 0.01;
+  scenarios.push_back({"eagain 1%", faults});
+
+  faults = {};
+  faults.io_error = 0.001;
+  scenarios.push_back({"io error 0.1%", faults});
+
+  faults = {};
+  faults.status_crc = 0.01;
+  scenarios.push_back({"status crc 1%", faults});
+
+  faults = {};
+  faults.reply_crc = 0.01;
+  scenarios.push_back({"reply crc 1%", faults});
+
+  faults = {};
+  faults.too_much = 0.01;
+  scenarios.push_back({"too much 1%", faults});
+
+  faults = {};
+  faults.checksum = 0.01;
+  scenarios.push_back({"checksum 1%", faults});
+
+  faults = {};
+  faults.hang = 0.005;
+  scenarios.push_back({"hang 0.5%", faults});
+
+  faults = {};
+  faults.slow = 0.05;
+  scenarios.push_back({"slow 5%", faults});
+
+  faults = {};
+  faults.eagain_storm = 0.002;
+  faults.status_crc = 0.002;
+  faults.reply_crc = 0.002;
+  faults.too_much = 0.002;
+  faults.checksum = 0.002;
+  faults.slow = 0.01;
+  scenarios.push_back({"mixed", faults});
+  return scenarios;
+}
+
+struct Result {
+  const char* name;
+  double calls_per_second;
+  double p50;
+  double p99;
+  double p999;
+  double max;
+  int failed;
+  uint64_t injected;
+};
+
+/* Typical time for a datagram on the SPI bus */
+const microseconds kTransferTime(20);
+
+double Percentile(std::vector<double>* samples, double p) {
+  const size_t i = std::min(samples->size() - 1,
+                            static_cast<size_t>(p * samples->size()));
+  std::nth_element(samples->begin(), samples->begin() + i, samples->end());
+  return (*samples)[i];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int calls = 2000;
+  uint32_t seed = 1;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--calls=", 8) == 0) {
+      calls = std::max(1, atoi(argv[i] + 8));
+    } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+      seed = strtoul(argv[i] + 7, nullptr, 0);
+    } else {
+      fprintf(stderr, "Usage: %s [--calls=N] [--seed=N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  Simulator sim(
+      [](uint8_t, uint16_t, const std::vector<uint8_t>& request,
+         std::vector<uint8_t>* reply) {
+        *reply = request;
+        return APP_SUCCESS;
+      },
+      kTransferTime);
+  nos_device sim_dev;
+  sim.Open(&sim_dev);
+
+  std::vector<uint8_t> request(64);
+  for (size_t i = 0; i < request.size(); ++i) {
+    request[i] = i;
+  }
+  std::vector<uint8_t> reply(64);
+
+  /* The transport logs the faults, so report once they are all done */
+  std::vector<Result> results;
+  for (const Scenario& scenario : Scenarios()) {
+    FaultyDevice faulty(sim_dev, scenario.faults, seed);
+    nos_device dev;
+    faulty.Open(&dev);
+
+    std::vector<double> latencies;
+    latencies.reserve(calls);
+    int failed = 0;
+    const auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i) {
+      uint32_t reply_len = reply.size();
+      const auto start = std::chrono::steady_clock::now();
+      const uint32_t res = nos_call_application(
+          &dev, 1, 0, request.data(), request.size(), reply.data(),
+          &reply_len);
+      const auto end = std::chrono::steady_clock::now();
+      if (res != APP_SUCCESS ||
+          !std::equal(request.begin(), request.end(), reply.begin())) {
+        ++failed;
+      }
+      latencies.push_back(
+          std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+
+    results.push_back({scenario.name, calls / seconds,
+                       Percentile(&latencies, 0.50),
+                       Percentile(&latencies, 0.99),
+                       Percentile(&latencies, 0.999),
+                       *std::max_element(latencies.begin(), latencies.end()),
+                       failed, faulty.Counts().Total()});
+  }
+
+  printf("%-14s %10s %10s %10s %10s %10s %8s %9s\n", "faults", "calls/s",
+         "p50 (us)", "p99 (us)", "p99.9 (us)", "max (us)", "failed",
+         "injected");
+  for (const Result& r : results) {
+    printf("%-14s %10.0f %10.1f %10.1f %10.1f %10.1f %8d %9llu\n", r.name,
+           r.calls_per_second, r.p50, r.p99, r.p999, r.max, r.failed,
+           static_cast<unsigned long long>(r.injected));
+  }
+
+  return 0;
+}
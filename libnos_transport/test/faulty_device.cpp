@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "faulty_device.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include <application.h>
+
+#include "crc16.h"
+
+namespace nos {
+namespace test {
+
+namespace {
+
+int FaultyRead(void* ctx, uint32_t command, uint8_t* buf, uint32_t len) {
+  return static_cast<FaultyDevice*>(ctx)->Read(command, buf, len);
+}
+int FaultyWrite(void* ctx, uint32_t command, const uint8_t* buf, uint32_t len) {
+  return static_cast<FaultyDevice*>(ctx)->Write(command, buf, len);
+}
+int FaultyWaitForInterrupt(void* ctx, int msecs) {
+  return static_cast<FaultyDevice*>(ctx)->WaitForInterrupt(msecs);
+}
+int FaultyReset(void* ctx) {
+  return static_cast<FaultyDevice*>(ctx)->Reset();
+}
+void FaultyClose(void*) {
+}
+
+}  // namespace
+
+uint64_t FaultyDevice::Injected::Total() const {
+  return eagain + io_error + status_crc + reply_crc + too_much + checksum +
+         hang + slow;
+}
+
+FaultyDevice::FaultyDevice(const nos_device& inner, const Faults& faults,
+                           uint32_t seed)
+    : inner_(inner), faults_(faults), rng_(seed), uniform_(0.0, 1.0),
+      eagain_left_(0), error_code_(APP_SUCCESS) {
+}
+
+void FaultyDevice::Open(nos_device* dev) {
+  dev->ctx = this;
+  dev->ops.read = FaultyRead;
+  dev->ops.write = FaultyWrite;
+  dev->ops.wait_for_interrupt =
+      inner_.ops.wait_for_interrupt ? FaultyWaitForInterrupt : nullptr;
+  dev->ops.reset = FaultyReset;
+  dev->ops.close = FaultyClose;
+}
+
+bool FaultyDevice::Chance(double probability) {
+  return probability > 0 && uniform_(rng_) < probability;
+}
+
+int FaultyDevice::DatagramFault() {
+  if (eagain_left_ > 0 || Chance(faults_.eagain_storm)) {
+    /* The chip is asleep for a while */
+    if (eagain_left_ == 0) {
+      eagain_left_ = faults_.eagain_storm_length;
+    }
+    --eagain_left_;
+    ++injected_.eagain;
+    return -EAGAIN;
+  }
+  if (Chance(faults_.io_error)) {
+    ++injected_.io_error;
+    return -EIO;
+  }
+  if (Chance(faults_.slow)) {
+    ++injected_.slow;
+    std::this_thread::sleep_for(faults_.slow_time);
+  }
+  return 0;
+}
+
+void FaultyDevice::RewriteStatus(uint8_t* buf, uint32_t len) {
+  transport_status status;
+  if (len < sizeof(status)) {
+    return;
+  }
+  memcpy(&status, buf, sizeof(status));
+  if (status.length < STATUS_MIN_LENGTH || status.length > STATUS_MAX_LENGTH) {
+    /* Leave v0 alone as it has no CRC to keep consistent */
+    return;
+  }
+
+  bool changed = false;
+  if (std::chrono::steady_clock::now() < hung_until_) {
+    status.status = APP_STATUS_IDLE;
+    status.reply_len = 0;
+    status.flags |= STATUS_FLAG_WORKING;
+    changed = true;
+  } else if (error_code_ != APP_SUCCESS && (status.status & APP_STATUS_DONE)) {
+    status.status = APP_STATUS_DONE | APP_STATUS_CODE(error_code_);
+    status.reply_len = 0;
+    changed = true;
+  }
+  if (changed) {
+    status.crc = 0;
+    status.crc = crc16(&status, status.length);
+  }
+  if (Chance(faults_.status_crc)) {
+    ++injected_.status_crc;
+    status.crc ^= 1;
+    changed = true;
+  }
+  if (changed) {
+    memcpy(buf, &status, sizeof(status));
+  }
+
+  /* A reply sent inline can be corrupted like any other */
+  const uint32_t reply_at =
+      STATUS_MAX_LENGTH + ((status.flags & STATUS_FLAG_QUEUED)
+                               ? sizeof(transport_queue_status) : 0);
+  const uint32_t inline_len =
+      len > reply_at ? std::min<uint32_t>(len - reply_at, status.reply_len) : 0;
+  if ((status.flags & STATUS_FLAG_REPLY_INLINE) && inline_len != 0 &&
+      Chance(faults_.reply_crc)) {
+    ++injected_.reply_crc;
+    buf[reply_at + rng_() % inline_len] ^= 0x80;
+  }
+}
+
+int FaultyDevice::Read(uint32_t command, uint8_t* buf, uint32_t len) {
+  if (const int err = DatagramFault()) {
+    return err;
+  }
+  const int err = inner_.ops.read(inner_.ctx, command, buf, len);
+  if (err != 0 || !(command & CMD_TRANSPORT)) {
+    return err;
+  }
+
+  if (command & CMD_IS_DATA) {
+    if (len != 0 && Chance(faults_.reply_crc)) {
+      ++injected_.reply_crc;
+      buf[rng_() % len] ^= 0x80;
+    }
+  } else {
+    RewriteStatus(buf, len);
+  }
+  return 0;
+}
+
+int FaultyDevice::Write(uint32_t command, const uint8_t* buf, uint32_t len) {
+  if (const int err = DatagramFault()) {
+    return err;
+  }
+  const int err = inner_.ops.write(inner_.ctx, command, buf, len);
+  if (err != 0) {
+    return err;
+  }
+
+  if (!(command & CMD_TRANSPORT)) {
+    /* Decide how the command that has just started goes wrong */
+    error_code_ = APP_SUCCESS;
+    if (Chance(faults_.too_much)) {
+      ++injected_.too_much;
+      error_code_ = APP_ERROR_TOO_MUCH;
+    } else if (Chance(faults_.checksum)) {
+      ++injected_.checksum;
+      error_code_ = APP_ERROR_CHECKSUM;
+    }
+    if (Chance(faults_.hang)) {
+      ++injected_.hang;
+      hung_until_ = std::chrono::steady_clock::now() + faults_.hang_time;
+    }
+  } else if (!(command & CMD_IS_DATA)) {
+    /* Clearing the status ends the command */
+    error_code_ = APP_SUCCESS;
+  }
+  return 0;
+}
+
+int FaultyDevice::WaitForInterrupt(int msecs) {
+  return inner_.ops.wait_for_interrupt(inner_.ctx, msecs);
+}
+
+int FaultyDevice::Reset() {
+  error_code_ = APP_SUCCESS;
+  hung_until_ = std::chrono::steady_clock::time_point();
+  eagain_left_ = 0;
+  return inner_.ops.reset(inner_.ctx);
+}
+
+} // namespace test
+} // namespace nos
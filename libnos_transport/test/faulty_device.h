@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_TRANSPORT_TEST_FAULTY_DEVICE_H
+#define NOS_TRANSPORT_TEST_FAULTY_DEVICE_H
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+#include <nos/device.h>
+
+namespace nos {
+namespace test {
+
+/**
+ * Wraps a device, such as the simulator, to inject the faults that the
+ * transport's retry loops exist to handle.
+ *
+ * Each fault happens with a given probability drawn from a seeded generator so
+ * a run can be repeated exactly. Faults affecting a whole command are decided
+ * when its go command is sent. Like the device, this is not thread safe.
+ */
+class FaultyDevice {
+public:
+    struct Faults {
+        /* Chance a datagram starts a storm of -EAGAIN, and its length */
+        double eagain_storm = 0;
+        int eagain_storm_length = 20;
+        /* Chance a datagram fails with -EIO */
+        double io_error = 0;
+        /* Chance a status or reply datagram is corrupted */
+        double status_crc = 0;
+        double reply_crc = 0;
+        /* Chance a command reports one of these errors once it is done */
+        double too_much = 0;
+        double checksum = 0;
+        /* Chance an app keeps reporting that it is working, and for how long */
+        double hang = 0;
+        std::chrono::microseconds hang_time{20000};
+        /* Chance a datagram takes longer, and how much longer */
+        double slow = 0;
+        std::chrono::microseconds slow_time{500};
+    };
+
+    /**
+     * Number of each fault injected so far.
+     */
+    struct Injected {
+        uint64_t eagain = 0;
+        uint64_t io_error = 0;
+        uint64_t status_crc = 0;
+        uint64_t reply_crc = 0;
+        uint64_t too_much = 0;
+        uint64_t checksum = 0;
+        uint64_t hang = 0;
+        uint64_t slow = 0;
+
+        uint64_t Total() const;
+    };
+
+    FaultyDevice(const nos_device& inner, const Faults& faults, uint32_t seed);
+
+    FaultyDevice(const FaultyDevice&) = delete;
+    FaultyDevice& operator=(const FaultyDevice&) = delete;
+
+    /**
+     * Fill in a device that injects faults into the inner device.
+     */
+    void Open(nos_device* dev);
+
+    const Injected& Counts() const { return injected_; }
+
+    /* The nos_device_ops */
+    int Read(uint32_t command, uint8_t* buf, uint32_t len);
+    int Write(uint32_t command, const uint8_t* buf, uint32_t len);
+    int WaitForInterrupt(int msecs);
+    int Reset();
+
+private:
+    bool Chance(double probability);
+    /* Faults common to all datagrams, returning the error to fail with */
+    int DatagramFault();
+    void RewriteStatus(uint8_t* buf, uint32_t len);
+
+    const nos_device inner_;
+    const Faults faults_;
+    std::mt19937 rng_;
+    std::uniform_real_distribution<double> uniform_;
+    Injected injected_;
+
+    int eagain_left_;
+    /* Fault decided for the current command */
+    uint32_t error_code_;
+    std::chrono::steady_clock::time_point hung_until_;
+};
+
+} // namespace test
+} // namespace nos
+
+#endif // NOS_TRANSPORT_TEST_FAULTY_DEVICE_H
@@ -0,0 +1,407 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simulator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <app_nugget.h>
+#include <application.h>
+
+#include "crc16.h"
+
+namespace nos {
+namespace test {
+
+namespace {
+
+int SimRead(void* ctx, uint32_t command, uint8_t* buf, uint32_t len) {
+  return static_cast<Simulator*>(ctx)->Read(command, buf, len);
+}
+int SimWrite(void* ctx, uint32_t command, const uint8_t* buf, uint32_t len) {
+  return static_cast<Simulator*>(ctx)->Write(command, buf, len);
+}
+int SimWaitForInterrupt(void* ctx, int msecs) {
+  return static_cast<Simulator*>(ctx)->WaitForInterrupt(msecs);
+}
+int SimReset(void* ctx) {
+  return static_cast<Simulator*>(ctx)->Reset();
+}
+void SimClose(void*) {
+}
+
+}  // namespace
+
+Simulator::Simulator(Handler handler, std::chrono::microseconds transfer_time)
+    : handler_(std::move(handler)), transfer_time_(transfer_time),
+      reboot_time_(0), version_(TRANSPORT_V3), stopping_(false),
+      datagrams_(0), resets_(0), interrupt_(false), app_id_(0),
+      params_(0), reply_len_hint_(0), inline_(false), working_(false),
+      go_(false), status_(APP_STATUS_IDLE), reply_pos_(0), reply_crc_(0),
+      queue_head_(0), queued_(0) {
+  /* Nugget OS has a buffer for each queued request */
+  for (QueuedCommand& queued : queue_) {
+    queued.request.reserve(MAX_DEVICE_TRANSFER);
+  }
+  thread_ = std::thread(&Simulator::Work, this);
+}
+
+Simulator::~Simulator() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  thread_.join();
+}
+
+void Simulator::Open(nos_device* dev) {
+  dev->ctx = this;
+  dev->ops.read = SimRead;
+  dev->ops.write = SimWrite;
+  dev->ops.wait_for_interrupt = SimWaitForInterrupt;
+  dev->ops.reset = SimReset;
+  dev->ops.close = SimClose;
+}
+
+void Simulator::SetRebootTime(std::chrono::microseconds reboot_time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  reboot_time_ = reboot_time;
+}
+
+void Simulator::SetVersion(uint16_t version) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  version_ = version;
+}
+
+void Simulator::QueueEvent(const event_report& event) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  events_.push_back(event);
+  Interrupt();
+}
+
+uint64_t Simulator::Datagrams() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return datagrams_;
+}
+
+void Simulator::Transfer() {
+  /* The bus transfer keeps the master's CPU busy */
+  const auto until = std::chrono::steady_clock::now() + transfer_time_;
+  while (std::chrono::steady_clock::now() < until) {}
+}
+
+int Simulator::Read(uint32_t command, uint8_t* buf, uint32_t len) {
+  Transfer();
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++datagrams_;
+
+  if (std::chrono::steady_clock::now() < awake_at_) {
+    return -EAGAIN;
+  }
+
+  if (!(command & CMD_TRANSPORT)) {
+    return -1;
+  }
+
+  /* The oldest queued command is collected once it is done */
+  const QueuedCommand* completion =
+      queued_ && Queued(0)->state == QueuedCommand::DONE ? Queued(0) : nullptr;
+  const std::vector<uint8_t>& reply = completion ? completion->reply : reply_;
+  const uint32_t app_status = completion ? completion->status : status_;
+
+  if (command & CMD_IS_DATA) {
+    if (!(command & CMD_MORE_TO_COME)) {
+      reply_pos_ = 0;
+    }
+    const size_t avail = reply.size() - std::min(reply_pos_, reply.size());
+    const size_t copy = std::min<size_t>(len, avail);
+    memcpy(buf, reply.data() + reply_pos_, copy);
+    memset(buf + copy, 0, len - copy);
+    reply_pos_ += copy;
+    return 0;
+  }
+
+  transport_status status = {};
+  status.status = app_status;
+  status.reply_len = (app_status & APP_STATUS_DONE) ? reply.size() : 0;
+  status.length = sizeof(status);
+  status.version = version_;
+  bool working = working_;
+  for (size_t i = 0; i < queued_; ++i) {
+    working |= Queued(i)->state != QueuedCommand::DONE;
+  }
+  status.flags = working ? STATUS_FLAG_WORKING : 0;
+  if (!events_.empty()) {
+    status.flags |= STATUS_FLAG_EVENTS_PENDING;
+  }
+  /* A short reply to an inline command follows the status */
+  const bool reply_inline = (inline_ || completion) &&
+                            (app_status & APP_STATUS_DONE) &&
+                            reply.size() <= STATUS_INLINE_REPLY_MAX;
+  if (reply_inline) {
+    status.flags |= STATUS_FLAG_REPLY_INLINE;
+  }
+  size_t reply_at = STATUS_MAX_LENGTH;
+  transport_queue_status queue = {};
+  if (completion) {
+    /* Say which queued command it is, ahead of any inline reply */
+    status.flags |= STATUS_FLAG_QUEUED;
+    queue.seq = completion->seq;
+    queue.queued = queued_ - 1;
+    queue.crc = crc16(&queue, sizeof(queue));
+    reply_at += sizeof(queue);
+  }
+  status.reply_crc = completion ? crc16(reply.data(), reply.size())
+                                : reply_crc_;
+  status.crc = crc16(&status, sizeof(status));
+  memset(buf, 0, len);
+  memcpy(buf, &status, std::min<size_t>(len, sizeof(status)));
+  if (completion && len > STATUS_MAX_LENGTH) {
+    memcpy(buf + STATUS_MAX_LENGTH, &queue,
+           std::min<size_t>(len - STATUS_MAX_LENGTH, sizeof(queue)));
+  }
+  if (reply_inline && len > reply_at) {
+    memcpy(buf + reply_at, reply.data(),
+           std::min<size_t>(len - reply_at, reply.size()));
+  }
+  return 0;
+}
+
+int Simulator::Write(uint32_t command, const uint8_t* buf, uint32_t len) {
+  Transfer();
+  std::unique_lock<std::mutex> lock(mutex_);
+  ++datagrams_;
+
+  if (std::chrono::steady_clock::now() < awake_at_) {
+    return -EAGAIN;
+  }
+
+  if (command & CMD_TRANSPORT) {
+    if (command & CMD_IS_DATA) {
+      /* Request data for the next command */
+      if (!(command & CMD_MORE_TO_COME)) {
+        request_.clear();
+      }
+      request_.insert(request_.end(), buf, buf + len);
+    } else if (queued_ && Queued(0)->state == QueuedCommand::DONE) {
+      /* Collected the oldest queued command */
+      queue_head_ = (queue_head_ + 1) % (TRANSPORT_QUEUE_DEPTH + 1);
+      --queued_;
+    } else if (!working_) {
+      /* Clear the status ready for the next command */
+      status_ = APP_STATUS_IDLE;
+      reply_.clear();
+      reply_crc_ = 0;
+    }
+    return 0;
+  }
+
+  /* Go command, checking the command info as Nugget OS does */
+  transport_command_info info = {};
+  memcpy(&info, buf, std::min<size_t>(len, sizeof(info)));
+  const bool queued = version_ >= TRANSPORT_V3 &&
+                      info.version >= TRANSPORT_V3 && info.length <= len;
+  inline_ = version_ >= TRANSPORT_V2 && info.version >= TRANSPORT_V2 &&
+            info.length <= len;
+  transport_queued_args queued_args = {};
+  /* Queued commands keep their own request, if there's room for them */
+  if (queued && queued_ > TRANSPORT_QUEUE_DEPTH) {
+    /* The master has already been told it's busy */
+    return 0;
+  }
+  QueuedCommand* slot = queued ? Queued(queued_) : nullptr;
+  std::vector<uint8_t>& request = queued ? slot->request : request_;
+  if (inline_) {
+    /* The args came inline after the command info */
+    transport_inline_args inline_args = {};
+    size_t header = info.length + sizeof(inline_args);
+    memcpy(&inline_args, buf + info.length,
+           std::min<size_t>(len - info.length, sizeof(inline_args)));
+    if (queued) {
+      memcpy(&queued_args, buf + std::min<size_t>(len, header),
+             std::min<size_t>(len - std::min<size_t>(len, header),
+                              sizeof(queued_args)));
+      header += sizeof(queued_args);
+    }
+    request.assign(buf + std::min<size_t>(len, header),
+                   buf + std::min<size_t>(len, header + inline_args.arg_len));
+  }
+  const uint16_t their_crc = info.crc;
+  info.crc = 0;
+  const uint16_t arg_len = request.size();
+  uint16_t crc = crc16(&arg_len, sizeof(arg_len));
+  crc = crc16_update(request.data(), request.size(), crc);
+  crc = crc16_update(&command, sizeof(command), crc);
+  crc = crc16_update(&info, sizeof(info), crc);
+  if (queued) {
+    crc = crc16_update(&queued_args, sizeof(queued_args), crc);
+  }
+
+  if (queued) {
+    /* Queue it behind the others, or finish it straight away if it can't be */
+    slot->seq = queued_args.seq;
+    slot->app_id = (command >> 16) & 0xff;
+    slot->params = CMD_PARAM(command);
+    slot->reply_len_hint = info.reply_len_hint;
+    slot->reply.clear();
+    slot->state = QueuedCommand::DONE;
+    if (crc != their_crc) {
+      slot->status = APP_STATUS_DONE | APP_ERROR_CHECKSUM;
+    } else if (queued_ == TRANSPORT_QUEUE_DEPTH) {
+      slot->status = APP_STATUS_DONE | APP_ERROR_BUSY;
+    } else {
+      slot->state = QueuedCommand::QUEUED;
+    }
+    ++queued_;
+    lock.unlock();
+    work_cv_.notify_one();
+    return 0;
+  }
+
+  if (crc != their_crc) {
+    status_ = APP_STATUS_DONE | APP_ERROR_CHECKSUM;
+    return 0;
+  }
+
+  app_id_ = (command >> 16) & 0xff;
+  params_ = CMD_PARAM(command);
+  reply_len_hint_ = info.reply_len_hint;
+  working_ = true;
+  go_ = true;
+  lock.unlock();
+  work_cv_.notify_one();
+  return 0;
+}
+
+int Simulator::WaitForInterrupt(int msecs) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const auto raised = [this] { return interrupt_; };
+  if (msecs < 0) {
+    interrupt_cv_.wait(lock, raised);
+  } else if (!interrupt_cv_.wait_for(lock, std::chrono::milliseconds(msecs),
+                                     raised)) {
+    return 0;
+  }
+  interrupt_ = false;
+  return 1;
+}
+
+int Simulator::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  /* The result of any command in progress is discarded */
+  status_ = APP_STATUS_IDLE;
+  request_.clear();
+  reply_.clear();
+  reply_crc_ = 0;
+  working_ = false;
+  queue_head_ = 0;
+  queued_ = 0;
+  interrupt_ = false;
+  ++resets_;
+  awake_at_ = std::chrono::steady_clock::now() + reboot_time_;
+  return 0;
+}
+
+void Simulator::Work() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    work_cv_.wait(lock, [this] {
+      return go_ || NextQueued() || stopping_;
+    });
+    if (stopping_) {
+      return;
+    }
+
+    const uint64_t resets = resets_;
+    std::vector<uint8_t> reply;
+    if (!go_) {
+      /* Work through the queued commands in the order they came */
+      QueuedCommand* queued = NextQueued();
+      queued->state = QueuedCommand::WORKING;
+      const std::vector<uint8_t> request = queued->request;
+      const uint32_t code = Run(queued->app_id, queued->params, request,
+                                &reply, &lock);
+      if (resets != resets_) {
+        continue;
+      }
+      reply.resize(std::min<size_t>(reply.size(), queued->reply_len_hint));
+      queued->reply = std::move(reply);
+      queued->status = APP_STATUS_DONE | APP_STATUS_CODE(code);
+      queued->state = QueuedCommand::DONE;
+      Interrupt();
+      continue;
+    }
+    go_ = false;
+
+    const std::vector<uint8_t> request = request_;
+    const uint32_t code = Run(app_id_, params_, request, &reply, &lock);
+    if (resets != resets_) {
+      continue;
+    }
+
+    /* Nugget OS only keeps as much as the master said it would read */
+    reply.resize(std::min<size_t>(reply.size(), reply_len_hint_));
+    reply_ = std::move(reply);
+    reply_crc_ = crc16(reply_.data(), reply_.size());
+    status_ = APP_STATUS_DONE | APP_STATUS_CODE(code);
+    working_ = false;
+    Interrupt();
+  }
+}
+
+uint32_t Simulator::Run(uint8_t app_id, uint16_t params,
+                        const std::vector<uint8_t>& request,
+                        std::vector<uint8_t>* reply,
+                        std::unique_lock<std::mutex>* lock) {
+  if (app_id == APP_ID_NUGGET && params == NUGGET_PARAM_GET_EVENT_REPORT) {
+    /* Nugget OS hands out one event at a time, or nothing */
+    if (!events_.empty()) {
+      const event_report& event = events_.front();
+      const uint8_t* data = reinterpret_cast<const uint8_t*>(&event);
+      reply->assign(data, data + sizeof(event));
+      events_.pop_front();
+    }
+    return APP_SUCCESS;
+  }
+
+  lock->unlock();
+  const uint32_t code = handler_(app_id, params, request, reply);
+  lock->lock();
+  return code;
+}
+
+Simulator::QueuedCommand* Simulator::Queued(size_t i) {
+  return &queue_[(queue_head_ + i) % (TRANSPORT_QUEUE_DEPTH + 1)];
+}
+
+Simulator::QueuedCommand* Simulator::NextQueued() {
+  for (size_t i = 0; i < queued_; ++i) {
+    if (Queued(i)->state == QueuedCommand::QUEUED) {
+      return Queued(i);
+    }
+  }
+  return nullptr;
+}
+
+void Simulator::Interrupt() {
+  interrupt_ = true;
+  interrupt_cv_.notify_all();
+}
+
+} // namespace test
+} // namespace nos
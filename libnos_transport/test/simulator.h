@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOS_TRANSPORT_TEST_SIMULATOR_H
+#define NOS_TRANSPORT_TEST_SIMULATOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <application.h>
+#include <citadel_events.h>
+#include <nos/device.h>
+
+namespace nos {
+namespace test {
+
+/**
+ * Software model of the slave side of the transport protocol.
+ *
+ * Apps are modelled by a single handler which runs on the simulator's own
+ * thread, as the app would run on Nugget, and raises an interrupt when done.
+ * Each datagram costs a fixed amount of time on the calling thread to model
+ * the bus transfer.
+ *
+ * It speaks v3 of the protocol unless told otherwise, queueing commands sent
+ * with sequence numbers and working through them in order.
+ *
+ * Event reports can be queued as Citadel queues them. They are flagged in every
+ * status and fetched with NUGGET_PARAM_GET_EVENT_REPORT, which the simulator
+ * answers itself rather than passing to the handler.
+ */
+class Simulator {
+public:
+    /**
+     * Handles a command and returns the app's status code.
+     *
+     * The handler can sleep to model how long the app takes.
+     */
+    using Handler = std::function<uint32_t(uint8_t app_id, uint16_t params,
+                                           const std::vector<uint8_t>& request,
+                                           std::vector<uint8_t>* reply)>;
+
+    Simulator(Handler handler, std::chrono::microseconds transfer_time);
+    ~Simulator();
+
+    Simulator(const Simulator&) = delete;
+    Simulator& operator=(const Simulator&) = delete;
+
+    /**
+     * Fill in a device that talks to this simulator.
+     */
+    void Open(nos_device* dev);
+
+    /**
+     * How long the device is asleep after a reset, failing datagrams with
+     * -EAGAIN as the driver does while the chip reboots.
+     */
+    void SetRebootTime(std::chrono::microseconds reboot_time);
+
+    /**
+     * Which version of the transport protocol to speak, such as to model older
+     * firmware.
+     */
+    void SetVersion(uint16_t version);
+
+    /**
+     * Queue an event report for the master to fetch and raise an interrupt.
+     */
+    void QueueEvent(const event_report& event);
+
+    /**
+     * Number of datagrams exchanged so far.
+     */
+    uint64_t Datagrams() const;
+
+    /* The nos_device_ops, public so they can be wrapped */
+    int Read(uint32_t command, uint8_t* buf, uint32_t len);
+    int Write(uint32_t command, const uint8_t* buf, uint32_t len);
+    int WaitForInterrupt(int msecs);
+    int Reset();
+
+private:
+    /* A command queued by a v3 master, kept until the master collects it */
+    struct QueuedCommand {
+        enum { QUEUED, WORKING, DONE } state;
+        uint16_t seq;
+        uint8_t app_id;
+        uint16_t params;
+        uint16_t reply_len_hint;
+        std::vector<uint8_t> request;
+        uint32_t status;
+        std::vector<uint8_t> reply;
+    };
+
+    void Transfer();
+    void Work();
+    void Interrupt();
+    QueuedCommand* Queued(size_t i);
+    QueuedCommand* NextQueued();
+    uint32_t Run(uint8_t app_id, uint16_t params,
+                 const std::vector<uint8_t>& request,
+                 std::vector<uint8_t>* reply,
+                 std::unique_lock<std::mutex>* lock);
+
+    const Handler handler_;
+    const std::chrono::microseconds transfer_time_;
+    std::chrono::microseconds reboot_time_;
+    uint16_t version_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable interrupt_cv_;
+    bool stopping_;
+    uint64_t datagrams_;
+    uint64_t resets_;
+    std::chrono::steady_clock::time_point awake_at_;
+    bool interrupt_;
+    std::deque<event_report> events_;
+
+    /* Transport state of the app being called */
+    uint8_t app_id_;
+    uint16_t params_;
+    uint16_t reply_len_hint_;
+    /* The command came inline so the reply can go inline too */
+    bool inline_;
+    bool working_;
+    bool go_;
+    uint32_t status_;
+    std::vector<uint8_t> request_;
+    std::vector<uint8_t> reply_;
+    size_t reply_pos_;
+    uint16_t reply_crc_;
+
+    /* Queued commands, oldest first from queue_head_. There is room for one
+     * more than the depth to finish a command with APP_ERROR_BUSY. */
+    QueuedCommand queue_[TRANSPORT_QUEUE_DEPTH + 1];
+    size_t queue_head_;
+    size_t queued_;
+
+    std::thread thread_;
+};
+
+} // namespace test
+} // namespace nos
+
+#endif // NOS_TRANSPORT_TEST_SIMULATOR_H
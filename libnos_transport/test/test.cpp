@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <chrono>
 #include <vector>
 
 #include <gmock/gmock.h>
@@ -27,9 +28,11 @@ using ::testing::_;
 using ::testing::Args;
 using ::testing::DoAll;
 using ::testing::Eq;
+using ::testing::Gt;
 using ::testing::ElementsAreArray;
 using ::testing::InSequence;
 using ::testing::IsNull;
+using ::testing::Ne;
 using ::testing::Return;
 using ::testing::SetArrayArgument;
 using ::testing::StrictMock;
@@ -137,6 +140,19 @@ ACTION(ReadStatusV1_Idle) {
   status->reply_crc = 0;
 }
 
+ACTION(ReadStatusV2_Idle) {
+  transport_status* status = (transport_status*)arg1;
+  memset(status, READ_UNSET, sizeof(*status));
+  status->status = APP_STATUS_IDLE;
+  status->reply_len = 0;
+  status->length = sizeof(transport_status);
+  status->version = TRANSPORT_V2;
+  status->flags = 0;
+  status->reply_crc = 0;
+  status->crc = 0;
+  status->crc = crc16(status, status->length);
+}
+
 ACTION(ReadStatusV1_IdleWithBadCrc) {
   transport_status* status = (transport_status*)arg1;
   memset(status, READ_UNSET, sizeof(*status));
@@ -181,6 +197,83 @@ ACTION_P2(ReadStatusV1_DoneWithData, reply, reply_len) {
   status->crc = crc16(status, status->length);
 }
 
+ACTION(ReadStatusV1_DoneWithEvents) {
+  transport_status* status = (transport_status*)arg1;
+  memset(status, READ_UNSET, sizeof(*status));
+  status->status = APP_STATUS_DONE | APP_SUCCESS;
+  status->reply_len = 0;
+  status->length = sizeof(transport_status);
+  status->version = TRANSPORT_V1;
+  status->flags = STATUS_FLAG_EVENTS_PENDING;
+  status->reply_crc = 0;
+  status->crc = 0;
+  status->crc = crc16(status, status->length);
+}
+
+ACTION_P3(ReadStatusV2_DoneWithInlineReply, reply, reply_len, corrupt) {
+  transport_status* status = (transport_status*)arg1;
+  memset(arg1, READ_UNSET, STATUS_MAX_LENGTH + STATUS_INLINE_REPLY_MAX);
+  status->status = APP_STATUS_DONE | APP_SUCCESS;
+  status->reply_len = reply_len;
+  status->length = sizeof(transport_status);
+  status->version = TRANSPORT_V2;
+  status->flags = STATUS_FLAG_REPLY_INLINE;
+  status->reply_crc = crc16(reply, reply_len);
+  status->crc = 0;
+  status->crc = crc16(status, status->length);
+  memcpy(arg1 + STATUS_MAX_LENGTH, reply, reply_len);
+  if (corrupt) {
+    arg1[STATUS_MAX_LENGTH] ^= 0x80;
+  }
+}
+
+ACTION(ReadStatusV3_Idle) {
+  transport_status* status = (transport_status*)arg1;
+  memset(status, READ_UNSET, sizeof(*status));
+  status->status = APP_STATUS_IDLE;
+  status->reply_len = 0;
+  status->length = sizeof(transport_status);
+  status->version = TRANSPORT_V3;
+  status->flags = 0;
+  status->reply_crc = 0;
+  status->crc = 0;
+  status->crc = crc16(status, status->length);
+}
+
+ACTION_P4(ReadStatusV3_Queued, code, seq, reply, reply_len) {
+  transport_status* status = (transport_status*)arg1;
+  memset(arg1, READ_UNSET, STATUS_MAX_LENGTH + sizeof(transport_queue_status));
+  status->status = APP_STATUS_DONE | code;
+  status->reply_len = reply_len;
+  status->length = sizeof(transport_status);
+  status->version = TRANSPORT_V3;
+  status->flags = STATUS_FLAG_QUEUED | (reply_len ? STATUS_FLAG_REPLY_INLINE : 0);
+  status->reply_crc = crc16(reply, reply_len);
+  status->crc = 0;
+  status->crc = crc16(status, status->length);
+  transport_queue_status queue = {};
+  queue.seq = seq;
+  queue.crc = crc16(&queue, sizeof(queue));
+  memcpy(arg1 + STATUS_MAX_LENGTH, &queue, sizeof(queue));
+  if (reply_len) {
+    const uint8_t* data = reply;
+    memcpy(arg1 + STATUS_MAX_LENGTH + sizeof(queue), data, reply_len);
+  }
+}
+
+ACTION(ReadStatusV3_Working) {
+  transport_status* status = (transport_status*)arg1;
+  memset(arg1, READ_UNSET, STATUS_MAX_LENGTH + sizeof(transport_queue_status));
+  status->status = APP_STATUS_IDLE;
+  status->reply_len = 0;
+  status->length = sizeof(transport_status);
+  status->version = TRANSPORT_V3;
+  status->flags = STATUS_FLAG_WORKING;
+  status->reply_crc = 0;
+  status->crc = 0;
+  status->crc = crc16(status, status->length);
+}
+
 ACTION(ReadStatusV1_BadCrc) {
   transport_status* status = (transport_status*)arg1;
   memset(status, READ_UNSET, sizeof(*status));
@@ -224,6 +317,12 @@ ACTION_P3(ReadData, len, data, size) {
       .WillOnce(DoAll(ReadStatusV1_Idle(), Return(0))); \
 } while (0)
 
+#define EXPECT_GET_STATUS_V2_IDLE(app_id) do { \
+  const uint32_t command = CMD_ID((app_id)) | CMD_IS_READ | CMD_TRANSPORT; \
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH)) \
+      .WillOnce(DoAll(ReadStatusV2_Idle(), Return(0))); \
+} while (0)
+
 #define EXPECT_GET_STATUS_IDLE_WITH_BAD_CRC(app_id) do { \
   const uint32_t command = CMD_ID((app_id)) | CMD_IS_READ | CMD_TRANSPORT; \
   EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH)) \
@@ -291,6 +390,48 @@ ACTION_P3(ReadData, len, data, size) {
       .WillOnce(Return(0)); \
 } while (0)
 
+#define EXPECT_INLINE_GO_COMMAND(app_id, param, args, args_len, reply_len) do { \
+  const uint32_t command = CMD_ID((app_id)) | CMD_PARAM((param)); \
+  transport_command_info command_info = {}; \
+  command_info.length = sizeof(command_info); \
+  command_info.version = htole16(TRANSPORT_V2); \
+  command_info.reply_len_hint = htole16((reply_len)); \
+  command_info.crc = command_crc(command, (args), (args_len), &command_info); \
+  const transport_inline_args inline_args = {htole16((args_len))}; \
+  std::vector<uint8_t> go((uint8_t*)&command_info, (uint8_t*)(&command_info + 1)); \
+  go.insert(go.end(), (uint8_t*)&inline_args, (uint8_t*)(&inline_args + 1)); \
+  go.insert(go.end(), (const uint8_t*)(args), (const uint8_t*)(args) + (args_len)); \
+  EXPECT_CALL(mock_dev(), Write(command, _, go.size())) \
+      .With(Args<1,2>(ElementsAreArray(go))) \
+      .WillOnce(Return(0)); \
+} while (0)
+
+#define EXPECT_QUEUED_GO_COMMAND(app_id, param, seq, args, args_len, reply_len) do { \
+  const uint32_t command = CMD_ID((app_id)) | CMD_PARAM((param)); \
+  transport_command_info command_info = {}; \
+  command_info.length = sizeof(command_info); \
+  command_info.version = htole16(TRANSPORT_V3); \
+  command_info.reply_len_hint = htole16((reply_len)); \
+  const transport_queued_args queued_args = {htole16((seq))}; \
+  uint16_t crc = le16toh(command_crc(command, (args), (args_len), &command_info)); \
+  command_info.crc = htole16(crc16_update(&queued_args, sizeof(queued_args), crc)); \
+  const transport_inline_args inline_args = {htole16((args_len))}; \
+  std::vector<uint8_t> go((uint8_t*)&command_info, (uint8_t*)(&command_info + 1)); \
+  go.insert(go.end(), (uint8_t*)&inline_args, (uint8_t*)(&inline_args + 1)); \
+  go.insert(go.end(), (uint8_t*)&queued_args, (uint8_t*)(&queued_args + 1)); \
+  go.insert(go.end(), (const uint8_t*)(args), (const uint8_t*)(args) + (args_len)); \
+  EXPECT_CALL(mock_dev(), Write(command, _, go.size())) \
+      .With(Args<1,2>(ElementsAreArray(go))) \
+      .WillOnce(Return(0)); \
+} while (0)
+
+#define EXPECT_GET_QUEUE_STATUS(app_id, code, seq, reply, reply_len, inline_len) do { \
+  const uint32_t command = CMD_ID((app_id)) | CMD_IS_READ | CMD_TRANSPORT; \
+  EXPECT_CALL(mock_dev(), Read(command, _, \
+                               STATUS_MAX_LENGTH + sizeof(transport_queue_status) + (inline_len))) \
+      .WillOnce(DoAll(ReadStatusV3_Queued((code), (seq), (reply), (reply_len)), Return(0))); \
+} while (0)
+
 #define EXPECT_RECV_DATA(app_id, len, reply, reply_len) do { \
   const uint32_t command = CMD_ID((app_id)) | CMD_IS_READ | CMD_IS_DATA | CMD_TRANSPORT; \
   EXPECT_CALL(mock_dev(), Read(command, _, (reply_len))) \
@@ -472,6 +613,74 @@ TEST_F(TransportTest, SuccessAfterRequestCrcError) {
   EXPECT_THAT(res, Eq(APP_SUCCESS));
 }
 
+// Produces a request in two pieces as a serializer would
+int ProduceInTwo(void* arg, int (*emit)(void*, const uint8_t*, uint32_t),
+                 void* emit_arg) {
+  const auto* args = reinterpret_cast<const std::vector<uint8_t>*>(arg);
+  if (emit(emit_arg, args->data(), MAX_DEVICE_TRANSFER) != 0) {
+    return -1;
+  }
+  return emit(emit_arg, args->data() + MAX_DEVICE_TRANSFER,
+              args->size() - MAX_DEVICE_TRANSFER);
+}
+
+TEST_F(TransportTest, SuccessWithStreamedRequest) {
+  const uint8_t app_id = 12;
+  const uint16_t param = 2;
+  std::vector<uint8_t> args(MAX_DEVICE_TRANSFER + 10, 0x3c);
+  const nos_request_source source = {
+    .produce = ProduceInTwo,
+    .arg = &args,
+  };
+  const nos_call_options opts = {
+    .request_source = &source,
+  };
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_DATA | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Write(command | CMD_PARAM(MAX_DEVICE_TRANSFER), _,
+                                MAX_DEVICE_TRANSFER))
+      .WillOnce(Return(0));
+  EXPECT_CALL(mock_dev(), Write(command | CMD_MORE_TO_COME | CMD_PARAM(10), _, 10))
+      .WillOnce(Return(0));
+  EXPECT_GO_COMMAND(app_id, param, args.data(), args.size(), 0);
+  EXPECT_GET_STATUS_DONE(app_id);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr,
+                                           args.size(), nullptr, nullptr, &opts);
+  EXPECT_THAT(res, Eq(APP_SUCCESS));
+}
+
+TEST_F(TransportTest, ShortStreamedRequestIsNotSent) {
+  const uint8_t app_id = 12;
+  const uint16_t param = 2;
+  std::vector<uint8_t> args(MAX_DEVICE_TRANSFER + 10, 0x3c);
+  const nos_request_source source = {
+    .produce = ProduceInTwo,
+    .arg = &args,
+  };
+  const nos_call_options opts = {
+    .request_source = &source,
+  };
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_DATA | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Write(command | CMD_PARAM(MAX_DEVICE_TRANSFER), _,
+                                MAX_DEVICE_TRANSFER))
+      .WillOnce(Return(0));
+  EXPECT_CALL(mock_dev(), Write(command | CMD_MORE_TO_COME | CMD_PARAM(10), _, 10))
+      .WillOnce(Return(0));
+
+  // Claim the request is longer than what is produced
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr,
+                                           args.size() + 1, nullptr, nullptr,
+                                           &opts);
+  EXPECT_THAT(res, Eq(APP_ERROR_IO));
+}
+
 TEST_F(TransportTest, SuccessWithoutReply) {
   const uint8_t app_id = 12;
   const uint16_t param = 2;
@@ -555,6 +764,49 @@ TEST_F(TransportTest, SuccessWithReplyInMultipleDatagrams) {
   EXPECT_THAT(reply, ElementsAreArray(data));
 }
 
+uint8_t* NextChunk(void* arg, uint32_t len) {
+  auto* chunks = reinterpret_cast<std::vector<std::vector<uint8_t>>*>(arg);
+  chunks->emplace_back(len);
+  return chunks->back().data();
+}
+
+void RestartChunks(void* arg) {
+  reinterpret_cast<std::vector<std::vector<uint8_t>>*>(arg)->clear();
+}
+
+TEST_F(TransportTest, SuccessWithReplyInChunks) {
+  const uint8_t app_id = 165;
+  const uint16_t param = 16;
+  std::vector<uint8_t> data(MAX_DEVICE_TRANSFER + 24, 0xea);
+  std::vector<std::vector<uint8_t>> chunks;
+  const nos_reply_chunks sink = {
+    .next = NextChunk,
+    .restart = RestartChunks,
+    .arg = &chunks,
+  };
+  const nos_call_options opts = {
+    .reply_chunks = &sink,
+  };
+  uint32_t reply_len = data.size();
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, reply_len);
+  EXPECT_GET_STATUS_DONE_WITH_DATA(app_id, data.data(), data.size());
+  EXPECT_RECV_DATA(app_id, MAX_DEVICE_TRANSFER, data.data(), MAX_DEVICE_TRANSFER);
+  EXPECT_RECV_MORE_DATA(app_id, 24, data.data() + MAX_DEVICE_TRANSFER, 24);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           nullptr, &reply_len, &opts);
+  EXPECT_THAT(res, Eq(APP_SUCCESS));
+  EXPECT_THAT(reply_len, Eq(MAX_DEVICE_TRANSFER + 24));
+  ASSERT_THAT(chunks.size(), Eq(2));
+  EXPECT_THAT(chunks[0], ElementsAreArray(data.data(), MAX_DEVICE_TRANSFER));
+  EXPECT_THAT(chunks[1], ElementsAreArray(data.data() + MAX_DEVICE_TRANSFER, 24));
+}
+
 TEST_F(TransportTest, ReplyCrcError) {
   const uint8_t app_id = 5;
   const uint16_t param = 0;
@@ -604,6 +856,78 @@ TEST_F(TransportTest, SuccessAfterReplyCrcError) {
   EXPECT_THAT(reply, ElementsAreArray(data, sizeof(data)));
 }
 
+TEST_F(TransportTest, V2SendsSmallRequestAndReplyInline) {
+  const uint8_t app_id = 7;
+  const uint16_t param = 33;
+  const uint8_t args[] = {1, 2, 3};
+  const uint8_t data[] = {9, 8};
+  uint8_t reply[4];
+  uint32_t reply_len = 4;
+
+  InSequence please;
+  EXPECT_GET_STATUS_V2_IDLE(app_id);
+  EXPECT_INLINE_GO_COMMAND(app_id, param, args, sizeof(args), reply_len);
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_READ | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH + reply_len))
+      .WillOnce(DoAll(ReadStatusV2_DoneWithInlineReply(data, sizeof(data), false),
+                      Return(0)));
+  EXPECT_CLEAR_STATUS(app_id);
+
+  uint32_t res = nos_call_application(dev(), app_id, param, args, sizeof(args),
+                                      reply, &reply_len);
+  EXPECT_THAT(res, Eq(APP_SUCCESS));
+  EXPECT_THAT(reply_len, Eq(sizeof(data)));
+  EXPECT_THAT(std::vector<uint8_t>(reply, reply + reply_len),
+              ElementsAreArray(data, sizeof(data)));
+}
+
+TEST_F(TransportTest, V2ReadsReplyAfterInlineReplyCrcError) {
+  const uint8_t app_id = 7;
+  const uint16_t param = 35;
+  const uint8_t data[] = {4, 5, 6};
+  uint8_t reply[64];
+  uint32_t reply_len = sizeof(reply);
+
+  InSequence please;
+  EXPECT_GET_STATUS_V2_IDLE(app_id);
+  EXPECT_INLINE_GO_COMMAND(app_id, param, nullptr, 0, reply_len);
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_READ | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH + STATUS_INLINE_REPLY_MAX))
+      .WillOnce(DoAll(ReadStatusV2_DoneWithInlineReply(data, sizeof(data), true),
+                      Return(0)));
+  EXPECT_RECV_DATA(app_id, sizeof(data), data, sizeof(data));
+  EXPECT_CLEAR_STATUS(app_id);
+
+  uint32_t res = nos_call_application(dev(), app_id, param, nullptr, 0,
+                                      reply, &reply_len);
+  EXPECT_THAT(res, Eq(APP_SUCCESS));
+  EXPECT_THAT(reply_len, Eq(sizeof(data)));
+  EXPECT_THAT(std::vector<uint8_t>(reply, reply + reply_len),
+              ElementsAreArray(data, sizeof(data)));
+}
+
+TEST_F(TransportTest, V2SendsLargeRequestInDatagrams) {
+  const uint8_t app_id = 7;
+  const uint16_t param = 34;
+  std::vector<uint8_t> args(MAX_DEVICE_TRANSFER + 10, 0x5a);
+
+  InSequence please;
+  EXPECT_GET_STATUS_V2_IDLE(app_id);
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_DATA | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Write(command | CMD_PARAM(MAX_DEVICE_TRANSFER), _,
+                                MAX_DEVICE_TRANSFER))
+      .WillOnce(Return(0));
+  EXPECT_CALL(mock_dev(), Write(command | CMD_MORE_TO_COME | CMD_PARAM(10), _, 10))
+      .WillOnce(Return(0));
+  EXPECT_GO_COMMAND(app_id, param, args.data(), args.size(), 0);
+  EXPECT_GET_STATUS_DONE(app_id);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  uint32_t res = nos_call_application(dev(), app_id, param, args.data(),
+                                      args.size(), nullptr, nullptr);
+  EXPECT_THAT(res, Eq(APP_SUCCESS));
+}
+
 TEST_F(TransportTest, V0SuccessWithoutReply) {
   const uint8_t app_id = 6;
   const uint16_t param = 92;
@@ -640,6 +964,296 @@ TEST_F(TransportTest, V0SuccessWithReply) {
   EXPECT_THAT(reply, ElementsAreArray(data, sizeof(data)));
 }
 
+/* Cancellation tests */
+
+// Cancels the call once it has been checked the given number of times
+int CancelAfterChecks(const void* arg) {
+  int* checks_left = const_cast<int*>(reinterpret_cast<const int*>(arg));
+  return (*checks_left)-- <= 0;
+}
+
+TEST_F(TransportTest, CancelWhilePolling) {
+  const uint8_t app_id = 42;
+  const uint16_t param = 7;
+  int checks_left = 1;
+  const nos_call_options opts = {
+    .is_cancelled = CancelAfterChecks,
+    .cancel_arg = &checks_left,
+  };
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, 0);
+  EXPECT_GET_STATUS_WORKING(app_id);
+  EXPECT_GET_STATUS_WORKING(app_id);
+  // Abandon the command and check the app has stopped
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_GET_STATUS_IDLE(app_id);
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           nullptr, nullptr, &opts);
+  EXPECT_THAT(res, Eq(NOS_ERROR_CANCELLED));
+}
+
+TEST_F(TransportTest, CancelLeavesStillWorkingApp) {
+  const uint8_t app_id = 42;
+  const uint16_t param = 7;
+  int checks_left = 0;
+  const nos_call_options opts = {
+    .is_cancelled = CancelAfterChecks,
+    .cancel_arg = &checks_left,
+  };
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, 0);
+  EXPECT_GET_STATUS_WORKING(app_id);
+  // Clearing won't stop the app but it is left to finish
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_GET_STATUS_WORKING(app_id);
+  EXPECT_CALL(mock_dev(), Reset()).Times(0);
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           nullptr, nullptr, &opts);
+  EXPECT_THAT(res, Eq(NOS_ERROR_CANCELLED));
+}
+
+TEST_F(TransportTest, CompletedCallIsNotCancelled) {
+  const uint8_t app_id = 42;
+  const uint16_t param = 7;
+  int checks_left = 0;
+  const nos_call_options opts = {
+    .is_cancelled = CancelAfterChecks,
+    .cancel_arg = &checks_left,
+  };
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, 0);
+  EXPECT_GET_STATUS_DONE(app_id);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           nullptr, nullptr, &opts);
+  EXPECT_THAT(res, Eq(APP_SUCCESS));
+}
+
+TEST_F(TransportTest, CallerTimeoutLeavesWorkingApp) {
+  const uint8_t app_id = 42;
+  const uint16_t param = 7;
+  const nos_call_options opts = {
+    .timeout_ms = 20,
+  };
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, 0);
+  // Keep saying we're working on it
+  const uint32_t command = CMD_ID((app_id)) | CMD_IS_READ | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH))
+      .WillRepeatedly(DoAll(ReadStatusV1_Working(), Return(0)));
+  // Abandon the command without resetting the device under other clients
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_GET_STATUS_WORKING(app_id);
+  EXPECT_CALL(mock_dev(), Reset()).Times(0);
+
+  const auto start = std::chrono::steady_clock::now();
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           nullptr, nullptr, &opts);
+  EXPECT_THAT(res, Eq(APP_ERROR_TIMEOUT));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
+TEST_F(TransportTest, SpinThenBlockWaitsForInterrupt) {
+  const uint8_t app_id = 42;
+  const uint16_t param = 7;
+  const nos_call_options opts = {
+    .completion = NOS_COMPLETION_SPIN_THEN_BLOCK,
+    .spin_us = 0,
+  };
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, 0);
+  EXPECT_GET_STATUS_WORKING(app_id);
+  EXPECT_CALL(mock_dev(), WaitForInterrupt(Gt(0))).WillOnce(Return(1));
+  EXPECT_GET_STATUS_DONE(app_id);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           nullptr, nullptr, &opts);
+  EXPECT_THAT(res, Eq(APP_SUCCESS));
+}
+
+TEST_F(TransportTest, SpinThenBlockFallsBackToPolling) {
+  const uint8_t app_id = 42;
+  const uint16_t param = 7;
+  const nos_call_options opts = {
+    .completion = NOS_COMPLETION_SPIN_THEN_BLOCK,
+    .spin_us = 0,
+  };
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, 0);
+  EXPECT_GET_STATUS_WORKING(app_id);
+  EXPECT_CALL(mock_dev(), WaitForInterrupt(_)).WillOnce(Return(-1));
+  // No more waiting once the interrupt has failed
+  EXPECT_GET_STATUS_WORKING(app_id);
+  EXPECT_GET_STATUS_DONE(app_id);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           nullptr, nullptr, &opts);
+  EXPECT_THAT(res, Eq(APP_SUCCESS));
+}
+
+void CountDumps(const nos_flight_recorder*, void* arg) {
+  ++*static_cast<int*>(arg);
+}
+
+TEST_F(TransportTest, FlightRecorderRecordsTransaction) {
+  const uint8_t app_id = 165;
+  const uint16_t param = 16;
+  const uint8_t data[] = {5, 6, 7, 8};
+  uint8_t reply[4];
+  uint32_t reply_len = 4;
+  int dumps = 0;
+  nos_flight_recorder recorder = {};
+  recorder.dump = CountDumps;
+  recorder.dump_arg = &dumps;
+  const nos_call_options opts = {
+    .recorder = &recorder,
+  };
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, reply_len);
+  EXPECT_GET_STATUS_DONE_WITH_DATA(app_id, data, sizeof(data));
+  EXPECT_RECV_DATA(app_id, reply_len, data, sizeof(data));
+  EXPECT_CLEAR_STATUS(app_id);
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           reply, &reply_len, &opts);
+  EXPECT_THAT(res, Eq(APP_SUCCESS));
+  EXPECT_THAT(dumps, Eq(0));
+  ASSERT_THAT(recorder.count, Eq(1u));
+
+  const nos_flight_record& record = recorder.records[0];
+  EXPECT_THAT(record.app_id, Eq(app_id));
+  EXPECT_THAT(record.params, Eq(param));
+  EXPECT_THAT(record.result, Eq(APP_SUCCESS));
+  EXPECT_THAT(record.reply_len, Eq(4u));
+  EXPECT_THAT(record.datagrams, Eq(6u));
+  EXPECT_THAT(record.retries, Eq(0));
+  EXPECT_THAT(record.polls, Eq(1));
+  EXPECT_THAT(record.phase, Eq(NOS_PHASE_CLEAR));
+  for (int i = 0; i < NOS_PHASE_COUNT; ++i) {
+    EXPECT_THAT(record.phase_us[i], Ne(NOS_PHASE_NOT_REACHED));
+  }
+  EXPECT_THAT(record.phase_status[NOS_PHASE_READY], Eq(APP_STATUS_IDLE));
+  EXPECT_THAT(record.phase_status[NOS_PHASE_POLL] & APP_STATUS_DONE, Ne(0u));
+}
+
+TEST_F(TransportTest, FlightRecorderDumpedOnError) {
+  const uint8_t app_id = 53;
+  const uint16_t param = 192;
+  int dumps = 0;
+  nos_flight_recorder recorder = {};
+  recorder.count = NOS_FLIGHT_RECORDER_ENTRIES + 1;
+  recorder.dump = CountDumps;
+  recorder.dump_arg = &dumps;
+  const nos_call_options opts = {
+    .recorder = &recorder,
+  };
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE_WITH_BAD_CRC(app_id);
+  EXPECT_GET_STATUS_IDLE_WITH_BAD_CRC(app_id);
+  EXPECT_GET_STATUS_IDLE_WITH_BAD_CRC(app_id);
+  EXPECT_GET_STATUS_IDLE_WITH_BAD_CRC(app_id);
+  EXPECT_GET_STATUS_IDLE_WITH_BAD_CRC(app_id);
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           nullptr, nullptr, &opts);
+  EXPECT_THAT(res, Eq(APP_ERROR_IO));
+  EXPECT_THAT(dumps, Eq(1));
+
+  // The oldest record was replaced
+  const nos_flight_record& record = recorder.records[1];
+  EXPECT_THAT(record.app_id, Eq(app_id));
+  EXPECT_THAT(record.result, Eq(APP_ERROR_IO));
+  EXPECT_THAT(record.retries, Eq(5));
+  EXPECT_THAT(record.phase, Eq(NOS_PHASE_READY));
+  EXPECT_THAT(record.phase_us[NOS_PHASE_SEND], Eq(NOS_PHASE_NOT_REACHED));
+
+  // Logging the dump must cope with the unused records
+  nos_flight_recorder_log(&recorder);
+}
+
+TEST_F(TransportTest, FlightRecorderCountsCompletedDatagrams) {
+  const uint8_t app_id = 165;
+  const uint16_t param = 16;
+  nos_flight_recorder recorder = {};
+  const nos_call_options opts = {
+    .recorder = &recorder,
+  };
+
+  InSequence please;
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_READ | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH))
+      .WillOnce(Return(-EAGAIN));
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, 0);
+  EXPECT_GET_STATUS_DONE(app_id);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           nullptr, nullptr, &opts);
+  EXPECT_THAT(res, Eq(APP_SUCCESS));
+  ASSERT_THAT(recorder.count, Eq(1u));
+  // The read the sleeping chip refused is a retry but didn't reach it
+  EXPECT_THAT(recorder.records[0].datagrams, Eq(5u));
+  EXPECT_THAT(recorder.records[0].retries, Eq(1));
+}
+
+void CopyWhileDumping(const nos_flight_recorder* dumped, void* arg) {
+  // The recorder is unlocked so it can be copied, or called through
+  nos_flight_recorder copy;
+  nos_flight_recorder_copy(static_cast<nos_flight_recorder*>(arg), &copy);
+  EXPECT_THAT(copy.count, Eq(dumped->count));
+  EXPECT_THAT(dumped->records[0].result, Eq(APP_ERROR_IO));
+}
+
+TEST_F(TransportTest, FlightRecorderDumpsUnlockedCopy) {
+  const uint8_t app_id = 53;
+  const uint16_t param = 192;
+  nos_flight_recorder recorder = {};
+  recorder.dump = CopyWhileDumping;
+  recorder.dump_arg = &recorder;
+  const nos_call_options opts = {
+    .recorder = &recorder,
+  };
+
+  InSequence please;
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_GET_STATUS_IDLE_WITH_BAD_CRC(app_id);
+  }
+
+  uint32_t res = nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                           nullptr, nullptr, &opts);
+  EXPECT_THAT(res, Eq(APP_ERROR_IO));
+  EXPECT_THAT(recorder.count, Eq(1u));
+}
+
 TEST_F(TransportTest, ErrorIfArgsLenButNotArgs) {
   uint8_t reply[] = {1, 2, 3};
   uint32_t reply_len = 0;
@@ -647,6 +1261,334 @@ TEST_F(TransportTest, ErrorIfArgsLenButNotArgs) {
   EXPECT_THAT(status, Eq(APP_ERROR_IO));
 }
 
+TEST_F(TransportTest, BatchChecksReadinessOncePerApp) {
+  const uint8_t app_a = 12;
+  const uint8_t app_b = 13;
+  const uint8_t args[] = {1, 2, 3};
+  const uint8_t data[] = {5, 6, 7, 8};
+  uint8_t reply[4];
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_a);
+  EXPECT_SEND_DATA(app_a, args, sizeof(args));
+  EXPECT_GO_COMMAND(app_a, 1, args, sizeof(args), 0);
+  EXPECT_GET_STATUS_DONE(app_a);
+  EXPECT_CLEAR_STATUS(app_a);
+  // Still idle from the clear so straight on to the next command
+  EXPECT_SEND_DATA(app_a, nullptr, 0);
+  EXPECT_GO_COMMAND(app_a, 2, nullptr, 0, sizeof(reply));
+  EXPECT_GET_STATUS_DONE_WITH_DATA(app_a, data, sizeof(data));
+  EXPECT_RECV_DATA(app_a, sizeof(reply), data, sizeof(data));
+  EXPECT_CLEAR_STATUS(app_a);
+  // A different app needs checking
+  EXPECT_GET_STATUS_IDLE(app_b);
+  EXPECT_SEND_DATA(app_b, nullptr, 0);
+  EXPECT_GO_COMMAND(app_b, 3, nullptr, 0, 0);
+  EXPECT_GET_STATUS_DONE(app_b);
+  EXPECT_CLEAR_STATUS(app_b);
+
+  nos_batch_call calls[3] = {};
+  calls[0].app_id = app_a;
+  calls[0].params = 1;
+  calls[0].args = args;
+  calls[0].arg_len = sizeof(args);
+  calls[1].app_id = app_a;
+  calls[1].params = 2;
+  calls[1].reply = reply;
+  calls[1].reply_len = sizeof(reply);
+  calls[2].app_id = app_b;
+  calls[2].params = 3;
+
+  nos_flight_recorder recorder = {};
+  nos_call_options options = {};
+  options.recorder = &recorder;
+  EXPECT_THAT(nos_call_application_batch(dev(), calls, 3, &options, nullptr, nullptr),
+              Eq(3u));
+  for (const nos_batch_call& call : calls) {
+    EXPECT_THAT(call.result, Eq(APP_SUCCESS));
+  }
+  EXPECT_THAT(calls[1].reply_len, Eq(sizeof(data)));
+  EXPECT_THAT(reply, ElementsAreArray(data, sizeof(data)));
+  EXPECT_THAT(recorder.count, Eq(3u));
+}
+
+TEST_F(TransportTest, BatchStopsAtTransportError) {
+  const uint8_t app_id = 213;
+  EXPECT_GET_STATUS_WORKING(app_id);
+
+  nos_batch_call calls[2] = {};
+  calls[0].app_id = app_id;
+  calls[1].app_id = app_id;
+  calls[1].result = APP_ERROR_INTERNAL;
+  EXPECT_THAT(nos_call_application_batch(dev(), calls, 2, nullptr, nullptr, nullptr),
+              Eq(1u));
+  EXPECT_THAT(calls[0].result, Eq(APP_ERROR_BUSY));
+  EXPECT_THAT(calls[1].result, Eq(APP_ERROR_INTERNAL));
+}
+
+int StopAfterFirst(void* arg, uint32_t index) {
+  static_cast<std::vector<uint32_t>*>(arg)->push_back(index);
+  return 1;
+}
+
+TEST_F(TransportTest, BatchStoppedByCaller) {
+  const uint8_t app_id = 12;
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, 0, nullptr, 0, 0);
+  EXPECT_GET_STATUS_DONE(app_id);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  nos_batch_call calls[2] = {};
+  calls[0].app_id = app_id;
+  calls[1].app_id = app_id;
+  std::vector<uint32_t> done;
+  EXPECT_THAT(nos_call_application_batch(dev(), calls, 2, nullptr, StopAfterFirst, &done),
+              Eq(1u));
+  EXPECT_THAT(done, Eq(std::vector<uint32_t>{0}));
+}
+
+int RecordDone(void* arg, uint32_t index) {
+  static_cast<std::vector<uint32_t>*>(arg)->push_back(index);
+  return 0;
+}
+
+TEST_F(TransportTest, V3QueuesCallsToSameApp) {
+  const uint8_t app_id = 14;
+  const uint8_t args_a[] = {1, 2};
+  const uint8_t args_b[] = {3};
+  const uint8_t data_a[] = {7, 7, 7};
+  const uint8_t data_b[] = {8};
+  uint8_t reply_a[4];
+  uint8_t reply_b[4];
+
+  InSequence please;
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_READ | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH))
+      .WillOnce(DoAll(ReadStatusV3_Idle(), Return(0)));
+  // Both are queued before the first reply is read
+  EXPECT_QUEUED_GO_COMMAND(app_id, 5, 0, args_a, sizeof(args_a), sizeof(reply_a));
+  EXPECT_QUEUED_GO_COMMAND(app_id, 6, 1, args_b, sizeof(args_b), sizeof(reply_b));
+  EXPECT_GET_QUEUE_STATUS(app_id, APP_SUCCESS, 0, data_a, sizeof(data_a), sizeof(reply_a));
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_GET_QUEUE_STATUS(app_id, APP_SUCCESS, 1, data_b, sizeof(data_b), sizeof(reply_b));
+  EXPECT_CLEAR_STATUS(app_id);
+
+  nos_batch_call calls[2] = {};
+  calls[0].app_id = app_id;
+  calls[0].params = 5;
+  calls[0].args = args_a;
+  calls[0].arg_len = sizeof(args_a);
+  calls[0].reply = reply_a;
+  calls[0].reply_len = sizeof(reply_a);
+  calls[1].app_id = app_id;
+  calls[1].params = 6;
+  calls[1].args = args_b;
+  calls[1].arg_len = sizeof(args_b);
+  calls[1].reply = reply_b;
+  calls[1].reply_len = sizeof(reply_b);
+  std::vector<uint32_t> done;
+  EXPECT_THAT(nos_call_application_pipelined(dev(), calls, 2, nullptr, RecordDone, &done),
+              Eq(2u));
+  EXPECT_THAT(done, Eq(std::vector<uint32_t>{0, 1}));
+  EXPECT_THAT(calls[0].result, Eq(APP_SUCCESS));
+  EXPECT_THAT(calls[1].result, Eq(APP_SUCCESS));
+  EXPECT_THAT(std::vector<uint8_t>(reply_a, reply_a + calls[0].reply_len),
+              ElementsAreArray(data_a, sizeof(data_a)));
+  EXPECT_THAT(std::vector<uint8_t>(reply_b, reply_b + calls[1].reply_len),
+              ElementsAreArray(data_b, sizeof(data_b)));
+}
+
+TEST_F(TransportTest, V3RequeuesCallAfterChecksumError) {
+  const uint8_t app_id = 14;
+
+  InSequence please;
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_READ | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH))
+      .WillOnce(DoAll(ReadStatusV3_Idle(), Return(0)));
+  EXPECT_QUEUED_GO_COMMAND(app_id, 1, 0, nullptr, 0, 0);
+  EXPECT_QUEUED_GO_COMMAND(app_id, 2, 1, nullptr, 0, 0);
+  EXPECT_GET_QUEUE_STATUS(app_id, APP_ERROR_CHECKSUM, 0, nullptr, 0, 0);
+  EXPECT_CLEAR_STATUS(app_id);
+  // Sent again behind the second
+  EXPECT_QUEUED_GO_COMMAND(app_id, 1, 0, nullptr, 0, 0);
+  EXPECT_GET_QUEUE_STATUS(app_id, APP_SUCCESS, 1, nullptr, 0, 0);
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_GET_QUEUE_STATUS(app_id, APP_SUCCESS, 0, nullptr, 0, 0);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  nos_batch_call calls[2] = {};
+  calls[0].app_id = app_id;
+  calls[0].params = 1;
+  calls[1].app_id = app_id;
+  calls[1].params = 2;
+  std::vector<uint32_t> done;
+  EXPECT_THAT(nos_call_application_pipelined(dev(), calls, 2, nullptr, RecordDone, &done),
+              Eq(2u));
+  EXPECT_THAT(done, Eq(std::vector<uint32_t>{1, 0}));
+  EXPECT_THAT(calls[0].result, Eq(APP_SUCCESS));
+  EXPECT_THAT(calls[1].result, Eq(APP_SUCCESS));
+}
+
+TEST_F(TransportTest, V3RequeuesCallAfterBusy) {
+  const uint8_t app_id = 14;
+
+  InSequence please;
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_READ | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH))
+      .WillOnce(DoAll(ReadStatusV3_Idle(), Return(0)));
+  EXPECT_QUEUED_GO_COMMAND(app_id, 1, 0, nullptr, 0, 0);
+  EXPECT_QUEUED_GO_COMMAND(app_id, 2, 1, nullptr, 0, 0);
+  EXPECT_GET_QUEUE_STATUS(app_id, APP_ERROR_BUSY, 0, nullptr, 0, 0);
+  EXPECT_CLEAR_STATUS(app_id);
+  // Sent again behind the second rather than failing the batch
+  EXPECT_QUEUED_GO_COMMAND(app_id, 1, 0, nullptr, 0, 0);
+  EXPECT_GET_QUEUE_STATUS(app_id, APP_SUCCESS, 1, nullptr, 0, 0);
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_GET_QUEUE_STATUS(app_id, APP_SUCCESS, 0, nullptr, 0, 0);
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_CALL(mock_dev(), Reset()).Times(0);
+
+  nos_batch_call calls[2] = {};
+  calls[0].app_id = app_id;
+  calls[0].params = 1;
+  calls[1].app_id = app_id;
+  calls[1].params = 2;
+  std::vector<uint32_t> done;
+  EXPECT_THAT(nos_call_application_pipelined(dev(), calls, 2, nullptr, RecordDone, &done),
+              Eq(2u));
+  EXPECT_THAT(done, Eq(std::vector<uint32_t>{1, 0}));
+  EXPECT_THAT(calls[0].result, Eq(APP_SUCCESS));
+  EXPECT_THAT(calls[1].result, Eq(APP_SUCCESS));
+}
+
+TEST_F(TransportTest, V3CancelDrainsQueueWithoutReset) {
+  const uint8_t app_id = 14;
+  // Checked before probing and before queueing each call
+  int checks_left = 3;
+  const nos_call_options opts = {
+    .is_cancelled = CancelAfterChecks,
+    .cancel_arg = &checks_left,
+  };
+
+  InSequence please;
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_READ | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH))
+      .WillOnce(DoAll(ReadStatusV3_Idle(), Return(0)));
+  EXPECT_QUEUED_GO_COMMAND(app_id, 1, 0, nullptr, 0, 0);
+  EXPECT_QUEUED_GO_COMMAND(app_id, 2, 1, nullptr, 0, 0);
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH + sizeof(transport_queue_status)))
+      .WillOnce(DoAll(ReadStatusV3_Working(), Return(0)));
+  // The cancelled call and the one behind it are left to finish
+  EXPECT_GET_QUEUE_STATUS(app_id, APP_SUCCESS, 0, nullptr, 0, 0);
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_GET_QUEUE_STATUS(app_id, APP_SUCCESS, 1, nullptr, 0, 0);
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_CALL(mock_dev(), Reset()).Times(0);
+
+  nos_batch_call calls[2] = {};
+  calls[0].app_id = app_id;
+  calls[0].params = 1;
+  calls[1].app_id = app_id;
+  calls[1].params = 2;
+  std::vector<uint32_t> done;
+  EXPECT_THAT(nos_call_application_pipelined(dev(), calls, 2, &opts, RecordDone, &done),
+              Eq(1u));
+  EXPECT_THAT(done, Eq(std::vector<uint32_t>{0}));
+  EXPECT_THAT(calls[0].result, Eq(NOS_ERROR_CANCELLED));
+  EXPECT_THAT(calls[1].result, Eq(APP_SUCCESS));
+}
+
+TEST_F(TransportTest, V2AppIsCalledAsBatch) {
+  const uint8_t app_id = 14;
+
+  InSequence please;
+  EXPECT_GET_STATUS_V2_IDLE(app_id);
+  // Still ready from checking for the pipeline
+  EXPECT_INLINE_GO_COMMAND(app_id, 1, nullptr, 0, 0);
+  EXPECT_GET_STATUS_DONE(app_id);
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_INLINE_GO_COMMAND(app_id, 2, nullptr, 0, 0);
+  EXPECT_GET_STATUS_DONE(app_id);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  nos_batch_call calls[2] = {};
+  calls[0].app_id = app_id;
+  calls[0].params = 1;
+  calls[1].app_id = app_id;
+  calls[1].params = 2;
+  EXPECT_THAT(nos_call_application_pipelined(dev(), calls, 2, nullptr, nullptr, nullptr),
+              Eq(2u));
+  EXPECT_THAT(calls[0].result, Eq(APP_SUCCESS));
+  EXPECT_THAT(calls[1].result, Eq(APP_SUCCESS));
+}
+
+TEST_F(TransportTest, WaitUntilReadyProbesAfterInterrupt) {
+  const uint32_t command = CMD_ID(APP_ID_NUGGET) | CMD_IS_READ | CMD_TRANSPORT;
+
+  InSequence please;
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH)).WillOnce(Return(-EAGAIN));
+  EXPECT_CALL(mock_dev(), WaitForInterrupt(Gt(0))).WillOnce(Return(0));
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH)).WillOnce(Return(-EAGAIN));
+  EXPECT_CALL(mock_dev(), WaitForInterrupt(Gt(0))).WillOnce(Return(1));
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH)).WillOnce(Return(0));
+
+  EXPECT_THAT(nos_wait_until_ready(dev(), 1000), Eq(0));
+}
+
+TEST_F(TransportTest, WaitUntilReadyTimesOut) {
+  const uint32_t command = CMD_ID(APP_ID_NUGGET) | CMD_IS_READ | CMD_TRANSPORT;
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH))
+      .WillRepeatedly(Return(-EAGAIN));
+  // Sleeps between probes once waiting for the interrupt fails
+  EXPECT_CALL(mock_dev(), WaitForInterrupt(_)).WillOnce(Return(-1));
+
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_THAT(nos_wait_until_ready(dev(), 20), Eq(-ETIMEDOUT));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+}
+
+TEST_F(TransportTest, WaitUntilReadyPassesOnErrors) {
+  EXPECT_CALL(mock_dev(), Read(_, _, _)).WillOnce(Return(-EIO));
+  EXPECT_THAT(nos_wait_until_ready(dev(), 0), Eq(-EIO));
+}
+
+TEST_F(TransportTest, EventsPendingFromLastStatus) {
+  const uint8_t app_id = 52;
+  const uint16_t param = 9;
+  const uint32_t command = CMD_ID(app_id) | CMD_IS_READ | CMD_TRANSPORT;
+
+  InSequence please;
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, 0);
+  EXPECT_CALL(mock_dev(), Read(command, _, STATUS_MAX_LENGTH))
+      .WillOnce(DoAll(ReadStatusV1_DoneWithEvents(), Return(0)));
+  EXPECT_CLEAR_STATUS(app_id);
+  EXPECT_GET_STATUS_IDLE(app_id);
+  EXPECT_SEND_DATA(app_id, nullptr, 0);
+  EXPECT_GO_COMMAND(app_id, param, nullptr, 0, 0);
+  EXPECT_GET_STATUS_DONE(app_id);
+  EXPECT_CLEAR_STATUS(app_id);
+
+  int events_pending = 0;
+  const nos_call_options opts = {
+    .events_pending = &events_pending,
+  };
+  EXPECT_THAT(nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                        nullptr, nullptr, &opts),
+              Eq(APP_SUCCESS));
+  EXPECT_THAT(events_pending, Eq(1));
+
+  /* Cleared once the device stops flagging them */
+  EXPECT_THAT(nos_call_application_opts(dev(), app_id, param, nullptr, 0,
+                                        nullptr, nullptr, &opts),
+              Eq(APP_SUCCESS));
+  EXPECT_THAT(events_pending, Eq(0));
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
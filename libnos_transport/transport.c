@@ -17,10 +17,12 @@
 #include <nos/transport.h>
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -73,35 +75,116 @@ extern int usleep (uint32_t usec);
 #define RETRY_COUNT 240
 #define RETRY_WAIT_TIME_US 5000
 
+/*
+ * When waiting for the device to be ready after a reset, probe quickly at
+ * first then back off to the retry interval.
+ */
+#define READY_PROBE_MIN_US 250
+#define READY_PROBE_MAX_US RETRY_WAIT_TIME_US
+
 /* In case of CRC error, try to retransmit */
 #define CRC_RETRY_COUNT 5
 
 /* How long to poll before giving up */
 #define POLL_LIMIT_SECONDS 60
 
+/*
+ * Longest to block waiting for an interrupt before polling again. This bounds
+ * the cost of a missed interrupt and how long cancellation takes to notice.
+ */
+#define INTERRUPT_WAIT_MS 10
+
+/* Most args that fit in the go datagram along with the command info */
+#define INLINE_ARGS_MAX (MAX_DEVICE_TRANSFER - \
+                         sizeof(struct transport_command_info) - \
+                         sizeof(struct transport_inline_args))
+#define QUEUED_ARGS_MAX (INLINE_ARGS_MAX - sizeof(struct transport_queued_args))
+
 struct transport_context {
   const struct nos_device *dev;
+  const struct nos_call_options *opts;
   uint8_t app_id;
   uint16_t params;
   const uint8_t *args;
   uint32_t arg_len;
   uint8_t *reply;
   uint32_t *reply_len;
+  struct nos_flight_record *record;
+  /* The previous call of a batch left the app idle so it needn't be checked */
+  bool ready;
+  /* Transport version of the app, if ready */
+  uint16_t version;
 };
 
+/*
+ * Check whether the caller has asked for the call to be abandoned.
+ */
+static bool is_cancelled(const struct transport_context *ctx) {
+  return ctx->opts && ctx->opts->is_cancelled &&
+         ctx->opts->is_cancelled(ctx->opts->cancel_arg);
+}
+
+/*
+ * The chunk sink for the reply, if the caller doesn't want it in a flat buffer.
+ */
+static const struct nos_reply_chunks *reply_chunks(
+    const struct transport_context *ctx) {
+  return ctx->opts ? ctx->opts->reply_chunks : NULL;
+}
+
+static uint64_t monotonic_ns(void) {
+  struct timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+    return 0;
+  }
+  return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/*
+ * Note the start of a phase of the transaction in the flight record.
+ */
+static void record_phase(const struct transport_context *ctx,
+                         enum nos_flight_phase phase) {
+  struct nos_flight_record *record = ctx->record;
+  if (record) {
+    record->phase = phase;
+    record->phase_us[phase] = (monotonic_ns() - record->start_ns) / 1000;
+  }
+}
+
+/*
+ * Note a datagram in the flight record, counting it only if the device
+ * completed it and as a retry if it was asleep.
+ */
+static void record_datagram(const struct transport_context *ctx, int err) {
+  if (ctx->record) {
+    ctx->record->datagrams += err == 0;
+    ctx->record->retries += err == -EAGAIN;
+  }
+}
+
+static void record_retry(const struct transport_context *ctx) {
+  if (ctx->record) {
+    ctx->record->retries++;
+  }
+}
+
 /*
  * Read a datagram from the device, correctly handling retries.
  */
-static int nos_device_read(const struct nos_device *dev, uint32_t command,
-                           void *buf, uint32_t len) {
+static int nos_device_read(const struct transport_context *ctx,
+                           uint32_t command, void *buf, uint32_t len) {
+  const struct nos_device *dev = ctx->dev;
   int retries = RETRY_COUNT;
   while (retries--) {
     int err = dev->ops.read(dev->ctx, command, buf, len);
+    record_datagram(ctx, err);
 
     if (err == -EAGAIN) {
       /* Linux driver returns EAGAIN error if Citadel chip is asleep.
        * Give to the chip a little bit of time to awake and retry reading
        * status again. */
+      if (is_cancelled(ctx)) return ECANCELED;
       usleep(RETRY_WAIT_TIME_US);
       continue;
     }
@@ -118,16 +201,19 @@ static int nos_device_read(const struct nos_device *dev, uint32_t command,
 /*
  * Write a datagram to the device, correctly handling retries.
  */
-static int nos_device_write(const struct nos_device *dev, uint32_t command,
-                            const void *buf, uint32_t len) {
+static int nos_device_write(const struct transport_context *ctx,
+                            uint32_t command, const void *buf, uint32_t len) {
+  const struct nos_device *dev = ctx->dev;
   int retries = RETRY_COUNT;
   while (retries--) {
     int err = dev->ops.write(dev->ctx, command, buf, len);
+    record_datagram(ctx, err);
 
     if (err == -EAGAIN) {
       /* Linux driver returns EAGAIN error if Citadel chip is asleep.
        * Give to the chip a little bit of time to awake and retry reading
        * status again. */
+      if (is_cancelled(ctx)) return ECANCELED;
       usleep(RETRY_WAIT_TIME_US);
       continue;
     }
@@ -146,23 +232,36 @@ static int nos_device_write(const struct nos_device *dev, uint32_t command,
  * slave are set to 0 so the caller must check the version before interpretting
  * them.
  *
+ * If queue is not NULL, room is left for the queue status of a queued command,
+ * which is filled in if the slave sent it. If inline_len is not 0, room is left
+ * for that much of a reply sent inline, which is copied to inline_reply if the
+ * slave sent it.
+ *
  * Returns non-zero on error.
  */
-static int get_status(const struct transport_context *ctx,
-                      struct transport_status *out) {
+static int read_status(const struct transport_context *ctx,
+                       struct transport_status *out,
+                       struct transport_queue_status *queue,
+                       uint8_t *inline_reply, uint32_t inline_len) {
   union {
     struct transport_status status;
-    uint8_t data[STATUS_MAX_LENGTH];
+    uint8_t data[STATUS_MAX_LENGTH + sizeof(struct transport_queue_status) +
+                 STATUS_INLINE_REPLY_MAX];
   } st;
+  const uint32_t queue_len = queue ? sizeof(*queue) : 0;
   int retries = CRC_RETRY_COUNT;
 
   /* All unset fields will be 0. */
   memset(out, 0, sizeof(*out));
+  if (queue) {
+    memset(queue, 0, sizeof(*queue));
+  }
 
   while (retries--) {
     /* Get the status from the device */
     const uint32_t command = CMD_ID(ctx->app_id) | CMD_IS_READ | CMD_TRANSPORT;
-    if (nos_device_read(ctx->dev, command, &st, STATUS_MAX_LENGTH) != 0) {
+    if (nos_device_read(ctx, command, &st,
+                        STATUS_MAX_LENGTH + queue_len + inline_len) != 0) {
       NLOGE("Failed to read app %d status", ctx->app_id);
       return -1;
     }
@@ -170,6 +269,9 @@ static int get_status(const struct transport_context *ctx,
     /* Examine v0 fields */
     out->status = le32toh(st.status.status);
     out->reply_len = le16toh(st.status.reply_len);
+    if (ctx->record) {
+      ctx->record->phase_status[ctx->record->phase] = out->status;
+    }
 
     /* Identify v0 as length will be an invalid value */
     const uint16_t length = le16toh(st.status.length);
@@ -193,9 +295,41 @@ static int get_status(const struct transport_context *ctx,
     if (out->crc != our_crc) {
       NLOGW("App %d status CRC mismatch: theirs=%04x ours=%04x",
             ctx->app_id, out->crc, our_crc);
+      record_retry(ctx);
       continue;
     }
 
+    /* Pass on whether there are events to fetch */
+    if (ctx->opts && ctx->opts->events_pending) {
+      *ctx->opts->events_pending =
+          (out->flags & STATUS_FLAG_EVENTS_PENDING) != 0;
+    }
+
+    /* Find out which queued command the status is for */
+    if (queue && out->version >= TRANSPORT_V3
+        && (out->flags & STATUS_FLAG_QUEUED)) {
+      memcpy(queue, st.data + STATUS_MAX_LENGTH, sizeof(*queue));
+      const uint16_t their_crc = le16toh(queue->crc);
+      queue->crc = 0;
+      const uint16_t queue_crc = crc16(queue, sizeof(*queue));
+      if (their_crc != queue_crc) {
+        NLOGW("App %d queue status CRC mismatch: theirs=%04x ours=%04x",
+              ctx->app_id, their_crc, queue_crc);
+        record_retry(ctx);
+        continue;
+      }
+      queue->seq = le16toh(queue->seq);
+      queue->queued = le16toh(queue->queued);
+      queue->crc = their_crc;
+    }
+
+    /* Take the reply if it came with the status, checking it later */
+    if (inline_len && out->version >= TRANSPORT_V2
+        && (out->flags & STATUS_FLAG_REPLY_INLINE)) {
+      memcpy(inline_reply, st.data + STATUS_MAX_LENGTH + queue_len,
+             MIN(out->reply_len, inline_len));
+    }
+
     /* Identify and examine v2+ fields here */
 
     return 0;
@@ -205,12 +339,17 @@ static int get_status(const struct transport_context *ctx,
   return -1;
 }
 
+static int get_status(const struct transport_context *ctx,
+                      struct transport_status *out) {
+  return read_status(ctx, out, NULL, NULL, 0);
+}
+
 /*
  * Try and reset the protocol state on Citadel for a new transaction.
  */
 static int clear_status(const struct transport_context *ctx) {
   const uint32_t command = CMD_ID(ctx->app_id) | CMD_TRANSPORT;
-  if (nos_device_write(ctx->dev, command, NULL, 0) != 0) {
+  if (nos_device_write(ctx, command, NULL, 0) != 0) {
     NLOGE("Failed to clear app %d status", ctx->app_id);
     return -1;
   }
@@ -218,9 +357,11 @@ static int clear_status(const struct transport_context *ctx) {
 }
 
 /*
- * Ensure that the app is in an idle state ready to handle the transaction.
+ * Ensure that the app is in an idle state ready to handle the transaction,
+ * finding out which version of the protocol it speaks.
  */
-static uint32_t make_ready(const struct transport_context *ctx) {
+static uint32_t make_ready(const struct transport_context *ctx,
+                           uint16_t *version) {
   struct transport_status status;
 
   if (get_status(ctx, &status) != 0) {
@@ -239,6 +380,7 @@ static uint32_t make_ready(const struct transport_context *ctx) {
       NLOGE("App %d is still working", ctx->app_id);
       return APP_ERROR_BUSY;
     }
+    *version = status.version;
     return APP_SUCCESS;
   }
 
@@ -263,45 +405,210 @@ static uint32_t make_ready(const struct transport_context *ctx) {
     return APP_ERROR_IO;
   }
 
+  *version = status.version;
   return APP_SUCCESS;
 }
 
 /*
- * Split request into datagrams and send command to have app process it.
+ * State for sending the request as it is produced.
  */
-static uint32_t send_command(const struct transport_context *ctx) {
-  const uint8_t *args = ctx->args;
-  uint16_t arg_len = ctx->arg_len;
+struct request_writer {
+  const struct transport_context *ctx;
+  uint32_t command;
+  uint32_t left;
+  uint32_t datagrams;
   uint16_t crc;
+};
+
+/*
+ * Send the next datagram of the request, extending the CRC as we go so the
+ * request doesn't need to be held in one piece.
+ */
+static int write_request_datagram(void *arg, const uint8_t *data, uint32_t len) {
+  struct request_writer *writer = arg;
+  const struct transport_context *ctx = writer->ctx;
+
+  /*
+   * We can't send more per datagram than the device can accept. For Citadel
+   * using the TPM Wait protocol on SPS, this is a constant. For other buses
+   * it may not be, but this is what we support here. Due to peculiarities of
+   * Citadel's SPS hardware, our protocol requires that we specify the length
+   * of what we're about to send in the params field of each Write.
+   */
+  if (len > MAX_DEVICE_TRANSFER || len > writer->left) {
+    NLOGE("Bad datagram of %d bytes for app %d with %d bytes left",
+          len, ctx->app_id, writer->left);
+    return -1;
+  }
+  CMD_SET_PARAM(writer->command, len);
+
+  NLOGV("Write app %d command 0x%08x, bytes %d", ctx->app_id, writer->command, len);
+  if (nos_device_write(ctx, writer->command, data, len) != 0) {
+    NLOGE("Failed to send datagram to app %d", ctx->app_id);
+    return -1;
+  }
+
+  /* Any further Writes needed to send all the args must set the MORE bit */
+  writer->command |= CMD_MORE_TO_COME;
+  writer->crc = crc16_update(data, len, writer->crc);
+  writer->left -= len;
+  writer->datagrams++;
+  return 0;
+}
+
+/*
+ * Whether the request can be sent inline with the command, which also lets
+ * the app send a short reply inline with its status.
+ */
+static bool sends_inline(const struct transport_context *ctx, uint16_t version) {
+  return version >= TRANSPORT_V2 && ctx->arg_len <= INLINE_ARGS_MAX;
+}
+
+/*
+ * State for gathering a request into the datagram of an inline command.
+ */
+struct inline_writer {
+  uint8_t *next;
+  uint32_t left;
+};
+
+static int gather_request_datagram(void *arg, const uint8_t *data, uint32_t len) {
+  struct inline_writer *writer = arg;
+  if (len > writer->left) {
+    return -1;
+  }
+  memcpy(writer->next, data, len);
+  writer->next += len;
+  writer->left -= len;
+  return 0;
+}
+
+/*
+ * Send the request in the same datagram as the command, as a v2 app allows.
+ * If seq is not NULL, the command is queued behind any others the app has, as
+ * a v3 app allows.
+ */
+static uint32_t send_inline_command(const struct transport_context *ctx,
+                                    const uint16_t *seq) {
+  const struct nos_request_source *source =
+      ctx->opts ? ctx->opts->request_source : NULL;
+  const uint16_t arg_len = ctx->arg_len;
+  const uint32_t command = CMD_ID(ctx->app_id) | CMD_PARAM(ctx->params);
+  const struct transport_inline_args inline_args = {
+    .arg_len = htole16(arg_len),
+  };
+  const struct transport_queued_args queued_args = {
+    .seq = seq ? htole16(*seq) : 0,
+  };
+  uint8_t go[MAX_DEVICE_TRANSFER];
+  uint32_t header = sizeof(struct transport_command_info) + sizeof(inline_args);
+  if (seq) {
+    header += sizeof(queued_args);
+  }
+  uint8_t *const args = go + header;
+
+  if (source) {
+    struct inline_writer writer = {
+      .next = args,
+      .left = arg_len,
+    };
+    if (source->produce(source->arg, gather_request_datagram, &writer) != 0) {
+      NLOGE("Failed to produce request for app %d", ctx->app_id);
+      return APP_ERROR_IO;
+    }
+    if (writer.left) {
+      NLOGE("Request for app %d is %d bytes short", ctx->app_id, writer.left);
+      return APP_ERROR_IO;
+    }
+  } else if (arg_len) {
+    memcpy(args, ctx->args, arg_len);
+  }
+
+  /* The crc covers the same as for v1, which now includes the args */
+  struct transport_command_info command_info = {
+    .length = sizeof(command_info),
+    .version = htole16(seq ? TRANSPORT_V3 : TRANSPORT_V2),
+    .crc = 0,
+    .reply_len_hint = ctx->reply_len ? htole16(*ctx->reply_len) : 0,
+  };
+  uint16_t crc = crc16(&arg_len, sizeof(arg_len));
+  crc = crc16_update(args, arg_len, crc);
+  crc = crc16_update(&command, sizeof(command), crc);
+  crc = crc16_update(&command_info, sizeof(command_info), crc);
+  if (seq) {
+    crc = crc16_update(&queued_args, sizeof(queued_args), crc);
+  }
+  command_info.crc = htole16(crc);
+  memcpy(go, &command_info, sizeof(command_info));
+  memcpy(go + sizeof(command_info), &inline_args, sizeof(inline_args));
+  if (seq) {
+    memcpy(go + sizeof(command_info) + sizeof(inline_args), &queued_args,
+           sizeof(queued_args));
+  }
+
+  NLOGD("Send app %d go command 0x%08x with %d bytes inline",
+        ctx->app_id, command, arg_len);
+  if (0 != nos_device_write(ctx, command, go, header + arg_len)) {
+    NLOGE("Failed to send command datagram to app %d", ctx->app_id);
+    return APP_ERROR_IO;
+  }
+
+  return APP_SUCCESS;
+}
+
+/*
+ * Split request into datagrams and send command to have app process it.
+ */
+static uint32_t send_command(const struct transport_context *ctx,
+                             uint16_t version) {
+  const struct nos_request_source *source =
+      ctx->opts ? ctx->opts->request_source : NULL;
+  const uint16_t arg_len = ctx->arg_len;
+
+  /* Small requests go in one datagram if the app understands it */
+  if (sends_inline(ctx, version)) {
+    return send_inline_command(ctx, NULL);
+  }
+
+  struct request_writer writer = {
+    .ctx = ctx,
+    .command = CMD_ID(ctx->app_id) | CMD_IS_DATA | CMD_TRANSPORT,
+    .left = arg_len,
+    .datagrams = 0,
+    .crc = crc16(&arg_len, sizeof(arg_len)),
+  };
 
   NLOGD("Send app %d command data (%d bytes)", ctx->app_id, arg_len);
-  uint32_t command = CMD_ID(ctx->app_id) | CMD_IS_DATA | CMD_TRANSPORT;
-  /* This always sends at least 1 packet to support the v0 protocol */
-  do {
-    /*
-     * We can't send more per datagram than the device can accept. For Citadel
-     * using the TPM Wait protocol on SPS, this is a constant. For other buses
-     * it may not be, but this is what we support here. Due to peculiarities of
-     * Citadel's SPS hardware, our protocol requires that we specify the length
-     * of what we're about to send in the params field of each Write.
-     */
-    const uint16_t ulen = MIN(arg_len, MAX_DEVICE_TRANSFER);
-    CMD_SET_PARAM(command, ulen);
-
-    NLOGV("Write app %d command 0x%08x, bytes %d", ctx->app_id, command, ulen);
-    if (nos_device_write(ctx->dev, command, args, ulen) != 0) {
-      NLOGE("Failed to send datagram to app %d", ctx->app_id);
+  if (source) {
+    /* Each datagram is sent as soon as it has been produced */
+    if (source->produce(source->arg, write_request_datagram, &writer) != 0) {
+      NLOGE("Failed to produce request for app %d", ctx->app_id);
       return APP_ERROR_IO;
     }
+  } else {
+    const uint8_t *args = ctx->args;
+    while (writer.left) {
+      const uint16_t ulen = MIN(writer.left, MAX_DEVICE_TRANSFER);
+      if (write_request_datagram(&writer, args, ulen) != 0) {
+        return APP_ERROR_IO;
+      }
+      args += ulen;
+    }
+  }
 
-    /* Any further Writes needed to send all the args must set the MORE bit */
-    command |= CMD_MORE_TO_COME;
-    if (args) args += ulen;
-    arg_len -= ulen;
-  } while (arg_len);
+  if (writer.left) {
+    NLOGE("Request for app %d is %d bytes short", ctx->app_id, writer.left);
+    return APP_ERROR_IO;
+  }
+
+  /* This always sends at least 1 packet to support the v0 protocol */
+  if (writer.datagrams == 0
+      && write_request_datagram(&writer, ctx->args, 0) != 0) {
+    return APP_ERROR_IO;
+  }
 
   /* Finally, send the "go" command */
-  command = CMD_ID(ctx->app_id) | CMD_PARAM(ctx->params);
+  const uint32_t command = CMD_ID(ctx->app_id) | CMD_PARAM(ctx->params);
 
   /*
    * The outgoing crc covers:
@@ -317,9 +624,7 @@ static uint32_t send_command(const struct transport_context *ctx) {
     .crc = 0,
     .reply_len_hint = ctx->reply_len ? htole16(*ctx->reply_len) : 0,
   };
-  arg_len = ctx->arg_len;
-  crc = crc16(&arg_len, sizeof(arg_len));
-  crc = crc16_update(ctx->args, ctx->arg_len, crc);
+  uint16_t crc = writer.crc;
   crc = crc16_update(&command, sizeof(command), crc);
   crc = crc16_update(&command_info, sizeof(command_info), crc);
   command_info.crc = htole16(crc);
@@ -327,7 +632,7 @@ static uint32_t send_command(const struct transport_context *ctx) {
   /* Tell the app to handle the request while also sending the command_info
    * which will be ignored by the v0 protocol. */
   NLOGD("Send app %d go command 0x%08x", ctx->app_id, command);
-  if (0 != nos_device_write(ctx->dev, command, &command_info, sizeof(command_info))) {
+  if (0 != nos_device_write(ctx, command, &command_info, sizeof(command_info))) {
     NLOGE("Failed to send command datagram to app %d", ctx->app_id);
     return APP_ERROR_IO;
   }
@@ -344,29 +649,50 @@ static bool timespec_before(const struct timespec *lhs, const struct timespec *r
 }
 
 /*
- * Keep polling until the app says it is done.
+ * Keep polling until the app says it is done, with room in each status for the
+ * queue status if given and as much of the reply as the app could send inline.
  */
 static uint32_t poll_until_done(const struct transport_context *ctx,
-                                struct transport_status *status) {
+                                struct transport_status *status,
+                                struct transport_queue_status *queue,
+                                uint8_t *inline_reply, uint32_t inline_len) {
   uint32_t poll_count = 0;
+  bool block = ctx->opts
+      && ctx->opts->completion == NOS_COMPLETION_SPIN_THEN_BLOCK
+      && ctx->dev->ops.wait_for_interrupt;
 
   /* Start the timer */
   struct timespec now;
   struct timespec abort_at;
+  struct timespec block_at = {0, 0};
   if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
     NLOGE("clock_gettime() failing: %s", strerror(errno));
     return APP_ERROR_IO;
   }
-  abort_at.tv_sec = now.tv_sec + POLL_LIMIT_SECONDS;
-  abort_at.tv_nsec = now.tv_nsec;
+  if (ctx->opts && ctx->opts->timeout_ms) {
+    const uint64_t abort_ns = now.tv_nsec + ctx->opts->timeout_ms * 1000000ull;
+    abort_at.tv_sec = now.tv_sec + abort_ns / 1000000000;
+    abort_at.tv_nsec = abort_ns % 1000000000;
+  } else {
+    abort_at.tv_sec = now.tv_sec + POLL_LIMIT_SECONDS;
+    abort_at.tv_nsec = now.tv_nsec;
+  }
+  if (block) {
+    const uint64_t block_ns = now.tv_nsec + ctx->opts->spin_us * 1000ull;
+    block_at.tv_sec = now.tv_sec + block_ns / 1000000000;
+    block_at.tv_nsec = block_ns % 1000000000;
+  }
 
   NLOGD("Polling app %d", ctx->app_id);
   do {
     /* Poll the status */
-    if (get_status(ctx, status) != 0) {
+    if (read_status(ctx, status, queue, inline_reply, inline_len) != 0) {
       return APP_ERROR_IO;
     }
     poll_count++;
+    if (ctx->record) {
+      ctx->record->polls = poll_count;
+    }
     /* Log at higher priority every 16 polls */
     if ((poll_count & (16 - 1)) == 0) {
       NLOGD("App %d poll=%d status=0x%08x reply_len=%d flags=0x%04x",
@@ -390,14 +716,34 @@ static uint32_t poll_until_done(const struct transport_context *ctx,
       NLOGE("App %d just stopped working", ctx->app_id);
       return APP_ERROR_INTERNAL;
     }
+
+    /* The caller may have given up waiting for the result */
+    if (is_cancelled(ctx)) {
+      NLOGD("App %d call cancelled after polling %d times", ctx->app_id, poll_count);
+      return NOS_ERROR_CANCELLED;
+    }
+
+    /* Stop spinning once the app has had long enough to finish quickly */
+    if (block && !timespec_before(&now, &block_at)) {
+      if (ctx->dev->ops.wait_for_interrupt(ctx->dev->ctx, INTERRUPT_WAIT_MS) < 0) {
+        NLOGW("App %d failed to wait for interrupt, polling instead", ctx->app_id);
+        block = false;
+      }
+    }
+
     if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
       NLOGE("clock_gettime() failing: %s", strerror(errno));
       return APP_ERROR_IO;
     }
   } while (timespec_before(&now, &abort_at));
 
-  NLOGE("App %d not done after polling %d times in %d seconds",
-        ctx->app_id, poll_count, POLL_LIMIT_SECONDS);
+  if (ctx->opts && ctx->opts->timeout_ms) {
+    NLOGE("App %d not done after polling %d times in %u ms",
+          ctx->app_id, poll_count, ctx->opts->timeout_ms);
+  } else {
+    NLOGE("App %d not done after polling %d times in %d seconds",
+          ctx->app_id, poll_count, POLL_LIMIT_SECONDS);
+  }
   return APP_ERROR_TIMEOUT;
 }
 
@@ -406,6 +752,7 @@ static uint32_t poll_until_done(const struct transport_context *ctx,
  */
 static uint32_t receive_reply(const struct transport_context *ctx,
                               const struct transport_status *status) {
+  const struct nos_reply_chunks *chunks = reply_chunks(ctx);
   int retries = CRC_RETRY_COUNT;
   while (retries--) {
     NLOGD("Read app %d reply data (%d bytes)", ctx->app_id, status->reply_len);
@@ -415,11 +762,21 @@ static uint32_t receive_reply(const struct transport_context *ctx,
     uint16_t left = MIN(*ctx->reply_len, status->reply_len);
     uint16_t got = 0;
     uint16_t crc = 0;
+    if (chunks) {
+      chunks->restart(chunks->arg);
+    }
     while (left) {
       /* We can't read more per datagram than the device can send */
       const uint16_t gimme = MIN(left, MAX_DEVICE_TRANSFER);
+      if (chunks) {
+        reply = chunks->next(chunks->arg, gimme);
+        if (!reply) {
+          NLOGE("No space for app %d reply chunk (%d bytes)", ctx->app_id, gimme);
+          return APP_ERROR_IO;
+        }
+      }
       NLOGV("Read app %d command=0x%08x, bytes=%d", ctx->app_id, command, gimme);
-      if (nos_device_read(ctx->dev, command, reply, gimme) != 0) {
+      if (nos_device_read(ctx, command, reply, gimme) != 0) {
         NLOGE("Failed to receive datagram from app %d", ctx->app_id);
         return APP_ERROR_IO;
       }
@@ -435,18 +792,87 @@ static uint32_t receive_reply(const struct transport_context *ctx,
     }
     /* got it all */
     *ctx->reply_len = got;
+    if (ctx->record) {
+      ctx->record->reply_len = got;
+    }
 
     /* v0 protocol doesn't support CRC so hopefully it's ok */
     if (status->version == TRANSPORT_V0) return APP_SUCCESS;
 
     if (crc == status->reply_crc) return APP_SUCCESS;
     NLOGW("App %d reply CRC mismatch: theirs=%04x ours=%04x", ctx->app_id, status->reply_crc, crc);
+    record_retry(ctx);
   }
 
   NLOGE("Unable to get valid checksum on app %d reply data", ctx->app_id);
   return APP_ERROR_IO;
 }
 
+/*
+ * Deliver a reply that came inline with the status. Returns false if it can't
+ * be used, in which case the reply must be read as usual.
+ */
+static bool take_inline_reply(const struct transport_context *ctx,
+                              const struct transport_status *status,
+                              const uint8_t *inline_reply,
+                              uint32_t inline_len) {
+  const struct nos_reply_chunks *chunks = reply_chunks(ctx);
+  const uint16_t len = MIN(*ctx->reply_len, status->reply_len);
+
+  if (status->version < TRANSPORT_V2
+      || !(status->flags & STATUS_FLAG_REPLY_INLINE)
+      || status->reply_len > inline_len) {
+    return false;
+  }
+  const uint16_t crc = crc16(inline_reply, status->reply_len);
+  if (crc != status->reply_crc) {
+    NLOGW("App %d inline reply CRC mismatch: theirs=%04x ours=%04x",
+          ctx->app_id, status->reply_crc, crc);
+    record_retry(ctx);
+    return false;
+  }
+
+  uint8_t *reply = ctx->reply;
+  if (chunks) {
+    chunks->restart(chunks->arg);
+    reply = chunks->next(chunks->arg, len);
+    if (!reply) {
+      NLOGE("No space for app %d reply chunk (%d bytes)", ctx->app_id, len);
+      return false;
+    }
+  }
+  NLOGD("App %d reply came inline (%d bytes)", ctx->app_id, len);
+  memcpy(reply, inline_reply, len);
+  *ctx->reply_len = len;
+  if (ctx->record) {
+    ctx->record->reply_len = len;
+  }
+  return true;
+}
+
+/*
+ * Leave the app ready for the next caller after abandoning a command it may
+ * still be working on. The status is cleared if the app is done. If it is still
+ * busy it is left to finish rather than resetting the device, which would lose
+ * the state of every other client. The next call finds it busy until then.
+ */
+static void abandon_command(const struct transport_context *ctx) {
+  /* The caller has already cancelled so recovery must not check for it */
+  struct transport_context recover = *ctx;
+  struct transport_status status;
+  recover.opts = NULL;
+
+  NLOGD("Abandoning app %d command", ctx->app_id);
+  if (clear_status(&recover) != 0 || get_status(&recover, &status) != 0) {
+    /* The next call will try to recover the app again */
+    return;
+  }
+
+  if (status.version != TRANSPORT_V0 && (status.flags & STATUS_FLAG_WORKING)) {
+    NLOGW("App %d is still working on the abandoned command", ctx->app_id);
+  }
+}
+
 /*
  * Driver for the master of the transport protocol.
  */
@@ -455,20 +881,29 @@ uint32_t nos_call_application(const struct nos_device *dev,
                               const uint8_t *args, uint32_t arg_len,
                               uint8_t *reply, uint32_t *reply_len)
 {
-  uint32_t res;
-  const struct transport_context ctx = {
-    .dev = dev,
-    .app_id = app_id,
-    .params = params,
-    .args = args,
-    .arg_len = arg_len,
-    .reply = reply,
-    .reply_len = reply_len,
-  };
+  return nos_call_application_opts(dev, app_id, params, args, arg_len,
+                                   reply, reply_len, NULL);
+}
 
-  if ((ctx.arg_len && !ctx.args) ||
-      (ctx.reply_len && *ctx.reply_len && !ctx.reply)) {
-    NLOGE("Invalid args to %s()", __func__);
+/*
+ * Run the transaction, returning the code for the caller.
+ */
+static uint32_t call_application(const struct transport_context *ctx,
+                                 bool *cleared, uint16_t *version) {
+  const struct nos_call_options *opts = ctx->opts;
+  const uint8_t app_id = ctx->app_id;
+  const uint16_t params = ctx->params;
+  uint32_t *reply_len = ctx->reply_len;
+  uint32_t res;
+  bool ready = ctx->ready;
+  *version = ctx->version;
+
+  *cleared = false;
+  const bool has_args = ctx->args || (opts && opts->request_source);
+  const bool has_reply = ctx->reply || reply_chunks(ctx);
+  if ((ctx->arg_len && !has_args) ||
+      (ctx->reply_len && *ctx->reply_len && !has_reply)) {
+    NLOGE("Invalid args to nos_call_application()");
     return APP_ERROR_IO;
   }
 
@@ -476,18 +911,42 @@ uint32_t nos_call_application(const struct nos_device *dev,
 
   struct transport_status status;
   uint32_t status_code;
+  uint8_t inline_reply[STATUS_INLINE_REPLY_MAX];
+  uint32_t inline_len = 0;
   int retries = CRC_RETRY_COUNT;
   while (retries--) {
     /* Wake up and wait for Citadel to be ready */
-    res = make_ready(&ctx);
-    if (res) return res;
+    record_phase(ctx, NOS_PHASE_READY);
+    res = ready ? APP_SUCCESS : make_ready(ctx, version);
+    if (res) return is_cancelled(ctx) ? NOS_ERROR_CANCELLED : res;
+    /* Only the first attempt can rely on the previous call */
+    ready = false;
 
     /* Tell the app what to do */
-    res = send_command(&ctx);
-    if (res) return res;
+    record_phase(ctx, NOS_PHASE_SEND);
+    res = send_command(ctx, *version);
+    if (res) {
+      if (!is_cancelled(ctx)) return res;
+      abandon_command(ctx);
+      return NOS_ERROR_CANCELLED;
+    }
 
     /* Wait until the app has finished */
-    status_code = poll_until_done(&ctx, &status);
+    record_phase(ctx, NOS_PHASE_POLL);
+    inline_len = 0;
+    if (has_reply && reply_len && sends_inline(ctx, *version)) {
+      inline_len = MIN(*reply_len, STATUS_INLINE_REPLY_MAX);
+    }
+    status_code = poll_until_done(ctx, &status, NULL, inline_reply, inline_len);
+    if (status_code == NOS_ERROR_CANCELLED) {
+      abandon_command(ctx);
+      return NOS_ERROR_CANCELLED;
+    }
+    /* The caller has run out of time but the app is left to finish */
+    if (status_code == APP_ERROR_TIMEOUT && opts && opts->timeout_ms) {
+      abandon_command(ctx);
+      return APP_ERROR_TIMEOUT;
+    }
 
     /* Citadel chip complained we sent it a count different from what we claimed
      * or more than it can accept but this should not happen. Give to the chip a
@@ -495,11 +954,17 @@ uint32_t nos_call_application(const struct nos_device *dev,
     if (status_code == APP_ERROR_TOO_MUCH) {
       NLOGD("App %d returning 0x%x, give a retry(%d/%d)",
             app_id, status_code, retries, CRC_RETRY_COUNT);
+      record_retry(ctx);
+      if (is_cancelled(ctx)) {
+        (void)clear_status(ctx);
+        return NOS_ERROR_CANCELLED;
+      }
       usleep(RETRY_WAIT_TIME_US);
       continue;
     }
     if (status_code != APP_ERROR_CHECKSUM) break;
     NLOGW("App %d request checksum error", app_id);
+    record_retry(ctx);
   }
   if (status_code == APP_ERROR_CHECKSUM) {
     NLOGE("App %d request checksum failed too many times", app_id);
@@ -507,18 +972,654 @@ uint32_t nos_call_application(const struct nos_device *dev,
   }
 
   /* Get the reply, but only if the app produced data and the caller wants it */
-  if (ctx.reply && ctx.reply_len && *ctx.reply_len && status.reply_len) {
-    res = receive_reply(&ctx, &status);
-    if (res) return res;
+  if (has_reply && ctx->reply_len && *ctx->reply_len && status.reply_len) {
+    record_phase(ctx, NOS_PHASE_RECEIVE);
+    if (!take_inline_reply(ctx, &status, inline_reply, inline_len)) {
+      res = receive_reply(ctx, &status);
+      if (res) return res;
+    }
   } else if (reply_len) {
     *reply_len = 0;
   }
 
   NLOGV("Clear app %d reply for the next caller", app_id);
+  record_phase(ctx, NOS_PHASE_CLEAR);
   /* This should work, but isn't completely fatal if it doesn't because the
    * next call will try again. */
-  (void)clear_status(&ctx);
+  *cleared = clear_status(ctx) == 0;
 
   NLOGD("App %d returning 0x%x", app_id, status_code);
   return status_code;
 }
+
+/*
+ * Start recording a transaction in the caller's record.
+ */
+static struct nos_flight_record *begin_record(
+    struct nos_flight_record *record, uint8_t app_id, uint16_t params,
+    uint32_t arg_len) {
+  memset(record, 0, sizeof(*record));
+  for (int i = 0; i < NOS_PHASE_COUNT; ++i) {
+    record->phase_us[i] = NOS_PHASE_NOT_REACHED;
+  }
+  record->start_ns = monotonic_ns();
+  record->app_id = app_id;
+  record->params = params;
+  record->arg_len = arg_len;
+  return record;
+}
+
+/*
+ * Whether the transaction failed in a way that the app itself wouldn't report.
+ */
+static bool is_transport_error(uint32_t code) {
+  return code == APP_ERROR_IO || code == APP_ERROR_TIMEOUT ||
+         code == APP_ERROR_INTERNAL || code == APP_ERROR_BUSY;
+}
+
+/*
+ * Finish recording a transaction, overwriting the recorder's oldest record,
+ * and dump the recorder if it went wrong.
+ */
+static void end_record(struct nos_flight_recorder *recorder,
+                       struct nos_flight_record *record, uint32_t result) {
+  record->total_us = (monotonic_ns() - record->start_ns) / 1000;
+  record->result = result;
+
+  /* Calls made at the same time through a client share its recorder, so
+   * records are kept by each call until it is done and added under the
+   * recorder's lock */
+  pthread_mutex_lock(&recorder->lock);
+  recorder->records[recorder->count % NOS_FLIGHT_RECORDER_ENTRIES] = *record;
+  recorder->count++;
+
+  const bool slow = recorder->slow_call_us &&
+                    record->total_us >= recorder->slow_call_us;
+  if (!is_transport_error(result) && !slow) {
+    pthread_mutex_unlock(&recorder->lock);
+    return;
+  }
+
+  /* Dumped from a copy so other calls aren't held up while it is written */
+  struct nos_flight_recorder copy = *recorder;
+  pthread_mutex_unlock(&recorder->lock);
+  pthread_mutex_init(&copy.lock, NULL);
+  if (copy.dump) {
+    copy.dump(&copy, copy.dump_arg);
+  } else {
+    nos_flight_recorder_log(&copy);
+  }
+  pthread_mutex_destroy(&copy.lock);
+}
+
+uint32_t nos_call_application_opts(const struct nos_device *dev,
+                                   uint8_t app_id, uint16_t params,
+                                   const uint8_t *args, uint32_t arg_len,
+                                   uint8_t *reply, uint32_t *reply_len,
+                                   const struct nos_call_options *opts)
+{
+  struct nos_flight_recorder *recorder = opts ? opts->recorder : NULL;
+  struct nos_flight_record record;
+  const struct transport_context ctx = {
+    .dev = dev,
+    .opts = opts,
+    .app_id = app_id,
+    .params = params,
+    .args = args,
+    .arg_len = arg_len,
+    .reply = reply,
+    .reply_len = reply_len,
+    .record = recorder ? begin_record(&record, app_id, params, arg_len) : NULL,
+  };
+
+  bool cleared;
+  uint16_t version;
+  const uint32_t res = call_application(&ctx, &cleared, &version);
+  if (recorder) {
+    end_record(recorder, ctx.record, res);
+  }
+  return res;
+}
+
+/*
+ * Options for one call of a batch, which can override where its request comes
+ * from and where its reply goes.
+ */
+static void batch_call_options(const struct nos_call_options *opts,
+                               const struct nos_batch_call *call,
+                               struct nos_call_options *out) {
+  memset(out, 0, sizeof(*out));
+  if (opts) {
+    *out = *opts;
+  }
+  if (call->request_source) {
+    out->request_source = call->request_source;
+  }
+  if (call->reply_chunks) {
+    out->reply_chunks = call->reply_chunks;
+  }
+}
+
+/*
+ * Make the calls of a batch one after another. If ready, the first call can
+ * rely on the app being idle and speaking the version given.
+ */
+static uint32_t call_batch(const struct nos_device *dev,
+                           struct nos_batch_call *calls, uint32_t count,
+                           const struct nos_call_options *opts,
+                           int (*done)(void *arg, uint32_t index),
+                           void *done_arg, bool ready, uint16_t version)
+{
+  struct nos_flight_recorder *recorder = opts ? opts->recorder : NULL;
+  struct nos_flight_record record;
+  bool cleared = ready;
+  uint32_t made = 0;
+
+  while (made < count) {
+    struct nos_batch_call *call = &calls[made];
+    struct nos_call_options call_opts;
+    batch_call_options(opts, call, &call_opts);
+    if (call_opts.is_cancelled && call_opts.is_cancelled(call_opts.cancel_arg)) {
+      break;
+    }
+
+    /* An app that the previous call left idle is still ready for this one */
+    ready = cleared &&
+            (made == 0 || calls[made - 1].app_id == call->app_id);
+    if (ready) {
+      NLOGV("App %d still ready from the previous call", call->app_id);
+    }
+    const struct transport_context ctx = {
+      .dev = dev,
+      .opts = &call_opts,
+      .app_id = call->app_id,
+      .params = call->params,
+      .args = call->args,
+      .arg_len = call->arg_len,
+      .reply = call->reply,
+      .reply_len = &call->reply_len,
+      .record = recorder ? begin_record(&record, call->app_id, call->params,
+                                        call->arg_len)
+                         : NULL,
+      .ready = ready,
+      .version = version,
+    };
+
+    call->result = call_application(&ctx, &cleared, &version);
+    if (recorder) {
+      end_record(recorder, ctx.record, call->result);
+    }
+    ++made;
+
+    /* Later calls can't be made to a device that has gone wrong */
+    const bool failed = is_transport_error(call->result) ||
+                        call->result == NOS_ERROR_CANCELLED;
+    if ((done && done(done_arg, made - 1) != 0) || failed) {
+      break;
+    }
+  }
+  return made;
+}
+
+uint32_t nos_call_application_batch(const struct nos_device *dev,
+                                    struct nos_batch_call *calls,
+                                    uint32_t count,
+                                    const struct nos_call_options *opts,
+                                    int (*done)(void *arg, uint32_t index),
+                                    void *done_arg)
+{
+  return call_batch(dev, calls, count, opts, done, done_arg, false,
+                    TRANSPORT_V0);
+}
+
+/*
+ * A call of a pipeline that has been queued on the app.
+ */
+struct queued_call {
+  struct nos_batch_call *call;
+  uint16_t seq;
+  /* Times the call has been sent again after a checksum error */
+  int attempts;
+  /* Times the call has been sent again after finding the app busy */
+  int busy;
+  struct nos_call_options opts;
+  struct transport_context ctx;
+};
+
+/*
+ * State of a pipeline of calls to one app.
+ */
+struct pipeline {
+  const struct nos_device *dev;
+  struct nos_batch_call *calls;
+  const struct nos_call_options *opts;
+  struct nos_flight_recorder *recorder;
+  /* Record of the oldest call, the only one being recorded */
+  struct nos_flight_record record;
+  /* Calls queued on the app, oldest first from head */
+  struct queued_call queue[TRANSPORT_QUEUE_DEPTH];
+  uint32_t head;
+  uint32_t queued;
+};
+
+static struct queued_call *oldest_call(struct pipeline *p) {
+  return &p->queue[p->head];
+}
+
+/*
+ * Queue a call on the app behind those already there. Returns
+ * NOS_ERROR_CANCELLED if the caller gave up before the app took it.
+ */
+static uint32_t queue_call(struct pipeline *p, uint32_t index, int attempts,
+                           int busy) {
+  struct queued_call *q =
+      &p->queue[(p->head + p->queued) % TRANSPORT_QUEUE_DEPTH];
+  struct nos_batch_call *call = &p->calls[index];
+
+  q->call = call;
+  q->seq = index;
+  q->attempts = attempts;
+  q->busy = busy;
+  batch_call_options(p->opts, call, &q->opts);
+  const struct transport_context ctx = {
+    .dev = p->dev,
+    .opts = &q->opts,
+    .app_id = call->app_id,
+    .params = call->params,
+    .args = call->args,
+    .arg_len = call->arg_len,
+    .reply = call->reply,
+    .reply_len = &call->reply_len,
+    .version = TRANSPORT_V3,
+  };
+  q->ctx = ctx;
+
+  NLOGV("Queue call %d on app %d", index, call->app_id);
+  const uint32_t res = send_inline_command(&q->ctx, &q->seq);
+  if (res == APP_SUCCESS) {
+    p->queued++;
+  } else if (is_cancelled(&q->ctx)) {
+    return NOS_ERROR_CANCELLED;
+  }
+  return res;
+}
+
+static void pop_call(struct pipeline *p) {
+  p->head = (p->head + 1) % TRANSPORT_QUEUE_DEPTH;
+  p->queued--;
+}
+
+/*
+ * Collect the oldest queued call once the app has finished it, returning its
+ * result or a transport error. If resend is set, the app couldn't take the call
+ * and it should be sent again. collected is set once the app has moved on from
+ * the call, otherwise it is still the oldest on the app.
+ */
+static uint32_t collect_call(struct pipeline *p, bool *resend,
+                             bool *collected) {
+  struct queued_call *q = oldest_call(p);
+  struct transport_context *ctx = &q->ctx;
+  const bool has_reply = ctx->reply || reply_chunks(ctx);
+  struct transport_status status;
+  struct transport_queue_status queue;
+  uint8_t inline_reply[STATUS_INLINE_REPLY_MAX];
+  uint32_t inline_len = 0;
+
+  *resend = false;
+  *collected = false;
+  /* Polling can give up before the status has been read */
+  memset(&status, 0, sizeof(status));
+  memset(&queue, 0, sizeof(queue));
+  if (has_reply) {
+    inline_len = MIN(*ctx->reply_len, STATUS_INLINE_REPLY_MAX);
+  }
+
+  record_phase(ctx, NOS_PHASE_POLL);
+  const uint32_t code =
+      poll_until_done(ctx, &status, &queue, inline_reply, inline_len);
+  if (code == NOS_ERROR_CANCELLED || !(status.status & APP_STATUS_DONE)) {
+    /* Still working, so it failed, timed out or was cancelled */
+    return code;
+  }
+  if (!(status.flags & STATUS_FLAG_QUEUED) || queue.seq != q->seq) {
+    NLOGE("App %d finished command %d but call %d was next",
+          ctx->app_id, queue.seq, q->seq);
+    return APP_ERROR_IO;
+  }
+  NLOGV("App %d finished call %d with %d more queued",
+        ctx->app_id, q->seq, queue.queued);
+
+  if (code == APP_ERROR_CHECKSUM || code == APP_ERROR_BUSY) {
+    NLOGW("App %d couldn't take call %d: 0x%x", ctx->app_id, q->seq, code);
+    record_retry(ctx);
+    *resend = true;
+  } else if (has_reply && *ctx->reply_len && status.reply_len) {
+    record_phase(ctx, NOS_PHASE_RECEIVE);
+    if (!take_inline_reply(ctx, &status, inline_reply, inline_len)) {
+      const uint32_t res = receive_reply(ctx, &status);
+      if (res) return res;
+    }
+  } else {
+    *ctx->reply_len = 0;
+  }
+
+  /* Collect it so the status moves on to the next */
+  record_phase(ctx, NOS_PHASE_CLEAR);
+  if (clear_status(ctx) != 0) {
+    return APP_ERROR_IO;
+  }
+  *collected = true;
+  return code;
+}
+
+/*
+ * Wait for the app to finish a queued call and collect it without its reply.
+ * Returns false if the app didn't finish it in turn.
+ */
+static bool discard_call(const struct queued_call *q, uint32_t *code) {
+  struct transport_context drain = q->ctx;
+  struct transport_status status;
+  struct transport_queue_status queue;
+  /* The caller may have cancelled so draining must not check for it */
+  drain.opts = NULL;
+  drain.record = NULL;
+  memset(&status, 0, sizeof(status));
+  memset(&queue, 0, sizeof(queue));
+
+  const uint32_t res = poll_until_done(&drain, &status, &queue, NULL, 0);
+  if (!(status.status & APP_STATUS_DONE) ||
+      !(status.flags & STATUS_FLAG_QUEUED) || queue.seq != q->seq ||
+      clear_status(&drain) != 0) {
+    return false;
+  }
+  *code = res;
+  return true;
+}
+
+/*
+ * Finish the calls still queued after the pipeline stopped early, without
+ * their replies. Their results are set but they aren't passed on. The app is
+ * left to work through them, as resetting the device would lose the state of
+ * every other client, and is only reset if it can't be brought back to idle.
+ */
+static void drain_pipeline(struct pipeline *p, uint32_t result) {
+  bool reset = false;
+
+  while (p->queued) {
+    struct queued_call *q = oldest_call(p);
+    uint32_t code;
+
+    q->call->result = result;
+    if (!reset) {
+      if (discard_call(q, &code)) {
+        q->call->result = code;
+      } else {
+        reset = true;
+      }
+    }
+    pop_call(p);
+  }
+
+  if (reset) {
+    NLOGW("App queue not drained, resetting");
+    if (p->dev->ops.reset(p->dev->ctx) != 0) {
+      NLOGE("Failed to reset after abandoning queued calls");
+    }
+  }
+}
+
+/*
+ * Make small calls to one app, keeping up to TRANSPORT_QUEUE_DEPTH of them
+ * queued on it.
+ */
+static uint32_t call_pipeline(const struct nos_device *dev,
+                              struct nos_batch_call *calls, uint32_t count,
+                              const struct nos_call_options *opts,
+                              int (*done)(void *arg, uint32_t index),
+                              void *done_arg) {
+  struct pipeline p = {
+    .dev = dev,
+    .calls = calls,
+    .opts = opts,
+    .recorder = opts ? opts->recorder : NULL,
+  };
+  uint32_t next = 0;
+  uint32_t passed = 0;
+  bool stopped = false;
+
+  for (;;) {
+    /* Keep the app's queue full so it never waits for us */
+    while (!stopped && next < count && p.queued < TRANSPORT_QUEUE_DEPTH) {
+      if (opts && opts->is_cancelled && opts->is_cancelled(opts->cancel_arg)) {
+        stopped = true;
+        break;
+      }
+      const uint32_t res = queue_call(&p, next, 0, 0);
+      if (res == NOS_ERROR_CANCELLED) {
+        stopped = true;
+        break;
+      }
+      if (res != APP_SUCCESS) {
+        /* The app didn't take it, but finishes those already queued */
+        drain_pipeline(&p, NOS_ERROR_CANCELLED);
+        calls[next].result = res;
+        if (done) {
+          done(done_arg, next);
+        }
+        return passed + 1;
+      }
+      next++;
+    }
+    if (!p.queued) {
+      break;
+    }
+    if (stopped) {
+      drain_pipeline(&p, NOS_ERROR_CANCELLED);
+      break;
+    }
+
+    /* Each call is recorded from when it is the oldest on the app */
+    struct queued_call *q = oldest_call(&p);
+    const uint32_t index = q->call - calls;
+    if (p.recorder) {
+      q->ctx.record = begin_record(&p.record, q->call->app_id,
+                                   q->call->params, q->call->arg_len);
+    }
+
+    struct nos_batch_call *call = q->call;
+    struct nos_flight_record *record = q->ctx.record;
+    const struct transport_context front = q->ctx;
+    const int attempts = q->attempts;
+    const int busy = q->busy;
+    bool resend;
+    bool collected;
+    uint32_t result = collect_call(&p, &resend, &collected);
+    if (resend) {
+      pop_call(&p);
+      if (record) {
+        end_record(p.recorder, record, result);
+        record = NULL;
+      }
+      const bool corrupt = result == APP_ERROR_CHECKSUM;
+      if (corrupt ? attempts + 1 >= CRC_RETRY_COUNT : busy + 1 >= RETRY_COUNT) {
+        NLOGE("App %d couldn't take call %d after %d attempts",
+              call->app_id, index, (corrupt ? attempts : busy) + 1);
+        result = corrupt ? APP_ERROR_IO : APP_ERROR_BUSY;
+        stopped = true;
+      } else {
+        /* Give a busy app time to finish unless it has other calls to do */
+        if (!corrupt && !p.queued && !is_cancelled(&front)) {
+          usleep(RETRY_WAIT_TIME_US);
+        }
+        /* Send it again behind the others, so it finishes out of order */
+        result = is_cancelled(&front)
+            ? NOS_ERROR_CANCELLED
+            : queue_call(&p, index, attempts + corrupt, busy + !corrupt);
+        if (result == APP_SUCCESS) {
+          continue;
+        }
+        stopped = true;
+      }
+    } else if (!collected) {
+      /* The app may still be working on it so wait for it to finish along
+       * with those queued behind it, or leave it if it is the last */
+      if (p.queued > 1) {
+        drain_pipeline(&p, NOS_ERROR_CANCELLED);
+      } else {
+        pop_call(&p);
+        if (result == NOS_ERROR_CANCELLED || result == APP_ERROR_TIMEOUT) {
+          abandon_command(&front);
+        }
+      }
+      stopped = true;
+    } else {
+      pop_call(&p);
+      /* Later calls aren't made after a transport error, as for a batch */
+      if (is_transport_error(result)) {
+        stopped = true;
+      }
+    }
+
+    call->result = result;
+    if (record) {
+      end_record(p.recorder, record, result);
+    }
+    passed++;
+    if (done && done(done_arg, index) != 0) {
+      stopped = true;
+    }
+  }
+
+  return passed;
+}
+
+uint32_t nos_call_application_pipelined(const struct nos_device *dev,
+                                        struct nos_batch_call *calls,
+                                        uint32_t count,
+                                        const struct nos_call_options *opts,
+                                        int (*done)(void *arg, uint32_t index),
+                                        void *done_arg)
+{
+  /* Only several small calls to the same app can be queued */
+  bool queueable = count > 1;
+  for (uint32_t i = 0; queueable && i < count; ++i) {
+    queueable = calls[i].app_id == calls[0].app_id &&
+                calls[i].arg_len <= QUEUED_ARGS_MAX;
+  }
+  if (!queueable) {
+    return call_batch(dev, calls, count, opts, done, done_arg, false,
+                      TRANSPORT_V0);
+  }
+
+  /* Find out whether the app can queue them */
+  struct nos_call_options probe_opts;
+  batch_call_options(opts, &calls[0], &probe_opts);
+  const struct transport_context probe = {
+    .dev = dev,
+    .opts = &probe_opts,
+    .app_id = calls[0].app_id,
+  };
+  if (is_cancelled(&probe)) {
+    return 0;
+  }
+  uint16_t version = TRANSPORT_V0;
+  if (make_ready(&probe, &version) != APP_SUCCESS) {
+    /* The first call will find out what's wrong */
+    return call_batch(dev, calls, count, opts, done, done_arg, false,
+                      TRANSPORT_V0);
+  }
+  if (version < TRANSPORT_V3) {
+    return call_batch(dev, calls, count, opts, done, done_arg, true, version);
+  }
+  return call_pipeline(dev, calls, count, opts, done, done_arg);
+}
+
+int nos_wait_until_ready(const struct nos_device *dev, uint32_t timeout_ms) {
+  const uint32_t command = CMD_ID(APP_ID_NUGGET) | CMD_IS_READ | CMD_TRANSPORT;
+  uint8_t status[STATUS_MAX_LENGTH];
+  bool block = dev->ops.wait_for_interrupt != NULL;
+  uint32_t wait_us = READY_PROBE_MIN_US;
+  uint32_t probes = 0;
+
+  if (!timeout_ms) {
+    timeout_ms = RETRY_COUNT * (RETRY_WAIT_TIME_US / 1000);
+  }
+  const uint64_t start_ns = monotonic_ns();
+  const uint64_t give_up_ns = start_ns + timeout_ms * 1000000ull;
+
+  for (;;) {
+    /* The driver returns EAGAIN until the chip has rebooted */
+    const int err = dev->ops.read(dev->ctx, command, status, sizeof(status));
+    probes++;
+    if (err != -EAGAIN) {
+      if (err) {
+        NLOGE("Failed to probe device: %s", strerror(-err));
+      } else {
+        NLOGD("Device ready after %u probes in %u us", probes,
+              (uint32_t)((monotonic_ns() - start_ns) / 1000));
+      }
+      return err;
+    }
+
+    if (monotonic_ns() >= give_up_ns) {
+      NLOGE("Device not ready after %u probes in %u ms", probes, timeout_ms);
+      return -ETIMEDOUT;
+    }
+
+    /* Probe again sooner if the device signals that it has woken */
+    if (block) {
+      const int woken = dev->ops.wait_for_interrupt(
+          dev->ctx, (wait_us + 999) / 1000);
+      if (woken > 0) {
+        wait_us = READY_PROBE_MIN_US;
+        continue;
+      }
+      if (woken < 0) {
+        NLOGW("Failed to wait for interrupt, sleeping instead");
+        block = false;
+        usleep(wait_us);
+      }
+    } else {
+      usleep(wait_us);
+    }
+    wait_us = MIN(wait_us * 2, READY_PROBE_MAX_US);
+  }
+}
+
+void nos_flight_recorder_copy(const struct nos_flight_recorder *recorder,
+                              struct nos_flight_recorder *copy) {
+  /* The recorder is only read but its lock has to be taken */
+  struct nos_flight_recorder *locked = (struct nos_flight_recorder *)recorder;
+  pthread_mutex_lock(&locked->lock);
+  *copy = *recorder;
+  pthread_mutex_unlock(&locked->lock);
+  pthread_mutex_init(&copy->lock, NULL);
+}
+
+void nos_flight_recorder_log(const struct nos_flight_recorder *recorder) {
+  static const char *const phase_names[NOS_PHASE_COUNT] = {
+    "ready", "send", "poll", "receive", "clear",
+  };
+  const uint32_t kept = MIN(recorder->count, NOS_FLIGHT_RECORDER_ENTRIES);
+
+  NLOGW("Flight recorder: last %u of %u transactions", kept, recorder->count);
+  for (uint32_t n = recorder->count - kept; n != recorder->count; ++n) {
+    const struct nos_flight_record *record =
+        &recorder->records[n % NOS_FLIGHT_RECORDER_ENTRIES];
+    char phases[NOS_PHASE_COUNT * 48];
+    size_t used = 0;
+    for (int i = 0; i < NOS_PHASE_COUNT; ++i) {
+      if (record->phase_us[i] == NOS_PHASE_NOT_REACHED) {
+        continue;
+      }
+      used += snprintf(phases + used, sizeof(phases) - used, " %s@%uus:0x%08x",
+                       phase_names[i], record->phase_us[i],
+                       record->phase_status[i]);
+    }
+    NLOGW("#%u app=%d params=0x%04x args=%u reply=%u result=0x%x time=%uus "
+          "datagrams=%u retries=%u polls=%u%s",
+          n, record->app_id, record->params, record->arg_len,
+          record->reply_len, record->result, record->total_us,
+          record->datagrams, record->retries, record->polls, phases);
+  }
+}
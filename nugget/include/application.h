@@ -209,6 +209,8 @@ typedef void (write_to_app_fn_t)(uint32_t command,
 
 #define TRANSPORT_V0    0x0000
 #define TRANSPORT_V1    0x0001
+#define TRANSPORT_V2    0x0002
+#define TRANSPORT_V3    0x0003
 
 /* Command information for the transport protocol. */
 struct transport_command_info {
@@ -225,6 +227,54 @@ struct transport_command_info {
  * will require its own CRC for data integrity and something to signify the
  * presence of the extra data. */
 
+/*
+ * From v2, a request that fits is sent inline with the "go" command rather
+ * than in data datagrams before it, saving a bus transaction. The go datagram
+ * holds the command info, with version TRANSPORT_V2, then this struct, then
+ * the args. The command info CRC is calculated just as for v1 so it covers
+ * the args too. The master only does this once the slave has reported v2 in
+ * its status.
+ *
+ * The slave may then send a short reply inline too. The master reads the
+ * status with room for STATUS_INLINE_REPLY_MAX more bytes, and if the reply
+ * fits the slave sets STATUS_FLAG_REPLY_INLINE in the DONE status and puts the
+ * reply straight after it, at STATUS_MAX_LENGTH. The reply CRC covers it as
+ * usual, so no data read is needed.
+ */
+struct transport_inline_args {
+  /* v2 fields */
+  uint16_t arg_len;          /* length of the args that follow */
+} __packed;
+
+/*
+ * From v3, an app can hold up to TRANSPORT_QUEUE_DEPTH commands so it can
+ * start the next as soon as it finishes one rather than waiting for the
+ * master. Each is sent inline as for v2 but with command info version
+ * TRANSPORT_V3 and this struct after the transport_inline_args, before the
+ * args. The command info CRC is extended over this struct.
+ *
+ * The app works through its commands in order. While it has finished commands
+ * to collect, its status is for the oldest of them, with STATUS_FLAG_QUEUED
+ * set and a transport_queue_status straight after the status saying which
+ * command it is for, then any inline reply. Clearing the status collects that
+ * command and moves on to the next. A command that can't be queued is
+ * finished straight away with APP_ERROR_BUSY, or APP_ERROR_CHECKSUM if its
+ * CRC was wrong, so the master can send it again.
+ */
+#define TRANSPORT_QUEUE_DEPTH 4
+
+struct transport_queued_args {
+  /* v3 fields */
+  uint16_t seq;              /* chosen by the master to identify the command */
+} __packed;
+
+struct transport_queue_status {
+  /* v3 fields */
+  uint16_t seq;              /* command the status is for */
+  uint16_t queued;           /* commands still to be finished after it */
+  uint16_t crc;              /* CRC of this struct with crc set to 0 */
+} __packed;
+
 struct transport_status {
   /* v0 fields */
   uint32_t status;         /* status of the app */
@@ -243,6 +293,17 @@ struct transport_status {
 
 /* Flags used in the status message */
 #define STATUS_FLAG_WORKING 0x0001 /* added in v1 */
+/* Event reports are queued for NUGGET_PARAM_GET_EVENT_REPORT. Set in every
+ * status so the master can see it on the reads it already makes. */
+#define STATUS_FLAG_EVENTS_PENDING 0x0002 /* added in v1 */
+/* The reply follows the status in the same datagram */
+#define STATUS_FLAG_REPLY_INLINE 0x0004 /* added in v2 */
+
+/* A transport_queue_status follows the status */
+#define STATUS_FLAG_QUEUED 0x0008 /* added in v3 */
+
+/* Longest reply sent inline with the status */
+#define STATUS_INLINE_REPLY_MAX 48
 
 /* Pre-calculated CRCs for different status responses set in the interrupt
  * context where the CRC would otherwise not be calculated. */
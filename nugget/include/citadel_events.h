@@ -39,6 +39,10 @@ extern "C" {
  *
  *   3. Citadel deasserts CTDL_AP_IRQ.
  *
+ * While events are queued, Citadel also sets STATUS_FLAG_EVENTS_PENDING in the
+ * transport status of every app, so the AP can notice them during other
+ * traffic without a separate transaction.
+ *
  * Because we may want to compare the history and evolution of events over a
  * long time and for multiple releases, we should only APPEND to this file
  * instead of changing things.
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "DTupInputQueue.h"
+
+#include <utility>
+
+#include <application.h>
+
+namespace nugget {
+namespace app {
+namespace keymaster {
+
+DTupInputQueue::DTupInputQueue(IKeymaster& keymaster,
+                               const nos::NuggetClientInterface& client)
+    : keymaster_(keymaster), client_(client) {
+}
+
+uint32_t DTupInputQueue::Fetch() {
+  std::lock_guard<std::mutex> fetch_lock(fetch_mutex_);
+  for (size_t i = 0; i < kMaxFetches; ++i) {
+    DTupFetchInputEventResponse response;
+    const uint32_t status = keymaster_.FetchDTupInputEvent({}, &response);
+    if (status != APP_SUCCESS) {
+      return status;
+    }
+    if (response.error_code() != DTupError::DTUP_OK) {
+      break;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(response));
+    }
+    cv_.notify_all();
+  }
+  return APP_SUCCESS;
+}
+
+uint32_t DTupInputQueue::FetchIfPending() {
+  return client_.EventsPending() ? Fetch() : APP_SUCCESS;
+}
+
+void DTupInputQueue::OnEvent(const event_report& event) {
+  if (event.id == EVENT_REBOOTED) {
+    /* Input from before the reboot is for a prompt that has gone */
+    Clear();
+  }
+}
+
+bool DTupInputQueue::Next(DTupFetchInputEventResponse* event,
+                          std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!cv_.wait_for(lock, timeout, [this] { return !queue_.empty(); })) {
+    return false;
+  }
+  *event = std::move(queue_.front());
+  queue_.pop_front();
+  return true;
+}
+
+void DTupInputQueue::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  queue_.clear();
+}
+
+size_t DTupInputQueue::Queued() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size();
+}
+
+}  // namespace keymaster
+}  // namespace app
+}  // namespace nugget
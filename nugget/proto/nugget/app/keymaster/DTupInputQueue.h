@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NUGGET_APP_KEYMASTER_DTUP_INPUT_QUEUE_H
+#define NUGGET_APP_KEYMASTER_DTUP_INPUT_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include <citadel_events.h>
+
+#include <nos/NuggetClientInterface.h>
+
+#include <Keymaster.client.h>
+
+namespace nugget {
+namespace app {
+namespace keymaster {
+
+/**
+ * Queues keymaster's DTup input events on the host, so trusted UI waits for
+ * input rather than each prompt polling FetchDTupInputEvent itself.
+ *
+ * Citadel has no event report or status flag for input, so Fetch() drains
+ * keymaster and is what delivers input on all firmware. Call it where the
+ * prompt would have polled. The event service can also call FetchIfPending()
+ * after each call that may have flagged event reports, which fetches early
+ * while the flag is set and makes no calls otherwise.
+ *
+ * The prompt waits on Next() for the input, which is signed by keymaster as
+ * when it is polled. The event service passes its events to OnEvent() so a
+ * reboot drops input for a prompt that has gone. It is thread safe.
+ */
+class DTupInputQueue {
+public:
+    /**
+     * Most input events fetched by one Fetch(), in case keymaster never says
+     * it has run out.
+     */
+    static constexpr size_t kMaxFetches = 16;
+
+    /**
+     * @param keymaster Keymaster on the device, which must outlive this.
+     * @param client Client keymaster calls through, whose events pending flag
+     *               FetchIfPending() goes by. It must outlive this.
+     */
+    DTupInputQueue(IKeymaster& keymaster,
+                   const nos::NuggetClientInterface& client);
+
+    DTupInputQueue(const DTupInputQueue&) = delete;
+    DTupInputQueue& operator=(const DTupInputQueue&) = delete;
+
+    /**
+     * Fetch the input events keymaster has into the queue, ending with a call
+     * that finds none.
+     *
+     * @return APP_SUCCESS once keymaster has no more, or the app's error if a
+     *         call failed.
+     */
+    uint32_t Fetch();
+
+    /**
+     * Fetch() only if the client's last call flagged events pending.
+     *
+     * @return APP_SUCCESS if nothing was flagged, otherwise as Fetch().
+     */
+    uint32_t FetchIfPending();
+
+    /**
+     * Track Citadel's events, dropping the queue if Citadel rebooted.
+     */
+    void OnEvent(const event_report& event);
+
+    /**
+     * Take the next input event, waiting up to the timeout for one.
+     *
+     * @return Whether there was an event.
+     */
+    bool Next(DTupFetchInputEventResponse* event,
+              std::chrono::milliseconds timeout);
+
+    /**
+     * Drop the queued input, such as when a new prompt is shown.
+     */
+    void Clear();
+
+    /**
+     * Number of input events waiting to be taken.
+     */
+    size_t Queued() const;
+
+private:
+    IKeymaster& keymaster_;
+    const nos::NuggetClientInterface& client_;
+
+    /* Held while fetching so only one thread calls keymaster */
+    std::mutex fetch_mutex_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<DTupFetchInputEventResponse> queue_;
+};
+
+} // namespace keymaster
+} // namespace app
+} // namespace nugget
+
+#endif // NUGGET_APP_KEYMASTER_DTUP_INPUT_QUEUE_H
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "HmacSharingCache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#include <unistd.h>
+
+#include <app_nugget.h>
+#include <application.h>
+
+namespace nugget {
+namespace app {
+namespace keymaster {
+
+namespace {
+
+/* "HSC" and the version of the file's layout */
+constexpr uint32_t kFileMagic = 0x48534302;
+
+/* Records are keymaster's messages, which are bounded by its buffers */
+constexpr uint32_t kMaxRecordSize = 4096;
+
+template <typename T>
+void Write(std::ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void Write(std::ostream& out, const std::string& value) {
+  Write(out, static_cast<uint32_t>(value.size()));
+  out.write(value.data(), value.size());
+}
+
+template <typename T>
+bool Read(std::istream& in, T* value) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(value),
+                                   sizeof(*value)));
+}
+
+bool Read(std::istream& in, std::string* value) {
+  uint32_t size;
+  if (!Read(in, &size) || size > kMaxRecordSize) {
+    return false;
+  }
+  value->resize(size);
+  return static_cast<bool>(in.read(&(*value)[0], size));
+}
+
+}  // namespace
+
+HmacSharingCache::HmacSharingCache(::nos::NuggetClientInterface& client,
+                                   IKeymaster& keymaster, std::string path)
+    : nugget_(client, APP_ID_NUGGET), keymaster_(keymaster),
+      path_(std::move(path)), checked_(false), boot_{0, 0} {
+}
+
+uint32_t HmacSharingCache::GetHmacSharingParameters(
+    const GetHmacSharingParametersRequest& request,
+    GetHmacSharingParametersResponse* response) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool cacheable = response != nullptr && CheckBootLocked();
+  if (cacheable && !params_.empty()) {
+    return response->ParseFromString(params_) ? APP_SUCCESS : APP_ERROR_RPC;
+  }
+
+  const uint32_t status = keymaster_.GetHmacSharingParameters(request,
+                                                              response);
+  if (cacheable && status == APP_SUCCESS &&
+      response->error_code() == ErrorCode::OK) {
+    params_ = response->SerializeAsString();
+    Save();
+  }
+  return status;
+}
+
+uint32_t HmacSharingCache::ComputeSharedHmac(
+    const ComputeSharedHmacRequest& request,
+    ComputeSharedHmacResponse* response) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool cacheable = response != nullptr && CheckBootLocked();
+  /* The participants are kept in order as it changes the derivation */
+  const std::string participants =
+      cacheable ? request.SerializeAsString() : std::string();
+  if (cacheable && !shared_.empty() && participants == participants_) {
+    return response->ParseFromString(shared_) ? APP_SUCCESS : APP_ERROR_RPC;
+  }
+
+  /* Whatever happens, the chip no longer holds the cached key */
+  const bool forget = !shared_.empty();
+  participants_.clear();
+  shared_.clear();
+  const uint32_t status = keymaster_.ComputeSharedHmac(request, response);
+  if (cacheable && status == APP_SUCCESS &&
+      response->error_code() == ErrorCode::OK) {
+    participants_ = participants;
+    shared_ = response->SerializeAsString();
+    Save();
+  } else if (forget) {
+    Save();
+  }
+  return status;
+}
+
+void HmacSharingCache::Invalidate() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  checked_ = false;
+}
+
+void HmacSharingCache::OnEvent(const event_report& event) {
+  if (event.id == EVENT_REBOOTED) {
+    Invalidate();
+  }
+}
+
+bool HmacSharingCache::CheckBootLocked() {
+  if (!checked_) {
+    struct nugget_app_low_power_stats stats;
+    if (nugget_.Call<NUGGET_PARAM_GET_LOW_POWER_STATS>(&stats) !=
+        APP_SUCCESS) {
+      return false;
+    }
+    boot_ = {stats.hard_reset_count, stats.time_since_hard_reset};
+    checked_ = true;
+  }
+
+  /* Another process may have negotiated since the file was last read */
+  Load();
+  return true;
+}
+
+void HmacSharingCache::Load() {
+  params_.clear();
+  participants_.clear();
+  shared_.clear();
+
+  std::ifstream in(path_, std::ios::binary);
+  uint32_t magic;
+  if (!in || !Read(in, &magic) || magic != kFileMagic) {
+    return;
+  }
+
+  Boot boot;
+  std::string params;
+  std::string participants;
+  std::string shared;
+  if (!Read(in, &boot.hard_reset_count) ||
+      !Read(in, &boot.time_since_hard_reset) || !Read(in, &params) ||
+      !Read(in, &participants) || !Read(in, &shared)) {
+    return;
+  }
+  /* The time since the reset only goes backwards if the chip reset */
+  if (boot.hard_reset_count != boot_.hard_reset_count ||
+      boot.time_since_hard_reset > boot_.time_since_hard_reset) {
+    return;
+  }
+
+  /* Keep the earliest time so the file stays valid for every process that
+   * checked this boot */
+  boot_ = boot;
+  params_ = std::move(params);
+  participants_ = std::move(participants);
+  shared_ = std::move(shared);
+}
+
+void HmacSharingCache::Save() const {
+  std::ostringstream out;
+  Write(out, kFileMagic);
+  Write(out, boot_.hard_reset_count);
+  Write(out, boot_.time_since_hard_reset);
+  Write(out, params_);
+  Write(out, participants_);
+  Write(out, shared_);
+  const std::string data = out.str();
+
+  /* Written to a file of its own next to the cache and renamed over it in one
+   * go, so processes saving at once don't write into the same file and
+   * another process never reads half a file */
+  std::string temp = path_ + ".XXXXXX";
+  const int fd = mkstemp(&temp[0]);
+  if (fd < 0) {
+    return;
+  }
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    written += n;
+  }
+  const bool closed = close(fd) == 0;
+  if (!closed || written != data.size() ||
+      std::rename(temp.c_str(), path_.c_str()) != 0) {
+    unlink(temp.c_str());
+  }
+}
+
+}  // namespace keymaster
+}  // namespace app
+}  // namespace nugget
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef NUGGET_APP_KEYMASTER_HMAC_SHARING_CACHE_H
+#define NUGGET_APP_KEYMASTER_HMAC_SHARING_CACHE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <citadel_events.h>
+#include <nos/AppClient.h>
+#include <nos/NuggetClientInterface.h>
+
+#include <Keymaster.client.h>
+
+namespace nugget {
+namespace app {
+namespace keymaster {
+
+/**
+ * Remembers keymaster's HMAC sharing negotiation for the current boot of the
+ * chip so a restarted HAL doesn't repeat it.
+ *
+ * Keymaster's sharing parameters and the key derived from them last until the
+ * chip reboots, so the parameters and the sharing_check computed by the latest
+ * negotiation are kept in a file. A HAL that starts again during the same
+ * boot gets them from the file rather than calling GetHmacSharingParameters
+ * and ComputeSharedHmac. The boot is identified by the chip's hard reset count
+ * from its low power stats, which costs one small call the first time the
+ * cache is used and after each Invalidate(). The file is read again each time
+ * the cache is used so a negotiation by another process replaces what this one
+ * remembers.
+ *
+ * The reset count is cleared when the chip loses power so keep the file
+ * somewhere that doesn't outlive the host's boot, such as a tmpfs. The file
+ * is only readable by its owner and is replaced through a temporary file
+ * in the same directory. Only successful results are cached. It is thread
+ * safe.
+ */
+class HmacSharingCache {
+public:
+    /**
+     * @param client    Client of the device, which must outlive this.
+     * @param keymaster Keymaster on the device, which must outlive this.
+     * @param path      File to keep the negotiation in between processes.
+     */
+    HmacSharingCache(::nos::NuggetClientInterface& client,
+                     IKeymaster& keymaster, std::string path);
+
+    HmacSharingCache(const HmacSharingCache&) = delete;
+    HmacSharingCache& operator=(const HmacSharingCache&) = delete;
+
+    /**
+     * As IKeymaster::GetHmacSharingParameters() but answered from the cache if
+     * it was already called during this boot of the chip.
+     */
+    uint32_t GetHmacSharingParameters(
+        const GetHmacSharingParametersRequest& request,
+        GetHmacSharingParametersResponse* response);
+
+    /**
+     * As IKeymaster::ComputeSharedHmac() but answered from the cache if the
+     * last call during this boot of the chip had the same participants, in the
+     * same order. The chip only holds the key from its latest negotiation so
+     * earlier ones are forgotten.
+     */
+    uint32_t ComputeSharedHmac(const ComputeSharedHmacRequest& request,
+                               ComputeSharedHmacResponse* response);
+
+    /**
+     * Check the chip's boot again before the cache is next used. Register this
+     * with NuggetClient::AddWarmUp() so it follows resets of the chip.
+     */
+    void Invalidate();
+
+    /**
+     * Track the chip's events, checking its boot again if it rebooted.
+     */
+    void OnEvent(const event_report& event);
+
+private:
+    struct Boot {
+        uint64_t hard_reset_count;
+        uint64_t time_since_hard_reset;
+    };
+
+    bool CheckBootLocked();
+    void Load();
+    void Save() const;
+
+    ::nos::AppClient nugget_;
+    IKeymaster& keymaster_;
+    const std::string path_;
+
+    mutable std::mutex mutex_;
+    /* Whether the cache is known to be for the chip's current boot */
+    bool checked_;
+    /* Boot the cached results are from, as first seen */
+    Boot boot_;
+    /* Serialized GetHmacSharingParametersResponse, empty if not cached */
+    std::string params_;
+    /* Serialized request of the latest ComputeSharedHmac() */
+    std::string participants_;
+    /* Serialized ComputeSharedHmacResponse to it, empty if not cached */
+    std::string shared_;
+};
+
+} // namespace keymaster
+} // namespace app
+} // namespace nugget
+
+#endif // NUGGET_APP_KEYMASTER_HMAC_SHARING_CACHE_H